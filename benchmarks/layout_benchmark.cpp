@@ -0,0 +1,180 @@
+
+// --- App Includes --- //
+#include <gis/Band.h>
+#include <gis/MortonBand.h>
+
+// --- Standard Includes --- //
+#include <algorithm>
+#include <chrono>
+#include <cstdlib>
+#include <iomanip>
+#include <iostream>
+#include <string>
+#include <vector>
+
+namespace
+{
+
+///Row-major addressing
+struct RowMajor
+{
+    int width;
+
+    std::size_t operator ()( int r, int c ) const
+    {
+        return static_cast< std::size_t >( r ) * width + c;
+    }
+};
+
+///64x64 tiles laid out row-major, row-major inside each tile
+struct Tiled
+{
+    int across;
+
+    std::size_t operator ()( int r, int c ) const
+    {
+        std::size_t const tile =
+            static_cast< std::size_t >( r >> 6 ) * across + ( c >> 6 );
+        return ( tile << 12 ) | ( ( r & 63 ) << 6 ) | ( c & 63 );
+    }
+};
+
+///Reads a rows x cols window at (r0,c0) row-major through an index
+///functor; pixels off the band read as 0
+template< typename I >
+struct IndexedReader
+{
+    float const* data;
+    I index;
+    int width;
+    int height;
+
+    void operator ()( int r0, int c0, int rows, int cols, float* out ) const
+    {
+        for( int r = r0; r < r0 + rows; ++r )
+        {
+            for( int c = c0; c < c0 + cols; ++c )
+            {
+                bool const inside = ( r >= 0 && r < height && c >= 0 && c < width );
+                *out++ = inside ? data[ index( r, c ) ] : 0.0f;
+            }
+        }
+    }
+};
+
+///Reads through MortonBand::read, which steps between pixels with a cursor
+struct MortonReader
+{
+    gis::MortonBand< float > const& band;
+
+    void operator ()( int r0, int c0, int rows, int cols, float* out ) const
+    {
+        band.read( r0, c0, rows, cols, out );
+    }
+};
+
+///Sums a k x k window around every interior pixel, one block at a time:
+///each block and its halo are read row-major into a scratch tile that
+///stays in cache, so only the reads differ between layouts
+template< typename R >
+double window_sum(
+    R read,
+    int width,
+    int height,
+    int block,
+    int k )
+{
+    int const h = k / 2;
+    int const side = block + 2 * h;
+    std::vector< float > tile( static_cast< std::size_t >( side ) * side );
+    double total = 0.0;
+    for( int r0 = 0; r0 < height; r0 += block )
+    {
+        for( int c0 = 0; c0 < width; c0 += block )
+        {
+            read( r0 - h, c0 - h, side, side, tile.data() );
+            int const rbegin = std::max( r0, h ) - r0;
+            int const rend = std::min( r0 + block, height - h ) - r0;
+            int const cbegin = std::max( c0, h ) - c0;
+            int const cend = std::min( c0 + block, width - h ) - c0;
+            for( int r = rbegin; r < rend; ++r )
+            {
+                for( int c = cbegin; c < cend; ++c )
+                {
+                    float sum = 0.0f;
+                    for( int dr = 0; dr < k; ++dr )
+                    {
+                        float const* row = tile.data() +
+                            static_cast< std::size_t >( r + dr ) * side + c;
+                        for( int dc = 0; dc < k; ++dc ) sum += row[ dc ];
+                    }
+                    total += sum;
+                }
+            }
+        }
+    }
+    return total;
+}
+
+///
+template< typename F >
+void run(
+    std::string const& name,
+    int k,
+    F sum )
+{
+    auto const start = std::chrono::steady_clock::now();
+    double const total = sum();
+    auto const stop = std::chrono::steady_clock::now();
+    std::cout << std::setw( 10 ) << name << std::setw( 4 ) << k << "x" << k
+        << std::setw( 10 ) << std::chrono::duration_cast<
+            std::chrono::milliseconds >( stop - start ).count() << " ms"
+        << "  (" << total << ")" << std::endl;
+}
+
+} //end namespace
+
+int main(
+    int argc,
+    char** argv )
+{
+    int const size = ( argc > 1 ) ? std::atoi( argv[ 1 ] ) : 2048;
+
+    gis::Band< float > rowmajor( size, size, -1.0f, 0.0f );
+    for( int r = 0; r < size; ++r )
+    {
+        for( int c = 0; c < size; ++c ) rowmajor( r, c ) = float( ( r * 7 + c * 3 ) % 17 );
+    }
+
+    int const across = ( size + 63 ) / 64;
+    gis::Buffer< float > tiled( static_cast< std::size_t >( across ) * across * 4096 );
+    Tiled const tindex{ across };
+    for( int r = 0; r < size; ++r )
+    {
+        for( int c = 0; c < size; ++c ) tiled[ tindex( r, c ) ] = rowmajor( r, c );
+    }
+
+    gis::MortonBand< float > const morton( rowmajor );
+
+    int const block = morton.block_size();
+    std::cout << size << "x" << size << " float, block " << block << std::endl;
+    for( int k : { 3, 15 } )
+    {
+        run( "row-major", k, [ & ]
+            {
+                IndexedReader< RowMajor > const read{ rowmajor.data(), RowMajor{ size }, size, size };
+                return window_sum( read, size, size, block, k );
+            } );
+        run( "tiled", k, [ & ]
+            {
+                IndexedReader< Tiled > const read{ tiled.data(), tindex, size, size };
+                return window_sum( read, size, size, block, k );
+            } );
+        run( "morton", k, [ & ]
+            {
+                return window_sum( MortonReader{ morton }, size, size, block, k );
+            } );
+    }
+
+    return EXIT_SUCCESS;
+}
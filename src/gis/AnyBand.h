@@ -0,0 +1,602 @@
+/*******************************************************************************
+ *
+ * MIT License
+ *
+ * Copyright (c) 2018 Joshua Koch
+ * 
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ * 
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ * 
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ *
+ ******************************************************************************/
+
+#pragma once
+
+#include <gis/Band.h>
+
+#include <cstdint>
+#include <functional>
+#include <memory>
+#include <limits>
+#include <stdexcept>
+#include <string>
+#include <tuple>
+#include <type_traits>
+#include <utility>
+
+namespace gis
+{
+
+///Pixel types an AnyBand can hold
+enum class PixelType
+{
+    UInt8,
+    Int8,
+    UInt16,
+    Int16,
+    UInt32,
+    Int32,
+    Float32,
+    Float64
+};
+
+///Supported pixel types, in PixelType order
+using PixelTypes = std::tuple<
+    std::uint8_t,
+    std::int8_t,
+    std::uint16_t,
+    std::int16_t,
+    std::uint32_t,
+    std::int32_t,
+    float,
+    double >;
+
+///
+static constexpr std::size_t PixelTypeCount =
+    std::tuple_size< PixelTypes >::value;
+
+///C++ type of a PixelType
+template< PixelType P >
+using pixel_t = typename std::tuple_element<
+    static_cast< std::size_t >( P ), PixelTypes >::type;
+
+namespace detail
+{
+
+///
+template< typename T, std::size_t I = 0 >
+struct pixel_index
+{
+    static constexpr std::size_t value = std::is_same< T,
+        typename std::tuple_element< I, PixelTypes >::type >::value ?
+        I : pixel_index< T, I + 1 >::value;
+};
+
+///
+template< typename T >
+struct pixel_index< T, PixelTypeCount >
+{
+    static constexpr std::size_t value = PixelTypeCount;
+};
+
+///Type tag passed to dispatched functions
+template< typename T >
+struct TypeTag
+{
+    using type = T;
+};
+
+///Calls fn( TypeTag< T >{} ) for the C++ type of p: the one switch every
+///runtime-typed operation goes through
+template< typename F >
+auto with_pixel_type(
+    PixelType p,
+    F&& fn ) -> decltype( fn( TypeTag< std::uint8_t >{} ) )
+{
+    switch( p )
+    {
+    case PixelType::UInt8: return fn( TypeTag< std::uint8_t >{} );
+    case PixelType::Int8: return fn( TypeTag< std::int8_t >{} );
+    case PixelType::UInt16: return fn( TypeTag< std::uint16_t >{} );
+    case PixelType::Int16: return fn( TypeTag< std::int16_t >{} );
+    case PixelType::UInt32: return fn( TypeTag< std::uint32_t >{} );
+    case PixelType::Int32: return fn( TypeTag< std::int32_t >{} );
+    case PixelType::Float32: return fn( TypeTag< float >{} );
+    case PixelType::Float64: return fn( TypeTag< double >{} );
+    }
+    throw std::invalid_argument( "gis::with_pixel_type: unknown pixel type" );
+}
+
+} //end detail
+
+///PixelType of a C++ type
+template< typename T >
+constexpr PixelType pixel_type()
+{
+    static_assert( detail::pixel_index< T >::value < PixelTypeCount,
+        "Unsupported pixel type" );
+    return static_cast< PixelType >( detail::pixel_index< T >::value );
+}
+
+///
+inline char const* pixel_type_name(
+    PixelType p )
+{
+    static char const* const names[ PixelTypeCount ] = { "UInt8", "Int8",
+        "UInt16", "Int16", "UInt32", "Int32", "Float32", "Float64" };
+    return names[ static_cast< std::size_t >( p ) ];
+}
+
+///Band whose pixel type is only known at runtime. Operations dispatch once
+///per call to the Band< T > kernels.
+class AnyBand
+{
+public:
+    ///empty constructor
+    AnyBand()
+        :
+        m_type( PixelType::UInt8 ),
+        m_band()
+    {
+        ;
+    }
+
+    ///Takes ownership of band
+    template< typename T >
+    AnyBand(
+        Band< T >&& band )
+        :
+        m_type( pixel_type< T >() ),
+        m_band( new Model< T >( std::move( band ) ) )
+    {
+        ;
+    }
+
+    ///
+    template< typename T >
+    AnyBand(
+        Band< T > const& band )
+        :
+        m_type( pixel_type< T >() ),
+        m_band( new Model< T >( band ) )
+    {
+        ;
+    }
+
+    ///constructor
+    AnyBand(
+        PixelType type,
+        int width,
+        int height,
+        double nodataval,
+        double initval )
+        :
+        AnyBand( detail::with_pixel_type( type,
+            [ = ]( auto tag )
+            {
+                using T = typename decltype( tag )::type;
+                return AnyBand( Band< T >( width, height,
+                    Band< T >::cast( nodataval, true ),
+                    Band< T >::cast( initval, true ) ) );
+            } ) )
+    {
+        ;
+    }
+
+    ///copy constructor
+    AnyBand(
+        AnyBand const& o )
+        :
+        m_type( o.m_type ),
+        m_band( o.m_band ? o.m_band->clone() : nullptr )
+    {
+        ;
+    }
+
+    ///copy assignment operator
+    AnyBand& operator =(
+        AnyBand const& o )
+    {
+        AnyBand tmp( o );
+        return operator =( std::move( tmp ) );
+    }
+
+    ///move constructor
+    AnyBand( AnyBand&& ) = default;
+
+    ///move assignment operator
+    AnyBand& operator =( AnyBand&& ) = default;
+
+    ///destructor
+    ~AnyBand() = default;
+
+    ///
+    PixelType type() const
+    {
+        return m_type;
+    }
+
+    ///
+    bool empty() const
+    {
+        return !m_band;
+    }
+
+    ///
+    template< typename T >
+    bool is() const
+    {
+        return m_band && ( m_type == pixel_type< T >() );
+    }
+
+    ///
+    template< typename T >
+    Band< T >& get()
+    {
+        check< T >();
+        return static_cast< Model< T >& >( *m_band ).band;
+    }
+
+    ///
+    template< typename T >
+    Band< T > const& get() const
+    {
+        check< T >();
+        return static_cast< Model< T > const& >( *m_band ).band;
+    }
+
+    ///Calls fn( Band< T >& ) with the held band
+    template< typename F >
+    auto visit(
+        F&& fn ) -> decltype( fn( std::declval< Band< std::uint8_t >& >() ) )
+    {
+        if( !m_band ) throw std::runtime_error( "AnyBand::visit: empty band" );
+        return detail::with_pixel_type( m_type,
+            [ this, &fn ]( auto tag ) -> decltype( auto )
+            {
+                using T = typename decltype( tag )::type;
+                return fn( static_cast< Model< T >& >( *m_band ).band );
+            } );
+    }
+
+    ///Calls fn( Band< T > const& ) with the held band
+    template< typename F >
+    auto visit(
+        F&& fn ) const ->
+        decltype( fn( std::declval< Band< std::uint8_t > const& >() ) )
+    {
+        if( !m_band ) throw std::runtime_error( "AnyBand::visit: empty band" );
+        return detail::with_pixel_type( m_type,
+            [ this, &fn ]( auto tag ) -> decltype( auto )
+            {
+                using T = typename decltype( tag )::type;
+                return fn( static_cast< Model< T > const& >( *m_band ).band );
+            } );
+    }
+
+    ///
+    int width() const
+    {
+        return visit( []( auto const& b ) { return b.width(); } );
+    }
+
+    ///
+    int height() const
+    {
+        return visit( []( auto const& b ) { return b.height(); } );
+    }
+
+    ///
+    std::size_t size() const
+    {
+        return visit( []( auto const& b ) { return b.size(); } );
+    }
+
+    ///
+    double nodatavalue() const
+    {
+        return visit( []( auto const& b )
+            {
+                return static_cast< double >( b.nodatavalue() );
+            } );
+    }
+
+    ///
+    std::size_t count() const
+    {
+        return visit( []( auto const& b ) { return b.count(); } );
+    }
+
+    ///
+    double min() const
+    {
+        return visit( []( auto const& b )
+            {
+                return static_cast< double >( b.min() );
+            } );
+    }
+
+    ///
+    double max() const
+    {
+        return visit( []( auto const& b )
+            {
+                return static_cast< double >( b.max() );
+            } );
+    }
+
+    ///
+    double sum() const
+    {
+        return visit( []( auto const& b )
+            {
+                return static_cast< double >( b.sum() );
+            } );
+    }
+
+    ///
+    double avg() const
+    {
+        return visit( []( auto const& b ) { return b.avg(); } );
+    }
+
+    ///
+    AnyBand& operator *=(
+        double rhs )
+    {
+        visit( [ rhs ]( auto& b ) -> void { b *= rhs; } );
+        return *this;
+    }
+
+    ///Copy of the band converted to T
+    template< typename T >
+    Band< T > as(
+        bool clamp = false ) const
+    {
+        return visit( [ clamp ]( auto const& b )
+            {
+                return Band< T >( b, clamp );
+            } );
+    }
+
+    ///Copy of the band converted to type
+    AnyBand convert(
+        PixelType type,
+        bool clamp = false ) const
+    {
+        return detail::with_pixel_type( type,
+            [ this, clamp ]( auto tag )
+            {
+                using T = typename decltype( tag )::type;
+                return AnyBand( as< T >( clamp ) );
+            } );
+    }
+
+private:
+    ///
+    struct Concept
+    {
+        ///
+        virtual ~Concept() = default;
+
+        ///
+        virtual Concept* clone() const = 0;
+    };
+
+    ///
+    template< typename T >
+    struct Model : Concept
+    {
+        ///
+        template< typename B >
+        explicit Model(
+            B&& b )
+            :
+            band( std::forward< B >( b ) )
+        {
+            ;
+        }
+
+        ///
+        Concept* clone() const override
+        {
+            return new Model( band );
+        }
+
+        ///
+        Band< T > band;
+    };
+
+    ///
+    template< typename T >
+    void check() const
+    {
+        if( !is< T >() )
+        {
+            throw std::runtime_error( std::string( "AnyBand::get: band holds " ) +
+                ( m_band ? pixel_type_name( m_type ) : "nothing" ) + ", not " +
+                pixel_type_name( pixel_type< T >() ) );
+        }
+    }
+
+    ///
+    PixelType m_type;
+
+    ///
+    std::unique_ptr< Concept > m_band;
+};
+
+namespace detail
+{
+
+///Table of fn( Band< T > const&, Band< U > const& ) entries for every pair of
+///pixel types, built once per F and indexed by [ a.type() ][ b.type() ]
+template< typename R, typename F, std::size_t... Ks >
+R dispatch2(
+    F& fn,
+    AnyBand const& a,
+    AnyBand const& b,
+    std::index_sequence< Ks... > )
+{
+    using Entry = R ( * )( F&, AnyBand const&, AnyBand const& );
+    static Entry const table[] = { []( F& f, AnyBand const& x, AnyBand const& y )
+        {
+            using T = typename std::tuple_element<
+                Ks / PixelTypeCount, PixelTypes >::type;
+            using U = typename std::tuple_element<
+                Ks % PixelTypeCount, PixelTypes >::type;
+            return R( f( x.get< T >(), y.get< U >() ) );
+        }... };
+    return table[ static_cast< std::size_t >( a.type() ) * PixelTypeCount +
+        static_cast< std::size_t >( b.type() ) ]( fn, a, b );
+}
+
+///Whether op( t, u ) fits an int32_t for every T value t and U value u.
+///The extremes of +, - and * lie at the corners of the input ranges.
+template< typename T, typename U, typename Op >
+constexpr bool fits_int32()
+{
+    if( !std::is_integral< T >::value || !std::is_integral< U >::value ) return false;
+    double const ts[] = { static_cast< double >( std::numeric_limits< T >::lowest() ),
+        static_cast< double >( std::numeric_limits< T >::max() ) };
+    double const us[] = { static_cast< double >( std::numeric_limits< U >::lowest() ),
+        static_cast< double >( std::numeric_limits< U >::max() ) };
+    for( double t : ts )
+    {
+        for( double u : us )
+        {
+            double const v = Op()( t, u );
+            if( v < std::numeric_limits< std::int32_t >::lowest() ||
+                v > std::numeric_limits< std::int32_t >::max() ) return false;
+        }
+    }
+    return true;
+}
+
+///Pixel type of the result of a binary arithmetic operation: integer pairs
+///give int32_t when every result fits it and double otherwise (so mixed
+///signedness cannot wrap and 32 bit operands cannot overflow), floating
+///point gives the common type and division at least float
+template< typename T, typename U, typename Op, bool Divide >
+using arithmetic_result_t = typename std::conditional< Divide,
+    typename std::common_type< float, T, U >::type,
+    typename std::conditional< !Divide && fits_int32< T, U, Op >(), std::int32_t,
+        typename std::conditional<
+            std::is_integral< T >::value && std::is_integral< U >::value,
+            double, typename std::common_type< T, U >::type >::type >::type >::type;
+
+///
+template< typename R, typename T, typename U, typename Op >
+Band< R > binary_kernel(
+    Band< T > const& a,
+    Band< U > const& b,
+    Op op )
+{
+    if( a.width() != b.width() || a.height() != b.height() )
+    {
+        throw std::runtime_error( "gis::binary_kernel: "
+            "bands do not have the same width and height" );
+    }
+    Band< R > result;
+    R const nodata = Band< R >::cast( a.nodatavalue(), true );
+    result.copy_props( a, nodata, nodata );
+    T const* const pa = a.data();
+    U const* const pb = b.data();
+    R* const out = result.data();
+    T const na = a.nodatavalue();
+    U const nb = b.nodatavalue();
+    std::size_t const n = a.size();
+    for( std::size_t i = 0; i < n; ++i )
+    {
+        R const v = static_cast< R >( op( static_cast< R >( pa[ i ] ),
+            static_cast< R >( pb[ i ] ) ) );
+        out[ i ] = ( pa[ i ] == na || pb[ i ] == nb ) ? nodata : v;
+    }
+    return result;
+}
+
+///
+template< bool Divide, typename Op >
+struct ArithmeticOp
+{
+    ///
+    template< typename T, typename U >
+    AnyBand operator ()(
+        Band< T > const& a,
+        Band< U > const& b ) const
+    {
+        using R = arithmetic_result_t< T, U, Op, Divide >;
+        return AnyBand( binary_kernel< R >( a, b, Op() ) );
+    }
+};
+
+} //end detail
+
+///Calls fn( Band< T > const&, Band< U > const& ) through a precomputed
+///dispatch table
+template< typename R, typename F >
+R dispatch(
+    AnyBand const& a,
+    AnyBand const& b,
+    F&& fn )
+{
+    if( a.empty() || b.empty() )
+    {
+        throw std::runtime_error( "gis::dispatch: empty band" );
+    }
+    return detail::dispatch2< R >( fn, a, b,
+        std::make_index_sequence< PixelTypeCount * PixelTypeCount >{} );
+}
+
+///Pixel-wise sum in a type that holds every result (see
+///detail::arithmetic_result_t); nodata in either input gives nodata
+inline AnyBand operator +(
+    AnyBand const& a,
+    AnyBand const& b )
+{
+    return dispatch< AnyBand >( a, b,
+        detail::ArithmeticOp< false, std::plus<> >() );
+}
+
+///
+inline AnyBand operator -(
+    AnyBand const& a,
+    AnyBand const& b )
+{
+    return dispatch< AnyBand >( a, b,
+        detail::ArithmeticOp< false, std::minus<> >() );
+}
+
+///
+inline AnyBand operator *(
+    AnyBand const& a,
+    AnyBand const& b )
+{
+    return dispatch< AnyBand >( a, b,
+        detail::ArithmeticOp< false, std::multiplies<> >() );
+}
+
+///Pixel-wise quotient in floating point
+inline AnyBand operator /(
+    AnyBand const& a,
+    AnyBand const& b )
+{
+    return dispatch< AnyBand >( a, b,
+        detail::ArithmeticOp< true, std::divides<> >() );
+}
+
+} //end gis
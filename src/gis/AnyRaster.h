@@ -0,0 +1,179 @@
+/*******************************************************************************
+ *
+ * MIT License
+ *
+ * Copyright (c) 2018 Joshua Koch
+ * 
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ * 
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ * 
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ *
+ ******************************************************************************/
+
+#pragma once
+
+#include <gis/AnyBand.h>
+#include <gis/Raster.h>
+
+#include <stdexcept>
+#include <tuple>
+#include <utility>
+#include <vector>
+
+namespace gis
+{
+
+///Raster whose band count and pixel types are only known at runtime
+class AnyRaster
+{
+public:
+    ///
+    using Data = std::vector< AnyBand >;
+
+    ///
+    AnyRaster()
+        :
+        m_width( 0 ),
+        m_height( 0 ),
+        m_data()
+    {
+        ;
+    }
+
+    ///
+    explicit AnyRaster(
+        Data&& bands )
+        :
+        AnyRaster()
+    {
+        for( auto& b : bands ) push_back( std::move( b ) );
+    }
+
+    ///Takes ownership of the bands of raster
+    template< typename... Ts >
+    explicit AnyRaster(
+        Raster< Ts... >&& raster )
+        :
+        AnyRaster()
+    {
+        auto data = std::move( raster ).release();
+        append( data, std::index_sequence_for< Ts... >{} );
+    }
+
+    ///
+    int width() const
+    {
+        return m_width;
+    }
+
+    ///
+    int height() const
+    {
+        return m_height;
+    }
+
+    ///
+    std::size_t size() const
+    {
+        return m_data.size();
+    }
+
+    ///
+    AnyBand& band(
+        std::size_t i )
+    {
+        return m_data.at( i );
+    }
+
+    ///
+    AnyBand const& band(
+        std::size_t i ) const
+    {
+        return m_data.at( i );
+    }
+
+    ///
+    void push_back(
+        AnyBand&& band )
+    {
+        if( band.empty() )
+        {
+            throw std::runtime_error( "AnyRaster::push_back: empty band" );
+        }
+        if( m_data.empty() )
+        {
+            m_width = band.width();
+            m_height = band.height();
+        }
+        else if( band.width() != m_width || band.height() != m_height )
+        {
+            throw std::runtime_error( "AnyRaster::push_back: "
+                "band does not have the same width and height" );
+        }
+        m_data.push_back( std::move( band ) );
+    }
+
+    ///Moves the bands into a Raster< Ts... >; throws if the band count or
+    ///pixel types differ
+    template< typename... Ts >
+    Raster< Ts... > release() &&
+    {
+        if( sizeof...( Ts ) != m_data.size() )
+        {
+            throw std::runtime_error( "AnyRaster::release: band count differs" );
+        }
+        return release< Ts... >( std::index_sequence_for< Ts... >{} );
+    }
+
+private:
+    ///
+    template< typename Data, std::size_t... Ns >
+    void append(
+        Data& data,
+        std::index_sequence< Ns... > )
+    {
+        int expand[] = { 0,
+            ( push_back( AnyBand( std::move( std::get< Ns >( data ) ) ) ), 0 )... };
+        ( void )expand;
+    }
+
+    ///
+    template< typename... Ts, std::size_t... Ns >
+    Raster< Ts... > release(
+        std::index_sequence< Ns... > )
+    {
+        //Check every type before moving anything
+        int expand[] = { 0, ( m_data[ Ns ].template get< Ts >(), 0 )... };
+        ( void )expand;
+        Raster< Ts... > result(
+            std::move( m_data[ Ns ].template get< Ts >() )... );
+        m_data.clear();
+        m_width = m_height = 0;
+        return result;
+    }
+
+    ///
+    int m_width;
+
+    ///
+    int m_height;
+
+    ///
+    Data m_data;
+};
+
+} //end gis
@@ -26,25 +26,88 @@
 
 #pragma once
 
+#include <gis/Memory.h>
+#include <gis/Nodata.h>
+#include <gis/Stats.h>
+#include <gis/Trace.h>
 #include <safe_compare.h>
 
 #include <algorithm>
-#include <numeric>
+#include <cmath>
+#include <cstdint>
+#include <cstdlib>
+#include <iterator>
+#include <limits>
+#include <stdexcept>
+#include <string>
+#include <type_traits>
+#include <utility>
 #include <vector>
 
 namespace gis
 {
 
-///Band Class
-template< typename T, typename A = std::allocator< T >, typename =
-    typename std::enable_if< std::is_arithmetic< T >::value >::type >
+///Types a Band can hold
+template< typename T >
+struct is_pixel : std::is_arithmetic< T >
+{
+};
+
+///True for the 16 bit float pixel type (see Half.h)
+template< typename T >
+struct is_half : std::false_type
+{
+};
+
+///
+template< unsigned Bits >
+class PackedBand;
+
+///
+template< typename T >
+class MortonBand;
+
+///
+template< typename T >
+class SharedBand;
+
+namespace detail
+{
+
+///Element-wise conversion from U to T pixels appended to dst; specialized for
+///pixel types with bulk conversions
+template< typename T, typename U >
+struct Convert
+{
+    ///
+    template< typename D, typename Op >
+    static void run(
+        U const* src,
+        std::size_t n,
+        D& dst,
+        Op op )
+    {
+        dst.reserve( n );
+        std::transform( src, src + n, std::back_inserter( dst ), op );
+    }
+};
+
+} //end detail
+
+///Band Class; P is the nodata policy (see Nodata.h)
+template< typename T, typename A = Allocator< T >, typename =
+    typename std::enable_if< is_pixel< T >::value >::type,
+    typename P = nodata::Sentinel >
 class Band
 {
 public:
     ///Self friendship
-    template< typename U, typename B, typename >
+    template< typename U, typename B, typename, typename >
     friend class Band;
 
+    ///
+    using Policy = P;
+
     ///Forward declaration
     class RowAccessor;
     class ConstRowAccessor;
@@ -72,12 +135,43 @@ public:
         m_scalex( 0.0 ),
         m_scaley( 0.0 ),
         m_nodatavalue( limits( nodataval ) ),
-        m_data( m_height * m_width, limits( initval ) )
+        m_data(),
+        m_stats()
     {
         static_assert( std::is_arithmetic< N >::value,
             "Nodata value must be an arithmetic type" );
         static_assert( std::is_arithmetic< V >::value,
             "Initial value must be an arithmetic type" );
+        GISRASTER_TRACE_SCOPE( "Band::construct",
+            static_cast< std::size_t >( m_height ) * m_width,
+            static_cast< std::size_t >( m_height ) * m_width * sizeof( T ) );
+        T const v = limits( initval );
+        reset_pixels( &v );
+    }
+
+    ///constructor leaving the pixels unwritten, for bands about to be
+    ///overwritten; pages are first touched by whoever writes them
+    template< typename N >
+    Band(
+        int width,
+        int height,
+        N nodataval,
+        no_init_t )
+        :
+        m_upperleftx( 0.0 ),
+        m_upperlefty( 0.0 ),
+        m_width( width ),
+        m_height( height ),
+        m_srid( 0 ),
+        m_scalex( 0.0 ),
+        m_scaley( 0.0 ),
+        m_nodatavalue( limits( nodataval ) ),
+        m_data(),
+        m_stats()
+    {
+        static_assert( std::is_arithmetic< N >::value,
+            "Nodata value must be an arithmetic type" );
+        reset_pixels( nullptr );
     }
 
     ///constructor
@@ -110,13 +204,39 @@ public:
         ;
     }
 
+    ///Takes ownership of data, width * height row-major pixels
+    Band(
+        Data&& data,
+        int width,
+        int height,
+        T nodataval )
+        :
+        m_upperleftx( 0.0 ),
+        m_upperlefty( 0.0 ),
+        m_width( width ),
+        m_height( height ),
+        m_srid( 0 ),
+        m_scalex( 0.0 ),
+        m_scaley( 0.0 ),
+        m_nodatavalue( nodataval ),
+        m_data( std::move( data ) ),
+        m_stats()
+    {
+        if( m_data.size() != static_cast< std::size_t >( m_height ) * m_width )
+        {
+            throw std::invalid_argument(
+                "Band::Band: data size does not match width and height" );
+        }
+        seed_validity();
+    }
+
     ///copy constructor
     Band( Band const& ) = default;
 
-    ///template copy constructor
-    template< typename U >
+    ///template copy constructor; pixels missing in o are missing here
+    template< typename U, typename Q >
     Band(
-        Band< U > const& o,
+        Band< U, Allocator< U >, void, Q > const& o,
         bool clamp = false )
         :
         m_upperleftx( o.m_upperleftx ),
@@ -126,26 +246,83 @@ public:
         m_srid( o.m_srid ),
         m_scalex( o.m_scalex ),
         m_scaley( o.m_scaley ),
-        m_nodatavalue( limits( o.m_nodatavalue ) ),
-        m_data()
-    {
-        m_data.reserve( o.m_data.size() );
-        std::transform(
-            o.m_data.begin(), o.m_data.end(),
-            std::back_inserter( m_data ),
-            [ clamp ]( U val ) -> T
-            {
-                return limits( val, clamp );
-            } );
+        m_nodatavalue( nodata_from( o.m_nodatavalue ) ),
+        m_data(),
+        m_stats()
+    {
+        GISRASTER_TRACE_SCOPE( "Band::convert",
+            o.m_data.size(), o.m_data.size() * sizeof( T ) );
+        convert_from( o, clamp );
+    }
+
+    ///unpacking constructor
+    template< unsigned Bits >
+    explicit Band(
+        PackedBand< Bits > const& o )
+        :
+        m_upperleftx( o.upperleftx() ),
+        m_upperlefty( o.upperlefty() ),
+        m_width( o.width() ),
+        m_height( o.height() ),
+        m_srid( o.srid() ),
+        m_scalex( o.scalex() ),
+        m_scaley( o.scaley() ),
+        m_nodatavalue( limits( o.nodatavalue() ) ),
+        m_data(),
+        m_stats()
+    {
+        reset_pixels( nullptr );
+        o.unpack( m_data.data() );
+        seed_validity();
+    }
+
+    ///row-major copy of a Z-ordered band
+    explicit Band(
+        MortonBand< T > const& o )
+        :
+        m_upperleftx( o.upperleftx() ),
+        m_upperlefty( o.upperlefty() ),
+        m_width( o.width() ),
+        m_height( o.height() ),
+        m_srid( o.srid() ),
+        m_scalex( o.scalex() ),
+        m_scaley( o.scaley() ),
+        m_nodatavalue( o.nodatavalue() ),
+        m_data(),
+        m_stats()
+    {
+        reset_pixels( nullptr );
+        o.unpack( m_data.data() );
+        seed_validity();
+    }
+
+    ///row-major copy of a tile-shared band
+    explicit Band(
+        SharedBand< T > const& o )
+        :
+        m_upperleftx( o.upperleftx() ),
+        m_upperlefty( o.upperlefty() ),
+        m_width( o.width() ),
+        m_height( o.height() ),
+        m_srid( o.srid() ),
+        m_scalex( o.scalex() ),
+        m_scaley( o.scaley() ),
+        m_nodatavalue( o.nodatavalue() ),
+        m_data(),
+        m_stats()
+    {
+        reset_pixels( nullptr );
+        o.unpack( m_data.data() );
+        seed_validity();
     }
 
     ///copy assignment operator
     Band& operator =( Band const& ) = default;
 
     ///template copy assignment operator
-    template< typename U >
-    Band< T >& operator =(
-        Band< U > const& o )
+    template< typename U, typename Q >
+    Band& operator =(
+        Band< U, Allocator< U >, void, Q > const& o )
     {
         m_upperleftx = o.m_upperleftx;
         m_upperlefty = o.m_upperlefty;
@@ -154,18 +331,11 @@ public:
         m_srid = o.m_srid;
         m_scalex = o.m_scalex;
         m_scaley = o.m_scaley;
-        m_nodatavalue = limits( o.m_nodatavalue );
-
-        Data tmp;
-        tmp.reserve( o.m_data.size() );
-        std::transform(
-            o.m_data.begin(), o.m_data.end(),
-            std::back_inserter( tmp ),
-            []( U val ) -> T
-            {
-                return limits( val );
-            } );
-        m_data = std::move( tmp );
+        m_nodatavalue = nodata_from( o.m_nodatavalue );
+
+        Data().swap( m_data );
+        convert_from( o, false );
+        m_stats.invalidate();
         return *this;
     }
 
@@ -197,7 +367,7 @@ public:
         int r,
         int c ) const
     {
-        return oor_r( r ) && oor_c( c );
+        return oor_r( r ) || oor_c( c );
     }
 
     ///
@@ -216,7 +386,7 @@ public:
     {
         if( i >= m_data.size() ) throw std::out_of_range(
             "Band::rc: out of range" );
-        std::div_t res = std::div( i, m_width );
+        std::div_t res = std::div( static_cast< int >( i ), m_width );
         return { res.quot, res.rem };
     }
 
@@ -227,6 +397,43 @@ public:
         U val )
     {
         m_data.at( i ) = limits( val );
+        m_stats.mark( i, m_width );
+    }
+
+    ///Writes pixel ( r, c ) and marks its statistics tile dirty
+    template< typename U >
+    void set(
+        int r,
+        int c,
+        U val )
+    {
+        m_data[ idx( r, c ) ] = limits( val );
+        m_stats.mark( r, c );
+    }
+
+    ///Drops the cached statistics after writes they did not see
+    void touch()
+    {
+        m_stats.invalidate();
+    }
+
+    ///Marks the statistics tiles of rows [ r0, r1 ) and columns [ c0, c1 )
+    ///dirty after writes through operator(), at() or a pointer from data()
+    void touch(
+        int r0,
+        int c0,
+        int r1,
+        int c1 )
+    {
+        int constexpr size = detail::StatsCache< T >::TileSize;
+        r0 = std::max( r0, 0 );
+        c0 = std::max( c0, 0 );
+        r1 = std::min( r1, m_height );
+        c1 = std::min( c1, m_width );
+        for( int r = r0; r < r1; r = ( r / size + 1 ) * size )
+        {
+            for( int c = c0; c < c1; c = ( c / size + 1 ) * size ) m_stats.mark( r, c );
+        }
     }
 
     ///
@@ -247,7 +454,8 @@ public:
         return ConstRowAccessor( *this, r );
     }
 
-    ///
+    ///Writes through the reference are not seen by statistics cached
+    ///before them: write with set(), or call touch() after writing
     T& operator ()(
         int r,
         int c )
@@ -263,7 +471,7 @@ public:
         return m_data[ idx( r, c ) ];
     }
 
-    ///
+    ///Not seen by cached statistics when written; see operator()
     T& at(
         std::size_t i )
     {
@@ -277,7 +485,7 @@ public:
         return m_data.at( i );
     }
 
-    ///
+    ///Not seen by cached statistics when written; see operator()
     T& back()
     {
         return m_data.back();
@@ -289,7 +497,7 @@ public:
         return m_data.back();
     }
 
-    ///
+    ///Not seen by cached statistics when written; see operator()
     T& front()
     {
         return m_data.front();
@@ -308,6 +516,8 @@ public:
         T const val )
     {
         m_data.insert( m_data.begin() + ( r * c ), val );
+        m_valid.insert( static_cast< std::size_t >( r ) * c, val != m_nodatavalue );
+        m_stats.invalidate();
     }
 
     ///
@@ -316,9 +526,40 @@ public:
         return m_data.size();
     }
 
+    ///Bytes held by the pixel storage
+    std::size_t bytes() const
+    {
+        return m_data.capacity() * sizeof( T );
+    }
+
+    ///Bytes a width x height band holds
+    static std::size_t bytes(
+        int width,
+        int height )
+    {
+        return static_cast< std::size_t >( width ) * height * sizeof( T );
+    }
+
+    ///Raw row-major pixel storage; cached statistics are dropped since the
+    ///caller may write through it. Writes made after a later call that
+    ///caches statistics (summary(), count(), ...) are not seen: call touch()
+    ///after them.
+    T* data()
+    {
+        m_stats.invalidate();
+        return m_data.data();
+    }
+
     ///
+    T const* data() const
+    {
+        return m_data.data();
+    }
+
+    ///Drops cached statistics, as data() does, with the same caveat
     Iterator begin()
     {
+        m_stats.invalidate();
         return m_data.begin();
     }
 
@@ -331,6 +572,7 @@ public:
     ///
     Iterator end()
     {
+        m_stats.invalidate();
         return m_data.end();
     }
 
@@ -345,6 +587,11 @@ public:
     {
         return m_upperleftx;
     }
+    void upperleftx(
+        double val )
+    {
+        m_upperleftx = val;
+    }
 
     ///
     double lowerleftx() const
@@ -363,6 +610,11 @@ public:
     {
         return m_upperlefty;
     }
+    void upperlefty(
+        double val )
+    {
+        m_upperlefty = val;
+    }
 
     ///
     double upperrighty() const
@@ -444,7 +696,10 @@ public:
     void nodatavalue(
         T nodataval )
     {
+        static_assert( !std::is_same< P, nodata::NaN >::value,
+            "The nodata value of a NaN policy band is NaN" );
         m_nodatavalue = nodataval;
+        m_stats.invalidate();
     }
     template< typename N >
     void nodatavalue(
@@ -452,85 +707,184 @@ public:
     {
         static_assert( std::is_arithmetic< N >::value,
             "Nodata value must be an arithmetic type" );
+        static_assert( !std::is_same< P, nodata::NaN >::value,
+            "The nodata value of a NaN policy band is NaN" );
         m_nodatavalue = limits( nodataval );
+        m_stats.invalidate();
+    }
+
+    ///Whether pixel ( r, c ) holds data under the nodata policy
+    bool valid(
+        int r,
+        int c ) const
+    {
+        if( oor( r, c ) ) throw std::out_of_range( "Band::valid: out of range" );
+        std::size_t const i = static_cast< std::size_t >( r ) * m_width + c;
+        return m_valid.test( m_nodatavalue, 0 )( m_data[ i ], i );
+    }
+
+    ///Marks pixel ( r, c ) valid or missing; nodata::Mask bands only
+    void valid(
+        int r,
+        int c,
+        bool val )
+    {
+        if( oor( r, c ) ) throw std::out_of_range( "Band::valid: out of range" );
+        m_valid.set( static_cast< std::size_t >( r ) * m_width + c, val );
+        m_stats.mark( r, c );
+    }
+
+    ///Validity bytes, row-major; nodata::Mask bands only
+    std::uint8_t const* mask() const
+    {
+        return m_valid.mask();
+    }
+
+    ///Count, extremes and sum of the valid pixels; only tiles written since
+    ///the last query are recomputed
+    Summary< T > summary() const
+    {
+        return m_stats.summary( m_width, m_height, reducer() );
+    }
+
+    ///Summaries of the detail::StatsCache< T >::TileSize square tiles,
+    ///row-major
+    std::vector< Summary< T > > tile_summaries() const
+    {
+        return m_stats.tiles( m_width, m_height, reducer() );
+    }
+    void tile_summaries(
+        std::vector< Summary< T > > tiles )
+    {
+        m_stats.seed( std::move( tiles ), m_width, m_height );
+    }
+
+    ///Number of tiles the next statistics query recomputes
+    std::size_t stale_tiles() const
+    {
+        return m_stats.dirty();
     }
 
     ///
     std::size_t count() const
     {
-        return std::count_if( m_data.begin(), m_data.end(),
-            [ this ]( T val )
-            {
-                return ( val != m_nodatavalue );
-            } );
+        GISRASTER_TRACE_SCOPE( "Band::count", m_data.size(), 0 );
+        return summary().count;
     }
 
-    ///Need to double check these...
+    ///
     T min() const
     {
-        return *std::min_element( m_data.begin(), m_data.end(),
-            [ this ]( T lhs, T rhs )
-            {
-                if( lhs == m_nodatavalue ) return false;
-                if( rhs == m_nodatavalue ) return true;
-                return ( lhs < rhs );
-            } );
+        GISRASTER_TRACE_SCOPE( "Band::min", m_data.size(), 0 );
+        Summary< T > const s = summary();
+        return s.count ? s.min : m_nodatavalue;
     }
 
-    ///Need to double check these...
+    ///
     T max() const
     {
-        return *std::max_element( m_data.begin(), m_data.end(),
-            [ this ]( T lhs, T rhs )
-            {
-                if( rhs == m_nodatavalue ) return false;
-                if( lhs == m_nodatavalue ) return true;
-                return ( lhs < rhs );
-            } );
+        GISRASTER_TRACE_SCOPE( "Band::max", m_data.size(), 0 );
+        Summary< T > const s = summary();
+        return s.count ? s.max : m_nodatavalue;
     }
 
     ///
     T sum() const
     {
-        return std::accumulate( m_data.begin(), m_data.end(), 0,
-            [ this ]( T lhs, T rhs )
-            {
-                return ( rhs == m_nodatavalue ) ? lhs : lhs + rhs;
-            } );
+        GISRASTER_TRACE_SCOPE( "Band::sum", m_data.size(), 0 );
+        return static_cast< T >( summary().sum );
     }
 
     ///
     double avg() const
     {
-        return sum() / static_cast< double >( count() );
+        Summary< T > const s = summary();
+        return static_cast< double >( s.sum ) / static_cast< double >( s.count );
     }
 
     ///
     template< typename U >
-    Band< T >& operator *=(
+    Band& operator *=(
         U rhs )
     {
         static_assert( std::is_arithmetic< U >::value,
             "Multiplication requires arithmetic type" );
-        for( auto& v : m_data )
+        GISRASTER_TRACE_SCOPE( "Band::multiply", m_data.size(), 0 );
+        T const f = limits( rhs );
+        auto const valid = m_valid.test( m_nodatavalue, 0 );
+        T* const p = m_data.data();
+        //Branch free so the loop vectorizes; the test folds away without
+        //nodata
+        for( std::size_t i = 0; i < m_data.size(); ++i )
         {
-            if( v == m_nodatavalue ) continue;
-            v *= limits( rhs );
+            T const v = p[ i ];
+            p[ i ] = valid( v, i ) ? T( v * f ) : v;
         }
+        m_stats.invalidate();
         return *this;
     }
 
+    ///Band of the classes table assigns to each pixel (see Reclassify.h);
+    ///nodata pixels become nodataval
+    template< typename Table >
+    Band< typename Table::Output > reclassify(
+        Table const& table,
+        typename Table::Output nodataval ) const
+    {
+        static_assert( std::is_same< typename Table::Input, T >::value,
+            "Reclassification table must take the band pixel type" );
+        static_assert( std::is_same< P, nodata::Sentinel >::value,
+            "Reclassification needs the sentinel nodata policy" );
+        GISRASTER_TRACE_SCOPE( "Band::reclassify", m_data.size(),
+            m_data.size() * sizeof( typename Table::Output ) );
+        Band< typename Table::Output > result;
+        result.copy_props( *this, nodataval, no_init );
+        table.apply( m_data.data(), m_data.size(), m_nodatavalue,
+            result.data(), nodataval );
+        return result;
+    }
+
+    ///Nodata pixels keep the (clamped) nodata value
+    template< typename Table >
+    Band< typename Table::Output > reclassify(
+        Table const& table ) const
+    {
+        return reclassify( table,
+            Band< typename Table::Output >::cast( m_nodatavalue, true ) );
+    }
+
+    ///Additional bytes transpose() allocates
+    std::size_t transpose_footprint() const
+    {
+        return m_data.size() * sizeof( T );
+    }
+
     ///
     Band transpose()
     {
-        Band result = *this;
-        result.m_height = m_width;
+        GISRASTER_TRACE_SCOPE( "Band::transpose",
+            m_data.size(), m_data.size() * sizeof( T ) );
+        MemoryAccountant::current().check( transpose_footprint() );
+        //Every pixel is overwritten below, so start from the properties
+        //only instead of a copy of the pixels
+        Band result;
+        result.m_upperleftx = m_upperleftx;
+        result.m_upperlefty = m_upperlefty;
         result.m_width = m_height;
+        result.m_height = m_width;
+        result.m_srid = m_srid;
+        result.m_scalex = m_scalex;
+        result.m_scaley = m_scaley;
+        result.m_nodatavalue = m_nodatavalue;
+        result.reset_pixels( nullptr );
+        result.m_valid = m_valid;
+        result.m_valid.transpose( m_width, m_height );
         for( int r = 0; r < m_height; ++r )
         {
-            for( int c = 0; c < m_width; ++j )
+            for( int c = 0; c < m_width; ++c )
             {
-                result( c, r ) = operator ()( r, c );
+                result.m_data[ static_cast< std::size_t >( c ) * m_height + r ] =
+                    m_data[ static_cast< std::size_t >( r ) * m_width + c ];
             }
         }
         return result;
@@ -555,7 +909,28 @@ public:
         m_scalex = o.m_scalex;
         m_scaley = o.m_scaley;
         m_nodatavalue = limits( nodataval );
-        m_data.assign( o.size(), limits( initval ) );
+        T const v = limits( initval );
+        reset_pixels( &v );
+    }
+
+    ///Copies the properties of o and leaves the pixels unwritten
+    template< typename U, typename N >
+    void copy_props(
+        Band< U > const& o,
+        N nodataval,
+        no_init_t )
+    {
+        static_assert( std::is_arithmetic< N >::value,
+            "Nodata value must be an arithmetic type" );
+        m_upperleftx = o.m_upperleftx;
+        m_upperlefty = o.m_upperlefty;
+        m_width = o.m_width;
+        m_height = o.m_height;
+        m_srid = o.m_srid;
+        m_scalex = o.m_scalex;
+        m_scaley = o.m_scaley;
+        m_nodatavalue = limits( nodataval );
+        reset_pixels( nullptr );
     }
 
     ///
@@ -579,10 +954,20 @@ public:
     void init(
         T initval )
     {
-        for( auto& v : m_data ) v = initval;
+        fill_rows( m_data.data(), initval );
+        seed_validity();
+        m_stats.invalidate();
+    }
+
+    ///Converts a value to the pixel type (see limits)
+    template< typename U >
+    static T cast(
+        U val,
+        bool clamp = false )
+    {
+        return limits( val, clamp );
     }
 
-private:
     ///
     class RowAccessor
     {
@@ -598,7 +983,7 @@ private:
             ;
         }
 
-        ///
+        ///Not seen by cached statistics when written; see Band::touch
         T& operator [](
             int col )
         {
@@ -643,6 +1028,99 @@ private:
         int m_row;
     };
 
+private:
+    ///Fewest pixels worth a first touch task
+    static constexpr std::size_t FirstTouchGrain = std::size_t( 1 ) << 16;
+
+    ///Writes v to every pixel of p in row bands split like parallel_for
+    ///over rows, so each page is first touched (and placed) by a worker
+    void fill_rows(
+        T* p,
+        T v ) const
+    {
+        int const grain = static_cast< int >( std::max< std::size_t >( 1,
+            FirstTouchGrain / static_cast< std::size_t >( std::max( 1, m_width ) ) ) );
+        std::size_t const w = static_cast< std::size_t >( m_width );
+        parallel_for( 0, m_height, [ p, v, w ]( int begin, int end )
+            {
+                std::fill( p + begin * w, p + end * w, v );
+            }, grain );
+    }
+
+    ///Replaces the pixels with width x height unwritten ones, filled with
+    ///*value when given
+    void reset_pixels(
+        T const* value )
+    {
+        std::size_t const n = static_cast< std::size_t >( m_height ) * m_width;
+        if( m_data.size() != n )
+        {
+            Data().swap( m_data );
+            detail::DefaultInit scope;
+            m_data.resize( n );
+        }
+        if( value ) fill_rows( m_data.data(), *value );
+        m_nodatavalue = m_valid.seed( value ? m_data.data() : nullptr, n,
+            m_nodatavalue );
+        m_stats.invalidate();
+    }
+
+    ///Lets the nodata policy mark the pixels equal to the nodata value
+    ///missing after the pixels were set in bulk
+    void seed_validity()
+    {
+        m_nodatavalue = m_valid.seed( m_data.data(), m_data.size(), m_nodatavalue );
+    }
+
+    ///Statistics reduction of the pixels from index i on
+    auto reducer() const
+    {
+        return [ this ]( std::size_t i, std::size_t n, Summary< T >& s )
+        {
+            m_valid.summarize( m_data.data() + i, n, m_nodatavalue, i, s );
+        };
+    }
+
+    ///Nodata value converted from another pixel type. NaN stays NaN only
+    ///under nodata::NaN and becomes Lowest otherwise: a NaN sentinel would
+    ///compare unequal to every pixel, NaN ones included.
+    template< typename U >
+    static T nodata_from(
+        U nodataval )
+    {
+        if( nodataval == nodataval ) return limits( nodataval );
+        return std::is_same< P, nodata::NaN >::value ?
+            std::numeric_limits< T >::quiet_NaN() : Lowest;
+    }
+
+    ///Converts the pixels of o; pixels missing in o become m_nodatavalue
+    template< typename U, typename Q >
+    void convert_from(
+        Band< U, Allocator< U >, void, Q > const& o,
+        bool clamp )
+    {
+        if( std::is_same< Q, nodata::Sentinel >::value ||
+            std::is_same< Q, nodata::None >::value )
+        {
+            detail::Convert< T, U >::run( o.m_data.data(), o.m_data.size(), m_data,
+                [ clamp ]( U val ) -> T
+                {
+                    return limits( val, clamp );
+                } );
+        }
+        else
+        {
+            auto const valid = o.m_valid.test( o.m_nodatavalue, 0 );
+            m_data.resize( o.m_data.size() );
+            for( std::size_t i = 0; i < m_data.size(); ++i )
+            {
+                U const v = o.m_data[ i ];
+                m_data[ i ] = valid( v, i ) ? limits( v, clamp ) : m_nodatavalue;
+            }
+        }
+        seed_validity();
+    }
+
     ///
     static constexpr T limits(
         T val,
@@ -653,16 +1131,60 @@ private:
 
     ///
     template< typename U >
-    static constexpr T limits(
+    static T limits(
         U val,
         bool clamp = false )
     {
-        static constexpr bool is_ftoi_v =
+        return limits( val, clamp, std::integral_constant< int,
+            is_half< T >::value ? 1 : ( is_half< U >::value ? 2 : 0 ) >{} );
+    }
+
+    ///To half: range checked in float
+    template< typename U >
+    static T limits(
+        U val,
+        bool clamp,
+        std::integral_constant< int, 1 > )
+    {
+        float const f = static_cast< float >( val );
+        if( f < static_cast< float >( Lowest ) )
+        {
+            if( clamp ) return Lowest;
+            throw std::out_of_range(
+                "Band::limits: value too small " + std::to_string( val ) );
+        }
+        else if( f > static_cast< float >( Max ) )
+        {
+            if( clamp ) return Max;
+            throw std::out_of_range(
+                "Band::limits: value too large " + std::to_string( val ) );
+        }
+        return T( f );
+    }
+
+    ///From half: widened to float first
+    template< typename U >
+    static T limits(
+        U val,
+        bool clamp,
+        std::integral_constant< int, 2 > )
+    {
+        return limits( static_cast< float >( val ), clamp );
+    }
+
+    ///
+    template< typename U >
+    static constexpr T limits(
+        U val,
+        bool clamp,
+        std::integral_constant< int, 0 > )
+    {
+        constexpr bool is_ftoi_v =
             std::is_integral< T >::value && std::is_floating_point< U >::value;
         if( is_ftoi_v ) val = static_cast< U >( std::round( val ) );
 
-        static safe_compare::less< U, T > sless;
-        static safe_compare::greater< U, T > sgreater;
+        safe_compare::less< U, T > sless{};
+        safe_compare::greater< U, T > sgreater{};
         if( sless( val, Lowest ) )
         {
             if( clamp ) return Lowest;
@@ -710,8 +1232,34 @@ private:
 
     ///
     Data m_data;
+
+    ///Validity state of the nodata policy, empty unless P is nodata::Mask
+    detail::Validity< T, P > m_valid;
+
+    ///Per tile statistics, see Stats.h
+    detail::StatsCache< T > m_stats;
 };
 
+///
+template< typename T, typename A, typename E, typename P >
+constexpr T Band< T, A, E, P >::Lowest;
+
+///
+template< typename T, typename A, typename E, typename P >
+constexpr T Band< T, A, E, P >::Max;
+
+///Band without nodata: statistics and arithmetic test no pixel
+template< typename T >
+using DenseBand = Band< T, Allocator< T >, void, nodata::None >;
+
+///Band whose missing pixels are NaN
+template< typename T >
+using NanBand = Band< T, Allocator< T >, void, nodata::NaN >;
+
+///Band with a validity byte per pixel
+template< typename T >
+using MaskedBand = Band< T, Allocator< T >, void, nodata::Mask >;
+
 ///
 template< typename T >
 inline auto begin(
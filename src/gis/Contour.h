@@ -0,0 +1,787 @@
+/*******************************************************************************
+ *
+ * MIT License
+ *
+ * Copyright (c) 2018 Joshua Koch
+ * 
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ * 
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ * 
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ *
+ ******************************************************************************/
+
+#pragma once
+
+#include <gis/Band.h>
+#include <gis/Geometry.h>
+#include <gis/Parallel.h>
+#include <gis/Pipeline.h>
+#include <gis/Trace.h>
+
+#include <algorithm>
+#include <cstdint>
+#include <deque>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <stdexcept>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+
+namespace gis
+{
+
+///Isoline at one level, through pixel centers. Lines run with higher values
+///on their right, so lines around a summit run clockwise on a north-up map;
+///closed lines end on their first vertex.
+struct Contour
+{
+    ///
+    double level;
+
+    ///
+    LineString line;
+
+    ///
+    bool closed;
+};
+
+namespace detail
+{
+
+///Rows of each parallel contour strip
+static constexpr int ContourStrip = 256;
+
+///Levels sorted, without repeats
+inline std::vector< double > contour_levels(
+    std::vector< double > levels )
+{
+    std::sort( levels.begin(), levels.end() );
+    levels.erase( std::unique( levels.begin(), levels.end() ), levels.end() );
+    return levels;
+}
+
+///
+inline Contour contour_line(
+    double level,
+    std::deque< Point > const& points,
+    bool closed )
+{
+    return Contour{ level, LineString( points.begin(), points.end() ), closed };
+}
+
+///Open contour pieces of each level, joined on the cell edges their ends
+///lie on
+class ContourStitcher
+{
+public:
+    ///
+    struct Piece
+    {
+        ///Index into the sorted levels
+        int level;
+
+        ///Edge keys of the first and last vertex
+        std::uint64_t head;
+
+        ///
+        std::uint64_t tail;
+
+        ///
+        std::deque< Point > points;
+    };
+
+    ///
+    explicit ContourStitcher(
+        std::size_t levels )
+        :
+        m_pieces(),
+        m_live(),
+        m_free(),
+        m_heads( levels ),
+        m_tails( levels )
+    {
+        ;
+    }
+
+    ///Joins piece to the open pieces ending where it starts and starting
+    ///where it ends; returns the id of the joined piece and sets closed when
+    ///the piece closed a ring
+    int add(
+        Piece&& piece,
+        bool& closed )
+    {
+        auto& heads = m_heads[ piece.level ];
+        auto& tails = m_tails[ piece.level ];
+        int const t = find( tails, piece.head );
+        int const h = find( heads, piece.tail );
+        closed = false;
+        if( t < 0 && h < 0 )
+        {
+            int const id = allocate( std::move( piece ) );
+            heads[ m_pieces[ id ].head ] = id;
+            tails[ m_pieces[ id ].tail ] = id;
+            return id;
+        }
+
+        tails.erase( piece.head );
+        heads.erase( piece.tail );
+        if( t == h )
+        {
+            Piece& ring = m_pieces[ t ];
+            ring.points.insert( ring.points.end(), piece.points.begin() + 1,
+                piece.points.end() );
+            ring.tail = piece.tail;
+            closed = true;
+            return t;
+        }
+        if( h < 0 )
+        {
+            Piece& before = m_pieces[ t ];
+            before.points.insert( before.points.end(), piece.points.begin() + 1,
+                piece.points.end() );
+            before.tail = piece.tail;
+            tails[ before.tail ] = t;
+            return t;
+        }
+        if( t < 0 )
+        {
+            Piece& after = m_pieces[ h ];
+            after.points.insert( after.points.begin(), piece.points.begin(),
+                piece.points.end() - 1 );
+            after.head = piece.head;
+            heads[ after.head ] = h;
+            return h;
+        }
+
+        //Bridges two pieces: the shorter one moves into the longer
+        Piece& before = m_pieces[ t ];
+        Piece& after = m_pieces[ h ];
+        if( before.points.size() >= after.points.size() )
+        {
+            before.points.insert( before.points.end(), piece.points.begin() + 1,
+                piece.points.end() - 1 );
+            before.points.insert( before.points.end(), after.points.begin(),
+                after.points.end() );
+            before.tail = after.tail;
+            tails[ before.tail ] = t;
+            release( h );
+            return t;
+        }
+        after.points.insert( after.points.begin(), piece.points.begin() + 1,
+            piece.points.end() - 1 );
+        after.points.insert( after.points.begin(), before.points.begin(),
+            before.points.end() );
+        after.head = before.head;
+        heads[ after.head ] = h;
+        release( t );
+        return h;
+    }
+
+    ///
+    bool live(
+        int id ) const
+    {
+        return id >= 0 && static_cast< std::size_t >( id ) < m_live.size() && m_live[ id ];
+    }
+
+    ///
+    Piece const& piece(
+        int id ) const
+    {
+        return m_pieces[ id ];
+    }
+
+    ///Removes piece id and returns it
+    Piece take(
+        int id )
+    {
+        Piece p = std::move( m_pieces[ id ] );
+        auto& heads = m_heads[ p.level ];
+        auto& tails = m_tails[ p.level ];
+        auto hi = heads.find( p.head );
+        if( hi != heads.end() && hi->second == id ) heads.erase( hi );
+        auto ti = tails.find( p.tail );
+        if( ti != tails.end() && ti->second == id ) tails.erase( ti );
+        release( id );
+        return p;
+    }
+
+    ///Ids of the open pieces
+    std::vector< int > pieces() const
+    {
+        std::vector< int > result;
+        for( std::size_t i = 0; i < m_live.size(); ++i )
+        {
+            if( m_live[ i ] ) result.push_back( static_cast< int >( i ) );
+        }
+        return result;
+    }
+
+private:
+    ///
+    using Ends = std::unordered_map< std::uint64_t, int >;
+
+    ///
+    static int find(
+        Ends const& ends,
+        std::uint64_t key )
+    {
+        auto const it = ends.find( key );
+        return ( it == ends.end() ) ? -1 : it->second;
+    }
+
+    ///
+    int allocate(
+        Piece&& piece )
+    {
+        if( m_free.empty() )
+        {
+            m_pieces.push_back( std::move( piece ) );
+            m_live.push_back( true );
+            return static_cast< int >( m_pieces.size() - 1 );
+        }
+        int const id = m_free.back();
+        m_free.pop_back();
+        m_pieces[ id ] = std::move( piece );
+        m_live[ id ] = true;
+        return id;
+    }
+
+    ///
+    void release(
+        int id )
+    {
+        m_pieces[ id ].points = std::deque< Point >();
+        m_live[ id ] = false;
+        m_free.push_back( id );
+    }
+
+    ///
+    std::vector< Piece > m_pieces;
+
+    ///
+    std::vector< bool > m_live;
+
+    ///
+    std::vector< int > m_free;
+
+    ///Pieces by the edge key of their first vertex, per level
+    std::vector< Ends > m_heads;
+
+    ///Pieces by the edge key of their last vertex, per level
+    std::vector< Ends > m_tails;
+};
+
+///Marching squares over rows pushed top to bottom, two rows at a time.
+///Lines are handed to emit as soon as no later row can extend them; ends on
+///the first row (seam_top) or the last row (seam_bottom) of a strip are held
+///back for seam merging.
+template< typename T >
+class ContourTracer
+{
+public:
+    ///
+    using Piece = ContourStitcher::Piece;
+
+    ///
+    ContourTracer(
+        Grid const& grid,
+        T nodata,
+        std::vector< double > const& levels,
+        std::function< void( Contour&& ) > emit,
+        int first_row = 0,
+        bool seam_top = false )
+        :
+        m_width( grid.width ),
+        m_upperleftx( grid.upperleftx ),
+        m_upperlefty( grid.upperlefty ),
+        m_scalex( grid.scalex != 0.0 ? grid.scalex : 1.0 ),
+        m_scaley( grid.scaley != 0.0 ? grid.scaley : 1.0 ),
+        m_nodata( nodata ),
+        m_levels( contour_levels( levels ) ),
+        m_emit( std::move( emit ) ),
+        m_first( first_row ),
+        m_row( first_row - 1 ),
+        m_seam_top( seam_top ),
+        m_above( grid.width ),
+        m_below( grid.width ),
+        m_valid_above( grid.width ),
+        m_valid_below( grid.width ),
+        m_stitcher( levels.size() ),
+        m_pending(),
+        m_touched()
+    {
+        ;
+    }
+
+    ///Adds the next row of width values
+    void push(
+        T const* row )
+    {
+        std::swap( m_above, m_below );
+        std::swap( m_valid_above, m_valid_below );
+        for( int c = 0; c < m_width; ++c )
+        {
+            m_valid_below[ c ] = ( row[ c ] != m_nodata && row[ c ] == row[ c ] );
+            m_below[ c ] = static_cast< double >( row[ c ] );
+        }
+        if( ++m_row > m_first ) cells();
+    }
+
+    ///Emits the remaining lines; with seams given, lines with an end on the
+    ///first or last row go there instead
+    void finish(
+        std::vector< Piece >* seams = nullptr )
+    {
+        for( int id : m_stitcher.pieces() )
+        {
+            Piece const& p = m_stitcher.piece( id );
+            if( seams && ( open( p.head ) || open( p.tail ) ) )
+            {
+                seams->push_back( m_stitcher.take( id ) );
+            }
+            else
+            {
+                emit( m_stitcher.take( id ), false );
+            }
+        }
+    }
+
+    ///
+    static std::uint64_t key(
+        int row,
+        int col,
+        bool vertical )
+    {
+        return ( static_cast< std::uint64_t >( row ) << 33 ) |
+            ( static_cast< std::uint64_t >( col ) << 1 ) | ( vertical ? 1u : 0u );
+    }
+
+    ///
+    static int key_row(
+        std::uint64_t key )
+    {
+        return static_cast< int >( key >> 33 );
+    }
+
+    ///
+    static bool key_vertical(
+        std::uint64_t key )
+    {
+        return ( key & 1u ) != 0;
+    }
+
+private:
+    ///
+    void emit(
+        Piece const& piece,
+        bool closed )
+    {
+        m_emit( contour_line( m_levels[ piece.level ], piece.points, closed ) );
+    }
+
+    ///True while a later row of this tracer can extend an end on edge key
+    bool open(
+        std::uint64_t key ) const
+    {
+        return !key_vertical( key ) &&
+            ( key_row( key ) == m_row || ( m_seam_top && key_row( key ) == m_first ) );
+    }
+
+    ///Crossing of level on an edge, interpolated from its top or left
+    ///corner so both cells sharing the edge compute the same point
+    Point crossing(
+        int edge,
+        int c,
+        double level ) const
+    {
+        double row = m_row;
+        double col = c;
+        double v0 = 0.0;
+        double v1 = 0.0;
+        switch( edge )
+        {
+        case 0: //top
+            row -= 1.0;
+            v0 = m_above[ c ];
+            v1 = m_above[ c + 1 ];
+            break;
+        case 1: //right
+            col += 1.0;
+            v0 = m_above[ c + 1 ];
+            v1 = m_below[ c + 1 ];
+            break;
+        case 2: //bottom
+            v0 = m_below[ c ];
+            v1 = m_below[ c + 1 ];
+            break;
+        default: //left
+            v0 = m_above[ c ];
+            v1 = m_below[ c ];
+            break;
+        }
+        double const t = ( level - v0 ) / ( v1 - v0 );
+        if( edge == 0 || edge == 2 )
+        {
+            col += t;
+        }
+        else
+        {
+            row += t - 1.0;
+        }
+        return { m_upperleftx + ( col + 0.5 ) * m_scalex,
+            m_upperlefty + ( row + 0.5 ) * m_scaley };
+    }
+
+    ///
+    std::uint64_t edge_key(
+        int edge,
+        int c ) const
+    {
+        switch( edge )
+        {
+        case 0:
+            return key( m_row - 1, c, false );
+        case 1:
+            return key( m_row, c + 1, true );
+        case 2:
+            return key( m_row, c, false );
+        default:
+            return key( m_row, c, true );
+        }
+    }
+
+    ///Segments of the cell row between rows m_row - 1 and m_row
+    void cells()
+    {
+        m_touched.clear();
+        for( int c = 0; c + 1 < m_width; ++c )
+        {
+            if( !( m_valid_above[ c ] && m_valid_above[ c + 1 ] &&
+                m_valid_below[ c ] && m_valid_below[ c + 1 ] ) )
+            {
+                continue;
+            }
+            //Corners clockwise from the top left
+            double const v[ 4 ] = { m_above[ c ], m_above[ c + 1 ],
+                m_below[ c + 1 ], m_below[ c ] };
+            double const lo = std::min( std::min( v[ 0 ], v[ 1 ] ), std::min( v[ 2 ], v[ 3 ] ) );
+            double const hi = std::max( std::max( v[ 0 ], v[ 1 ] ), std::max( v[ 2 ], v[ 3 ] ) );
+            auto first = std::upper_bound( m_levels.begin(), m_levels.end(), lo );
+            for( auto it = first; it != m_levels.end() && *it <= hi; ++it )
+            {
+                cell( c, static_cast< int >( it - m_levels.begin() ), v );
+            }
+        }
+
+        //Lines with no end left on the bottom row are complete
+        std::vector< int > next;
+        for( auto* list : { &m_pending, &m_touched } )
+        {
+            for( int id : *list )
+            {
+                if( !m_stitcher.live( id ) ) continue;
+                Piece const& p = m_stitcher.piece( id );
+                if( !open( p.head ) && !open( p.tail ) )
+                {
+                    emit( m_stitcher.take( id ), false );
+                }
+                else if( key_row( p.head ) == m_row || key_row( p.tail ) == m_row )
+                {
+                    next.push_back( id );
+                }
+            }
+        }
+        std::sort( next.begin(), next.end() );
+        next.erase( std::unique( next.begin(), next.end() ), next.end() );
+        std::swap( m_pending, next );
+    }
+
+    ///Segments of one cell at level index li. Each edge the clockwise walk
+    ///leaves the level on is joined to an edge it enters on: saddles keep
+    ///the pair of corners on the side of the cell mean connected.
+    void cell(
+        int c,
+        int li,
+        double const* v )
+    {
+        double const level = m_levels[ li ];
+        bool in[ 4 ];
+        for( int i = 0; i < 4; ++i ) in[ i ] = ( v[ i ] >= level );
+        bool const center = ( 0.25 * ( v[ 0 ] + v[ 1 ] + v[ 2 ] + v[ 3 ] ) >= level );
+        for( int i = 0; i < 4; ++i )
+        {
+            if( !( in[ i ] && !in[ ( i + 1 ) % 4 ] ) ) continue;
+            int j = i;
+            for( int step = 1; step < 4; ++step )
+            {
+                int const e = center ? ( i + step ) % 4 : ( i + 4 - step ) % 4;
+                if( !in[ e ] && in[ ( e + 1 ) % 4 ] )
+                {
+                    j = e;
+                    break;
+                }
+            }
+            Piece piece{ li, edge_key( i, c ), edge_key( j, c ),
+                std::deque< Point >{ crossing( i, c, level ), crossing( j, c, level ) } };
+            bool closed = false;
+            int const id = m_stitcher.add( std::move( piece ), closed );
+            if( closed )
+            {
+                emit( m_stitcher.take( id ), true );
+            }
+            else
+            {
+                m_touched.push_back( id );
+            }
+        }
+    }
+
+    ///
+    int m_width;
+
+    ///
+    double m_upperleftx;
+
+    ///
+    double m_upperlefty;
+
+    ///
+    double m_scalex;
+
+    ///
+    double m_scaley;
+
+    ///
+    T m_nodata;
+
+    ///Sorted, distinct
+    std::vector< double > m_levels;
+
+    ///
+    std::function< void( Contour&& ) > m_emit;
+
+    ///Row of the first push
+    int m_first;
+
+    ///Row of the last push
+    int m_row;
+
+    ///
+    bool m_seam_top;
+
+    ///
+    std::vector< double > m_above;
+
+    ///
+    std::vector< double > m_below;
+
+    ///
+    std::vector< char > m_valid_above;
+
+    ///
+    std::vector< char > m_valid_below;
+
+    ///
+    ContourStitcher m_stitcher;
+
+    ///Pieces with an end on the bottom row after the previous cell row
+    std::vector< int > m_pending;
+
+    ///Pieces extended by the current cell row
+    std::vector< int > m_touched;
+};
+
+} //end detail
+
+///Streaming contour extraction: push rows top to bottom, keeping two rows
+///and the open line ends in memory. emit receives each line as soon as it
+///is complete.
+template< typename T >
+class ContourBuilder
+{
+public:
+    ///
+    ContourBuilder(
+        Grid const& grid,
+        T nodata,
+        std::vector< double > const& levels,
+        std::function< void( Contour&& ) > emit )
+        :
+        m_tracer( grid, nodata, levels, std::move( emit ) )
+    {
+        ;
+    }
+
+    ///Adds the next row of grid.width values
+    void push(
+        T const* row )
+    {
+        m_tracer.push( row );
+    }
+
+    ///Emits the lines still open, ending on the last row or on nodata
+    void finish()
+    {
+        m_tracer.finish();
+    }
+
+private:
+    ///
+    detail::ContourTracer< T > m_tracer;
+};
+
+///Pipeline sink tracing contours of the streamed rows
+template< typename T >
+class ContourSink : public Sink< T >
+{
+public:
+    ///
+    ContourSink(
+        std::vector< double > levels,
+        std::function< void( Contour&& ) > emit )
+        :
+        m_levels( std::move( levels ) ),
+        m_emit( std::move( emit ) ),
+        m_width( 0 ),
+        m_tracer()
+    {
+        ;
+    }
+
+    ///
+    void open(
+        Grid const& grid,
+        T nodata ) override
+    {
+        m_width = grid.width;
+        m_tracer.reset( new detail::ContourTracer< T >( grid, nodata, m_levels, m_emit ) );
+    }
+
+    ///
+    void write(
+        int,
+        int rows,
+        T const* in ) override
+    {
+        for( int r = 0; r < rows; ++r )
+        {
+            m_tracer->push( in + static_cast< std::size_t >( r ) * m_width );
+        }
+    }
+
+    ///
+    void close() override
+    {
+        m_tracer->finish();
+    }
+
+private:
+    ///
+    std::vector< double > m_levels;
+
+    ///
+    std::function< void( Contour&& ) > m_emit;
+
+    ///
+    int m_width;
+
+    ///
+    std::unique_ptr< detail::ContourTracer< T > > m_tracer;
+};
+
+///Contours of band at levels, traced over parallel row strips whose
+///open ends are merged across the seams afterwards. Cells with a nodata
+///corner are skipped, leaving holes the lines end at. emit( Contour&& ) is
+///called as lines complete, never concurrently.
+template< typename T, typename F >
+void contours(
+    Band< T > const& band,
+    std::vector< double > const& levels,
+    F&& emit )
+{
+    GISRASTER_TRACE_SCOPE( "contours", band.size(), 0 );
+    int const w = band.width();
+    int const h = band.height();
+    if( w < 2 || h < 2 || levels.empty() ) return;
+    Grid const grid = grid_of( band );
+
+    std::mutex lock;
+    std::function< void( Contour&& ) > const serial = [ & ]( Contour&& line )
+    {
+        std::lock_guard< std::mutex > guard( lock );
+        emit( std::move( line ) );
+    };
+
+    //Strip s traces the cell rows between rows s * ContourStrip and the
+    //first row of the next strip
+    int const strips = ( h - 2 ) / detail::ContourStrip + 1;
+    std::vector< std::vector< detail::ContourStitcher::Piece > > seams( strips );
+    parallel_for( 0, strips, [ & ]( int begin, int end )
+        {
+            for( int s = begin; s < end; ++s )
+            {
+                int const r0 = s * detail::ContourStrip;
+                int const r1 = std::min( r0 + detail::ContourStrip, h - 1 );
+                detail::ContourTracer< T > tracer( grid, band.nodatavalue(), levels,
+                    serial, r0, s > 0 );
+                for( int r = r0; r <= r1; ++r )
+                {
+                    tracer.push( band.data() + static_cast< std::size_t >( r ) * w );
+                }
+                tracer.finish( strips > 1 ? &seams[ s ] : nullptr );
+            }
+        } );
+
+    //Seam pieces join head to tail like single segments
+    std::vector< double > const sorted = detail::contour_levels( levels );
+    detail::ContourStitcher stitcher( sorted.size() );
+    for( auto& strip : seams )
+    {
+        for( auto& piece : strip )
+        {
+            bool closed = false;
+            int const id = stitcher.add( std::move( piece ), closed );
+            if( !closed ) continue;
+            auto const ring = stitcher.take( id );
+            emit( detail::contour_line( sorted[ ring.level ], ring.points, true ) );
+        }
+    }
+    for( int id : stitcher.pieces() )
+    {
+        auto const line = stitcher.take( id );
+        emit( detail::contour_line( sorted[ line.level ], line.points, false ) );
+    }
+}
+
+///Contours of band at levels, collected
+template< typename T >
+std::vector< Contour > contours(
+    Band< T > const& band,
+    std::vector< double > const& levels )
+{
+    std::vector< Contour > result;
+    contours( band, levels, [ &result ]( Contour&& line )
+        {
+            result.push_back( std::move( line ) );
+        } );
+    return result;
+}
+
+} //end gis
@@ -0,0 +1,180 @@
+/*******************************************************************************
+ *
+ * MIT License
+ *
+ * Copyright (c) 2018 Joshua Koch
+ * 
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ * 
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ * 
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ *
+ ******************************************************************************/
+
+#pragma once
+
+#include <gis/Band.h>
+#include <gis/Parallel.h>
+
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <limits>
+#include <vector>
+
+namespace gis
+{
+
+///Peak bytes distance_transform allocates for src
+template< typename R = double, typename T >
+std::size_t distance_transform_footprint(
+    Band< T > const& src,
+    bool nearest = false )
+{
+    return src.size() * ( sizeof( double ) + sizeof( R ) +
+        ( nearest ? sizeof( int ) + sizeof( std::int64_t ) : 0 ) );
+}
+
+///Exact Euclidean distance from every pixel to the nearest pixel for which
+///feature( v ) is true, in georeferenced units (Felzenszwalb & Huttenlocher).
+///Pixels with no feature in the band are nodata. When nearest is given it
+///receives the index of the nearest feature pixel.
+template< typename R = double, typename T, typename F >
+Band< R > distance_transform(
+    Band< T > const& src,
+    F feature,
+    Band< std::int64_t >* nearest = nullptr )
+{
+    GISRASTER_TRACE_SCOPE( "distance_transform",
+        src.size(), src.size() * ( sizeof( double ) + sizeof( R ) ) );
+    int const w = src.width(), h = src.height();
+    double const dx = ( src.scalex() != 0.0 ) ? std::abs( src.scalex() ) : 1.0;
+    double const dy = ( src.scaley() != 0.0 ) ? std::abs( src.scaley() ) : 1.0;
+    double constexpr inf = std::numeric_limits< double >::infinity();
+    T const* const s = src.data();
+
+    //Pass 1, along rows: squared distance to the nearest feature in the row
+    std::size_t const n = src.size();
+    MemoryAccountant::current().check(
+        distance_transform_footprint< R >( src, nearest != nullptr ) );
+    Buffer< double > g( n );
+    Buffer< int > gcol( nearest ? n : 0 );
+    parallel_for( 0, h, [ & ]( int rbegin, int rend )
+        {
+            for( int r = rbegin; r < rend; ++r )
+            {
+                std::size_t const row = static_cast< std::size_t >( r ) * w;
+                int last = -1;
+                for( int c = 0; c < w; ++c )
+                {
+                    if( feature( s[ row + c ] ) ) last = c;
+                    g[ row + c ] = ( last < 0 ) ? inf : c - last;
+                    if( nearest ) gcol[ row + c ] = last;
+                }
+                last = -1;
+                for( int c = w - 1; c >= 0; --c )
+                {
+                    if( feature( s[ row + c ] ) ) last = c;
+                    double d = g[ row + c ];
+                    if( last >= 0 && last - c < d )
+                    {
+                        d = last - c;
+                        if( nearest ) gcol[ row + c ] = last;
+                    }
+                    g[ row + c ] = d * d * dx * dx;
+                }
+            }
+        }, 64 );
+
+    Band< R > result;
+    result.copy_props( src, Band< R >::Lowest, 0 );
+    if( nearest ) nearest->copy_props( src, -1, -1 );
+    R* const out = result.data();
+    std::int64_t* const idx = nearest ? nearest->data() : nullptr;
+
+    //Pass 2, along columns: lower envelope of the row parabolas
+    parallel_for( 0, w, [ & ]( int cbegin, int cend )
+        {
+            std::vector< double > f( h ), z( h + 1 );
+            std::vector< int > v( h );
+            double const dy2 = dy * dy;
+            for( int c = cbegin; c < cend; ++c )
+            {
+                int k = -1;
+                for( int q = 0; q < h; ++q )
+                {
+                    f[ q ] = g[ static_cast< std::size_t >( q ) * w + c ];
+                    if( f[ q ] == inf ) continue;
+                    double sq = 0.0;
+                    while( k >= 0 )
+                    {
+                        int const p = v[ k ];
+                        sq = ( ( f[ q ] + dy2 * q * q ) -
+                            ( f[ p ] + dy2 * p * p ) ) / ( 2.0 * dy2 * ( q - p ) );
+                        if( sq > z[ k ] ) break;
+                        --k;
+                    }
+                    ++k;
+                    v[ k ] = q;
+                    z[ k ] = ( k == 0 ) ? -inf : sq;
+                    z[ k + 1 ] = inf;
+                }
+
+                for( int r = 0, j = 0; r < h; ++r )
+                {
+                    std::size_t const i = static_cast< std::size_t >( r ) * w + c;
+                    if( k < 0 )
+                    {
+                        out[ i ] = result.nodatavalue();
+                        continue;
+                    }
+                    while( z[ j + 1 ] < r ) ++j;
+                    int const q = v[ j ];
+                    out[ i ] = static_cast< R >(
+                        std::sqrt( dy2 * ( r - q ) * ( r - q ) + f[ q ] ) );
+                    if( idx )
+                    {
+                        std::size_t const qi =
+                            static_cast< std::size_t >( q ) * w + c;
+                        idx[ i ] = static_cast< std::int64_t >( q ) * w +
+                            gcol[ qi ];
+                    }
+                }
+            }
+        }, 16 );
+    return result;
+}
+
+///Distance to the nearest valid pixel whose value is one of targets, or to
+///the nearest valid non-zero pixel when targets is empty
+template< typename R = double, typename T >
+Band< R > proximity(
+    Band< T > const& src,
+    std::vector< T > const& targets = {},
+    Band< std::int64_t >* nearest = nullptr )
+{
+    T const nodata = src.nodatavalue();
+    return distance_transform< R >( src,
+        [ nodata, &targets ]( T v )
+        {
+            if( v == nodata ) return false;
+            if( targets.empty() ) return ( v != T( 0 ) );
+            return std::find( targets.begin(), targets.end(), v ) !=
+                targets.end();
+        }, nearest );
+}
+
+} //end gis
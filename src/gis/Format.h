@@ -0,0 +1,1353 @@
+/*******************************************************************************
+ *
+ * MIT License
+ *
+ * Copyright (c) 2018 Joshua Koch
+ * 
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ * 
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ * 
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ *
+ ******************************************************************************/
+
+#pragma once
+
+#include <gis/AnyBand.h>
+#include <gis/Band.h>
+#include <gis/Memory.h>
+#include <gis/Parallel.h>
+#include <gis/Raster.h>
+#include <gis/Stats.h>
+
+#include <algorithm>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <fstream>
+#include <memory>
+#include <stdexcept>
+#include <string>
+#include <type_traits>
+#include <utility>
+#include <vector>
+
+#if !defined( _WIN32 )
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+namespace gis
+{
+
+///Native raster files: a header and directory followed by page aligned
+///row-major pixel blocks that load by mapping the file
+namespace format
+{
+
+///
+static constexpr char Magic[ 8 ] = { 'G', 'I', 'S', 'R', 'A', 'S', 'T', '\0' };
+
+///
+static constexpr std::uint32_t Version = 1;
+
+///Written as is; a reader of the other byte order sees it reversed
+static constexpr std::uint32_t ByteOrder = 0x01020304;
+
+///Pixel blocks start on this boundary so they map onto whole pages
+static constexpr std::uint64_t BlockAlignment = 4096;
+
+///
+struct FileHeader
+{
+    char magic[ 8 ];
+    std::uint32_t version;
+    std::uint32_t byteorder;
+    std::uint32_t bands;
+    std::uint32_t levels;
+    std::int32_t width;
+    std::int32_t height;
+    std::int32_t srid;
+    std::uint32_t tilesize;
+    double upperleftx;
+    double upperlefty;
+    double scalex;
+    double scaley;
+
+    ///Checksum of the header and directory, taken with this field 0
+    std::uint64_t checksum;
+};
+
+///
+struct BlockEntry
+{
+    std::uint64_t offset;
+    std::uint64_t bytes;
+    std::uint64_t checksum;
+};
+
+///
+struct BandEntry
+{
+    std::uint32_t type;
+    std::uint32_t reserved;
+    unsigned char nodata[ 8 ];
+};
+
+///One resolution of one band; level 0 is full resolution, each overview
+///halves the previous level
+struct LevelEntry
+{
+    std::int32_t width;
+    std::int32_t height;
+    BlockEntry pixels;
+
+    ///TileRecords, empty when stats were not written
+    BlockEntry stats;
+};
+
+///Summary of one stats tile
+struct TileRecord
+{
+    std::uint64_t count;
+    unsigned char min[ 8 ];
+    unsigned char max[ 8 ];
+    unsigned char sum[ 8 ];
+};
+
+static_assert( sizeof( FileHeader ) == 80 && sizeof( BlockEntry ) == 24 &&
+    sizeof( BandEntry ) == 16 && sizeof( LevelEntry ) == 56 &&
+    sizeof( TileRecord ) == 32, "Unexpected padding in the file layout" );
+
+///
+struct WriteOptions
+{
+    ///Number of overview levels below full resolution
+    int overviews = 0;
+
+    ///Write per tile statistics so loaded bands answer min/max/... at once
+    bool stats = true;
+};
+
+///How loaded pixels may be used
+enum class Access
+{
+    ///Pixel pages are mapped read only; writing to them faults
+    ReadOnly,
+
+    ///Writes go to private copies of the touched pages, never to the file
+    CopyOnWrite
+};
+
+///Description of a file, read from its header
+struct Info
+{
+    int width;
+    int height;
+    int srid;
+    double upperleftx;
+    double upperlefty;
+    double scalex;
+    double scaley;
+    std::vector< PixelType > types;
+
+    ///1 + the number of overviews
+    int levels;
+};
+
+namespace detail
+{
+
+///
+inline std::uint64_t rotl(
+    std::uint64_t x,
+    int r )
+{
+    return ( x << r ) | ( x >> ( 64 - r ) );
+}
+
+///
+inline std::uint64_t mix(
+    std::uint64_t h )
+{
+    h ^= h >> 33;
+    h *= 0xFF51AFD7ED558CCDULL;
+    h ^= h >> 33;
+    h *= 0xC4CEB9FE1A85EC53ULL;
+    h ^= h >> 33;
+    return h;
+}
+
+///Hash of one chunk, four independent 64 bit lanes
+inline std::uint64_t chunk_checksum(
+    unsigned char const* p,
+    std::size_t n )
+{
+    std::uint64_t constexpr P1 = 0x9E3779B185EBCA87ULL;
+    std::uint64_t constexpr P2 = 0xC2B2AE3D27D4EB4FULL;
+    std::uint64_t lanes[ 4 ] = { P1 + P2, P2, 0, 0 - P1 };
+    auto round = [ & ]( unsigned char const* q )
+    {
+        for( int k = 0; k < 4; ++k )
+        {
+            std::uint64_t w;
+            std::memcpy( &w, q + 8 * k, 8 );
+            lanes[ k ] = rotl( lanes[ k ] + w * P2, 31 ) * P1;
+        }
+    };
+    std::size_t i = 0;
+    for( ; i + 32 <= n; i += 32 ) round( p + i );
+    if( i < n )
+    {
+        unsigned char tail[ 32 ] = {};
+        std::memcpy( tail, p + i, n - i );
+        round( tail );
+    }
+    return mix( lanes[ 0 ] ^ rotl( lanes[ 1 ], 7 ) ^ rotl( lanes[ 2 ], 12 ) ^
+        rotl( lanes[ 3 ], 18 ) ^ n );
+}
+
+///Chunk size of checksum
+static constexpr std::size_t ChecksumChunk = std::size_t( 1 ) << 20;
+
+///Folds the hash of the next chunk into h
+inline std::uint64_t combine(
+    std::uint64_t h,
+    std::uint64_t c )
+{
+    return mix( h ^ ( c + 0x9E3779B97F4A7C15ULL + ( h << 6 ) + ( h >> 2 ) ) );
+}
+
+///Checksum of [p, p + n); chunks are hashed in parallel and combined in
+///order, so the result does not depend on the thread count
+inline std::uint64_t checksum(
+    void const* p,
+    std::size_t n )
+{
+    std::size_t constexpr Chunk = ChecksumChunk;
+    unsigned char const* bytes = static_cast< unsigned char const* >( p );
+    int const nchunks = static_cast< int >( ( n + Chunk - 1 ) / Chunk );
+    std::vector< std::uint64_t > hashes( nchunks );
+    parallel_for( 0, nchunks,
+        [ & ]( int begin, int end )
+        {
+            for( int i = begin; i < end; ++i )
+            {
+                std::size_t const b = std::size_t( i ) * Chunk;
+                hashes[ i ] = chunk_checksum( bytes + b, std::min( Chunk, n - b ) );
+            }
+        } );
+    std::uint64_t h = mix( n );
+    for( std::uint64_t c : hashes ) h = combine( h, c );
+    return h;
+}
+
+///The checksum of n bytes fed in pieces of any size; holds at most one
+///chunk
+class StreamChecksum
+{
+public:
+    ///
+    explicit StreamChecksum(
+        std::size_t n )
+        :
+        m_hash( mix( n ) ),
+        m_chunk()
+    {
+        m_chunk.reserve( std::min( n, ChecksumChunk ) );
+    }
+
+    ///
+    void update(
+        void const* p,
+        std::size_t n )
+    {
+        unsigned char const* bytes = static_cast< unsigned char const* >( p );
+        while( n )
+        {
+            std::size_t const take = std::min( n, ChecksumChunk - m_chunk.size() );
+            m_chunk.insert( m_chunk.end(), bytes, bytes + take );
+            bytes += take;
+            n -= take;
+            if( m_chunk.size() == ChecksumChunk ) flush();
+        }
+    }
+
+    ///
+    std::uint64_t value()
+    {
+        if( !m_chunk.empty() ) flush();
+        return m_hash;
+    }
+
+private:
+    ///
+    void flush()
+    {
+        m_hash = combine( m_hash, chunk_checksum( m_chunk.data(), m_chunk.size() ) );
+        m_chunk.clear();
+    }
+
+    ///
+    std::uint64_t m_hash;
+
+    ///
+    std::vector< unsigned char > m_chunk;
+};
+
+///
+inline std::uint64_t align(
+    std::uint64_t offset )
+{
+    return ( offset + BlockAlignment - 1 ) / BlockAlignment * BlockAlignment;
+}
+
+///Half resolution copy of src; each pixel averages the valid pixels of a
+///2x2 block
+template< typename T >
+Band< T > overview(
+    Band< T > const& src )
+{
+    int const w = std::max( 1, ( src.width() + 1 ) / 2 );
+    int const h = std::max( 1, ( src.height() + 1 ) / 2 );
+    T const nodata = src.nodatavalue();
+    Band< T > result( w, h, nodata, no_init );
+    result.upperleftx( src.upperleftx() );
+    result.upperlefty( src.upperlefty() );
+    result.srid( src.srid() );
+    result.scale( src.scalex() * src.width() / w,
+        src.scaley() * src.height() / h );
+    T const* in = src.data();
+    T* out = result.data();
+    parallel_for( 0, h,
+        [ & ]( int begin, int end )
+        {
+            for( int r = begin; r < end; ++r )
+            {
+                for( int c = 0; c < w; ++c )
+                {
+                    double sum = 0.0;
+                    int count = 0;
+                    for( int rr = 2 * r; rr < std::min( 2 * r + 2, src.height() ); ++rr )
+                    {
+                        for( int cc = 2 * c; cc < std::min( 2 * c + 2, src.width() ); ++cc )
+                        {
+                            T const v = in[ std::size_t( rr ) * src.width() + cc ];
+                            if( v == nodata ) continue;
+                            sum += static_cast< double >( v );
+                            ++count;
+                        }
+                    }
+                    out[ std::size_t( r ) * w + c ] = count ?
+                        Band< T >::cast( sum / count, true ) : nodata;
+                }
+            }
+        } );
+    return result;
+}
+
+///Appends bands to a file opened by write
+class Writer
+{
+public:
+    ///
+    Writer(
+        std::string const& path,
+        std::uint32_t bands,
+        WriteOptions options )
+        :
+        m_path( path ),
+        m_out( path, std::ios::binary | std::ios::trunc ),
+        m_options( options ),
+        m_header(),
+        m_bands(),
+        m_levels(),
+        m_offset( 0 ),
+        m_block(),
+        m_stream()
+    {
+        if( m_options.overviews < 0 ) throw std::invalid_argument(
+            "format::write: negative overview count" );
+        fail_unless( m_out.good() );
+        std::memcpy( m_header.magic, Magic, sizeof( Magic ) );
+        m_header.version = Version;
+        m_header.byteorder = ByteOrder;
+        m_header.bands = bands;
+        m_header.levels = static_cast< std::uint32_t >( m_options.overviews + 1 );
+        m_header.tilesize = gis::detail::StatsCache< std::uint8_t >::TileSize;
+        m_offset = directory_bytes();
+        std::vector< char > zeros( m_offset, 0 );
+        m_out.write( zeros.data(), zeros.size() );
+        fail_unless( m_out.good() );
+    }
+
+    ///
+    template< typename T >
+    void add(
+        Band< T > const& band )
+    {
+        if( m_bands.empty() )
+        {
+            m_header.width = band.width();
+            m_header.height = band.height();
+            m_header.srid = band.srid();
+            m_header.upperleftx = band.upperleftx();
+            m_header.upperlefty = band.upperlefty();
+            m_header.scalex = band.scalex();
+            m_header.scaley = band.scaley();
+        }
+        else if( band.width() != m_header.width || band.height() != m_header.height )
+        {
+            throw std::invalid_argument( "format::write: " + m_path +
+                ": band size differs from the first band" );
+        }
+        add_band( band.nodatavalue() );
+
+        add_level( band );
+        Band< T > level;
+        Band< T > const* previous = &band;
+        for( int i = 0; i < m_options.overviews; ++i )
+        {
+            level = overview( *previous );
+            add_level( level );
+            previous = &level;
+        }
+    }
+
+    ///Sets the georeferencing of a file whose pixels are streamed
+    void grid(
+        Info const& info )
+    {
+        m_header.width = info.width;
+        m_header.height = info.height;
+        m_header.srid = info.srid;
+        m_header.upperleftx = info.upperleftx;
+        m_header.upperlefty = info.upperlefty;
+        m_header.scalex = info.scalex;
+        m_header.scaley = info.scaley;
+    }
+
+    ///
+    template< typename T >
+    void add_band(
+        T nodata )
+    {
+        BandEntry entry{};
+        entry.type = static_cast< std::uint32_t >( pixel_type< T >() );
+        std::memcpy( entry.nodata, &nodata, sizeof( T ) );
+        m_bands.push_back( entry );
+    }
+
+    ///
+    void add_level(
+        LevelEntry const& entry )
+    {
+        m_levels.push_back( entry );
+    }
+
+    ///Starts a block of the given size whose bytes follow through append
+    void begin_block(
+        std::size_t bytes )
+    {
+        std::uint64_t const offset =
+            align( m_offset + gis::detail::MemoryAlignment );
+        std::vector< char > pad( offset - m_offset, 0 );
+        m_out.write( pad.data(), pad.size() );
+        fail_unless( m_out.good() );
+        m_block = BlockEntry{ offset, bytes, 0 };
+        m_offset = offset;
+        m_stream.reset( new StreamChecksum( bytes ) );
+    }
+
+    ///
+    void append(
+        void const* p,
+        std::size_t bytes )
+    {
+        m_out.write( static_cast< char const* >( p ), bytes );
+        fail_unless( m_out.good() );
+        m_stream->update( p, bytes );
+        m_offset += bytes;
+    }
+
+    ///
+    BlockEntry end_block()
+    {
+        if( m_offset != m_block.offset + m_block.bytes )
+        {
+            throw std::logic_error( "format::write: block size mismatch" );
+        }
+        m_block.checksum = m_stream->value();
+        m_stream.reset();
+        return m_block;
+    }
+
+    ///Writes the header and directory
+    void finish()
+    {
+        std::vector< char > dir = directory();
+        std::uint64_t const sum = checksum( dir.data(), dir.size() );
+        std::memcpy( dir.data() + offsetof( FileHeader, checksum ), &sum,
+            sizeof( sum ) );
+        m_out.seekp( 0 );
+        m_out.write( dir.data(), dir.size() );
+        m_out.close();
+        fail_unless( !m_out.fail() );
+    }
+
+private:
+    ///
+    std::uint64_t directory_bytes() const
+    {
+        return sizeof( FileHeader ) + m_header.bands * ( sizeof( BandEntry ) +
+            m_header.levels * sizeof( LevelEntry ) );
+    }
+
+    ///
+    std::vector< char > directory() const
+    {
+        std::vector< char > dir;
+        auto put = [ &dir ]( void const* p, std::size_t n )
+        {
+            char const* c = static_cast< char const* >( p );
+            dir.insert( dir.end(), c, c + n );
+        };
+        FileHeader header = m_header;
+        header.checksum = 0;
+        put( &header, sizeof( header ) );
+        put( m_bands.data(), m_bands.size() * sizeof( BandEntry ) );
+        put( m_levels.data(), m_levels.size() * sizeof( LevelEntry ) );
+        return dir;
+    }
+
+    ///
+    template< typename T >
+    void add_level(
+        Band< T > const& band )
+    {
+        LevelEntry entry{};
+        entry.width = band.width();
+        entry.height = band.height();
+        entry.pixels = block( band.data(), band.size() * sizeof( T ) );
+        if( m_options.stats )
+        {
+            std::vector< Summary< T > > const tiles = band.tile_summaries();
+            std::vector< TileRecord > records( tiles.size() );
+            for( std::size_t i = 0; i < tiles.size(); ++i )
+            {
+                records[ i ].count = tiles[ i ].count;
+                std::memcpy( records[ i ].min, &tiles[ i ].min, sizeof( T ) );
+                std::memcpy( records[ i ].max, &tiles[ i ].max, sizeof( T ) );
+                std::memcpy( records[ i ].sum, &tiles[ i ].sum,
+                    sizeof( tiles[ i ].sum ) );
+            }
+            entry.stats = block( records.data(),
+                records.size() * sizeof( TileRecord ) );
+        }
+        m_levels.push_back( entry );
+    }
+
+    ///Writes an aligned block, leaving at least the allocator's header slot
+    ///in front of it
+    BlockEntry block(
+        void const* p,
+        std::size_t bytes )
+    {
+        std::uint64_t const offset =
+            align( m_offset + gis::detail::MemoryAlignment );
+        std::vector< char > pad( offset - m_offset, 0 );
+        m_out.write( pad.data(), pad.size() );
+        m_out.write( static_cast< char const* >( p ), bytes );
+        fail_unless( m_out.good() );
+        m_offset = offset + bytes;
+        return BlockEntry{ offset, bytes, checksum( p, bytes ) };
+    }
+
+    ///
+    void fail_unless(
+        bool ok ) const
+    {
+        if( !ok ) throw std::runtime_error(
+            "format::write: cannot write " + m_path );
+    }
+
+    ///
+    std::string m_path;
+
+    ///
+    std::ofstream m_out;
+
+    ///
+    WriteOptions m_options;
+
+    ///
+    FileHeader m_header;
+
+    ///
+    std::vector< BandEntry > m_bands;
+
+    ///Band major
+    std::vector< LevelEntry > m_levels;
+
+    ///
+    std::uint64_t m_offset;
+
+    ///Block being streamed
+    BlockEntry m_block;
+
+    ///
+    std::unique_ptr< StreamChecksum > m_stream;
+};
+
+///Owns a file descriptor, so it is closed when a constructor throws
+class Descriptor
+{
+public:
+    ///
+    explicit Descriptor(
+        int fd = -1 )
+        :
+        m_fd( fd )
+    {
+        ;
+    }
+
+    ///
+    Descriptor( Descriptor const& ) = delete;
+
+    ///
+    Descriptor& operator =( Descriptor const& ) = delete;
+
+    ///
+    ~Descriptor()
+    {
+#if !defined( _WIN32 )
+        if( m_fd >= 0 ) ::close( m_fd );
+#endif
+    }
+
+    ///
+    int get() const
+    {
+        return m_fd;
+    }
+
+    ///Takes ownership of fd, closing the descriptor held before
+    void reset(
+        int fd )
+    {
+        Descriptor old( m_fd );
+        m_fd = fd;
+    }
+
+private:
+    ///
+    int m_fd;
+};
+
+///An open file with a validated header and directory
+class File
+{
+public:
+    ///
+    explicit File(
+        std::string const& path )
+        :
+        m_path( path ),
+        m_fd(),
+        m_size( 0 ),
+        m_header(),
+        m_bands(),
+        m_levels()
+    {
+#if defined( _WIN32 )
+        fail( "mapped files are not supported on this platform" );
+#else
+        m_fd.reset( ::open( path.c_str(), O_RDONLY ) );
+        if( m_fd.get() < 0 ) fail( "cannot open" );
+        struct stat st;
+        if( fstat( m_fd.get(), &st ) != 0 ) fail( "cannot stat" );
+        m_size = static_cast< std::uint64_t >( st.st_size );
+
+        read( 0, &m_header, sizeof( m_header ) );
+        if( std::memcmp( m_header.magic, Magic, sizeof( Magic ) ) != 0 )
+        {
+            fail( "not a native raster file" );
+        }
+        if( m_header.byteorder != ByteOrder ) fail( "wrong byte order" );
+        if( m_header.version != Version ) fail( "unsupported version" );
+        if( m_header.levels == 0 || m_header.width < 0 || m_header.height < 0 )
+        {
+            fail( "corrupt header" );
+        }
+
+        //The header counts are unchecked until the directory checksum is, so
+        //the directory they describe must fit the file before it is allocated
+        std::uint64_t const perband = sizeof( BandEntry ) +
+            std::uint64_t( m_header.levels ) * sizeof( LevelEntry );
+        if( m_header.bands != 0 &&
+            perband > ( m_size - sizeof( FileHeader ) ) / m_header.bands )
+        {
+            fail( "truncated file" );
+        }
+
+        m_bands.resize( m_header.bands );
+        m_levels.resize( std::size_t( m_header.bands ) * m_header.levels );
+        std::uint64_t offset = sizeof( FileHeader );
+        read( offset, m_bands.data(), m_bands.size() * sizeof( BandEntry ) );
+        offset += m_bands.size() * sizeof( BandEntry );
+        read( offset, m_levels.data(), m_levels.size() * sizeof( LevelEntry ) );
+
+        FileHeader header = m_header;
+        header.checksum = 0;
+        std::vector< char > dir;
+        auto put = [ &dir ]( void const* p, std::size_t n )
+        {
+            char const* c = static_cast< char const* >( p );
+            dir.insert( dir.end(), c, c + n );
+        };
+        put( &header, sizeof( header ) );
+        put( m_bands.data(), m_bands.size() * sizeof( BandEntry ) );
+        put( m_levels.data(), m_levels.size() * sizeof( LevelEntry ) );
+        if( checksum( dir.data(), dir.size() ) != m_header.checksum )
+        {
+            fail( "header checksum mismatch" );
+        }
+
+        for( auto const& l : m_levels )
+        {
+            for( BlockEntry const* e : { &l.pixels, &l.stats } )
+            {
+                if( e->bytes && ( e->offset > m_size || e->bytes > m_size - e->offset ||
+                    e->offset < gis::detail::MemoryAlignment ) )
+                {
+                    fail( "block outside the file" );
+                }
+            }
+        }
+#endif
+    }
+
+    ///
+    File( File const& ) = delete;
+
+    ///
+    File& operator =( File const& ) = delete;
+
+    ///
+    Info info() const
+    {
+        Info result;
+        result.width = m_header.width;
+        result.height = m_header.height;
+        result.srid = m_header.srid;
+        result.upperleftx = m_header.upperleftx;
+        result.upperlefty = m_header.upperlefty;
+        result.scalex = m_header.scalex;
+        result.scaley = m_header.scaley;
+        for( auto const& b : m_bands )
+        {
+            result.types.push_back( static_cast< PixelType >( b.type ) );
+        }
+        result.levels = static_cast< int >( m_header.levels );
+        return result;
+    }
+
+    ///
+    PixelType type(
+        std::size_t band ) const
+    {
+        if( band >= m_bands.size() ) fail( "no such band" );
+        return static_cast< PixelType >( m_bands[ band ].type );
+    }
+
+    ///Maps a band; the pixels are checksummed first when verify is set
+    template< typename T >
+    Band< T > band(
+        std::size_t index,
+        int level,
+        Access access,
+        bool verify ) const
+    {
+        if( type( index ) != pixel_type< T >() ) fail( "pixel type mismatch" );
+        if( level < 0 || level >= static_cast< int >( m_header.levels ) )
+        {
+            fail( "no such level" );
+        }
+        LevelEntry const& entry = m_levels[ index * m_header.levels + level ];
+        std::size_t const n =
+            static_cast< std::size_t >( entry.width ) * entry.height;
+        if( entry.width < 0 || entry.height < 0 ||
+            entry.pixels.bytes != n * sizeof( T ) )
+        {
+            fail( "corrupt directory" );
+        }
+        T nodata;
+        std::memcpy( &nodata, m_bands[ index ].nodata, sizeof( T ) );
+
+        typename Band< T >::Data data;
+        if( n != 0 ) data = map< T >( entry.pixels, n, access, verify );
+        Band< T > result( std::move( data ), entry.width, entry.height, nodata );
+        result.upperleftx( m_header.upperleftx );
+        result.upperlefty( m_header.upperlefty );
+        result.srid( m_header.srid );
+        if( level == 0 ) result.scale( m_header.scalex, m_header.scaley );
+        else result.scale( m_header.scalex * m_header.width / entry.width,
+            m_header.scaley * m_header.height / entry.height );
+
+        if( entry.stats.bytes ) result.tile_summaries( stats< T >( entry.stats ) );
+        return result;
+    }
+
+    ///
+    template< typename T >
+    T nodata(
+        std::size_t index ) const
+    {
+        if( type( index ) != pixel_type< T >() ) fail( "pixel type mismatch" );
+        T result;
+        std::memcpy( &result, m_bands[ index ].nodata, sizeof( T ) );
+        return result;
+    }
+
+    ///Reads full resolution rows [row, row + rows) of band index with plain
+    ///reads; the block checksum is not verified
+    template< typename T >
+    void read_rows(
+        std::size_t index,
+        int row,
+        int rows,
+        T* out ) const
+    {
+        if( type( index ) != pixel_type< T >() ) fail( "pixel type mismatch" );
+        LevelEntry const& entry = m_levels[ index * m_header.levels ];
+        std::size_t const width = static_cast< std::size_t >( entry.width );
+        if( row < 0 || rows < 0 || row + rows > entry.height ||
+            entry.pixels.bytes != width * entry.height * sizeof( T ) )
+        {
+            fail( "rows outside the band" );
+        }
+        read( entry.pixels.offset + width * row * sizeof( T ), out,
+            width * rows * sizeof( T ) );
+    }
+
+private:
+    ///
+    [[noreturn]] void fail(
+        char const* what ) const
+    {
+        throw std::runtime_error( "format::load: " + m_path + ": " + what );
+    }
+
+    ///
+    void read(
+        std::uint64_t offset,
+        void* p,
+        std::size_t bytes ) const
+    {
+#if !defined( _WIN32 )
+        char* c = static_cast< char* >( p );
+        while( bytes )
+        {
+            ssize_t const got = ::pread( m_fd.get(), c, bytes,
+                static_cast< off_t >( offset ) );
+            if( got <= 0 ) fail( "truncated file" );
+            c += got;
+            offset += got;
+            bytes -= got;
+        }
+#endif
+    }
+
+    ///Pixel storage adopting a private mapping of block
+    template< typename T >
+    typename Band< T >::Data map(
+        BlockEntry const& block,
+        std::size_t n,
+        Access access,
+        bool verify ) const
+    {
+#if defined( _WIN32 )
+        fail( "mapped files are not supported on this platform" );
+#else
+        std::uint64_t const page = static_cast< std::uint64_t >( sysconf( _SC_PAGESIZE ) );
+        std::uint64_t const start =
+            ( block.offset - gis::detail::MemoryAlignment ) / page * page;
+        std::size_t const length =
+            static_cast< std::size_t >( block.offset + block.bytes - start );
+        void* const base = ::mmap( nullptr, length, PROT_READ | PROT_WRITE,
+            MAP_PRIVATE, m_fd.get(), static_cast< off_t >( start ) );
+        if( base == MAP_FAILED ) fail( "cannot map" );
+        char* const pixels = static_cast< char* >( base ) + ( block.offset - start );
+
+        gis::detail::AdoptionScope scope(
+            gis::detail::Adoption{ pixels, block.bytes, static_cast< char* >( base ), length } );
+        if( verify && checksum( pixels, block.bytes ) != block.checksum )
+        {
+            fail( "pixel checksum mismatch" );
+        }
+        typename Band< T >::Data data( n );
+        if( !scope.adopted() ) fail( "cannot adopt mapping" );
+
+        if( access == Access::ReadOnly )
+        {
+            //Whole pages only: the page holding the allocator header stays
+            //writable
+            std::uintptr_t const first = ( reinterpret_cast< std::uintptr_t >(
+                pixels ) + page - 1 ) / page * page;
+            std::uintptr_t const last = reinterpret_cast< std::uintptr_t >(
+                pixels ) + block.bytes;
+            if( last > first )
+            {
+                ::mprotect( reinterpret_cast< void* >( first ), last - first, PROT_READ );
+            }
+        }
+        return data;
+#endif
+    }
+
+    ///
+    template< typename T >
+    std::vector< Summary< T > > stats(
+        BlockEntry const& block ) const
+    {
+        std::vector< TileRecord > records( block.bytes / sizeof( TileRecord ) );
+        read( block.offset, records.data(), records.size() * sizeof( TileRecord ) );
+        if( checksum( records.data(), block.bytes ) != block.checksum )
+        {
+            fail( "stats checksum mismatch" );
+        }
+        std::vector< Summary< T > > result( records.size() );
+        for( std::size_t i = 0; i < records.size(); ++i )
+        {
+            result[ i ].count = records[ i ].count;
+            std::memcpy( &result[ i ].min, records[ i ].min, sizeof( T ) );
+            std::memcpy( &result[ i ].max, records[ i ].max, sizeof( T ) );
+            std::memcpy( &result[ i ].sum, records[ i ].sum,
+                sizeof( result[ i ].sum ) );
+        }
+        return result;
+    }
+
+    ///
+    std::string m_path;
+
+    ///
+    Descriptor m_fd;
+
+    ///
+    std::uint64_t m_size;
+
+    ///
+    FileHeader m_header;
+
+    ///
+    std::vector< BandEntry > m_bands;
+
+    ///Band major
+    std::vector< LevelEntry > m_levels;
+};
+
+///
+template< typename... Ts, std::size_t... Ns >
+Raster< Ts... > load_raster(
+    File const& file,
+    int level,
+    Access access,
+    bool verify,
+    std::index_sequence< Ns... > )
+{
+    return Raster< Ts... >( std::make_tuple(
+        file.band< Ts >( Ns, level, access, verify )... ) );
+}
+
+///
+template< typename... Ts, std::size_t... Ns >
+void add_bands(
+    Writer& writer,
+    Raster< Ts... > const& raster,
+    std::index_sequence< Ns... > )
+{
+    int const expand[] = { 0, ( writer.add( raster.template band< Ns >() ), 0 )... };
+    ( void )expand;
+}
+
+} //end detail
+
+///Writes band to path
+template< typename T >
+void write(
+    std::string const& path,
+    Band< T > const& band,
+    WriteOptions options = WriteOptions() )
+{
+    GISRASTER_TRACE_SCOPE( "format::write", band.size(), band.bytes() );
+    detail::Writer writer( path, 1, options );
+    writer.add( band );
+    writer.finish();
+}
+
+///Writes every band of raster to path
+template< typename... Ts >
+void write(
+    std::string const& path,
+    Raster< Ts... > const& raster,
+    WriteOptions options = WriteOptions() )
+{
+    detail::Writer writer( path, sizeof...( Ts ), options );
+    detail::add_bands( writer, raster, std::index_sequence_for< Ts... >{} );
+    writer.finish();
+}
+
+///Reads one band of a file a few rows at a time, without mapping it
+template< typename T >
+class RowReader
+{
+public:
+    ///
+    explicit RowReader(
+        std::string const& path,
+        std::size_t index = 0 )
+        :
+        m_file( path ),
+        m_index( index ),
+        m_nodata( m_file.nodata< T >( index ) )
+    {
+        ;
+    }
+
+    ///
+    Info info() const
+    {
+        return m_file.info();
+    }
+
+    ///
+    T nodatavalue() const
+    {
+        return m_nodata;
+    }
+
+    ///Reads rows [row, row + rows) into out, width * rows pixels
+    void read(
+        int row,
+        int rows,
+        T* out ) const
+    {
+        m_file.read_rows( m_index, row, rows, out );
+    }
+
+private:
+    ///
+    detail::File m_file;
+
+    ///
+    std::size_t m_index;
+
+    ///
+    T m_nodata;
+};
+
+///Writes a single band file from rows supplied top to bottom; holds one
+///checksum chunk and one row of tile statistics at a time. Streamed files
+///have no overviews.
+template< typename T >
+class RowWriter
+{
+public:
+    ///The georeferencing comes from grid; its types and levels are ignored
+    RowWriter(
+        std::string const& path,
+        Info const& grid,
+        T nodata,
+        bool stats = true )
+        :
+        m_writer( path, 1, WriteOptions() ),
+        m_grid( grid ),
+        m_nodata( nodata ),
+        m_stats( stats ),
+        m_row( 0 ),
+        m_tiles(),
+        m_records()
+    {
+        if( grid.width < 0 || grid.height < 0 ) throw std::invalid_argument(
+            "format::RowWriter: negative size" );
+        m_writer.grid( grid );
+        m_writer.add_band( nodata );
+        m_writer.begin_block( static_cast< std::size_t >( grid.width ) *
+            grid.height * sizeof( T ) );
+        m_tiles.resize( across() );
+    }
+
+    ///Appends rows rows of width pixels each
+    void write(
+        T const* rows,
+        int n )
+    {
+        if( n < 0 || m_row + n > m_grid.height ) throw std::out_of_range(
+            "format::RowWriter::write: more rows than the band has" );
+        std::size_t const width = static_cast< std::size_t >( m_grid.width );
+        m_writer.append( rows, width * n * sizeof( T ) );
+        if( !m_stats )
+        {
+            m_row += n;
+            return;
+        }
+        for( int i = 0; i < n; ++i, ++m_row )
+        {
+            T const* row = rows + width * i;
+            for( std::size_t t = 0; t < m_tiles.size(); ++t )
+            {
+                std::size_t const c0 = t * TileSize;
+                gis::detail::Reduce< T >::summarize( row + c0,
+                    std::min< std::size_t >( TileSize, width - c0 ), m_nodata,
+                    m_tiles[ t ] );
+            }
+            if( ( m_row + 1 ) % TileSize == 0 || m_row + 1 == m_grid.height )
+            {
+                flush_tiles();
+            }
+        }
+    }
+
+    ///Writes the statistics and the directory once every row arrived
+    void finish()
+    {
+        if( m_row != m_grid.height ) throw std::logic_error(
+            "format::RowWriter::finish: missing rows" );
+        LevelEntry entry{};
+        entry.width = m_grid.width;
+        entry.height = m_grid.height;
+        entry.pixels = m_writer.end_block();
+        if( m_stats )
+        {
+            std::size_t const bytes = m_records.size() * sizeof( TileRecord );
+            m_writer.begin_block( bytes );
+            m_writer.append( m_records.data(), bytes );
+            entry.stats = m_writer.end_block();
+        }
+        m_writer.add_level( entry );
+        m_writer.finish();
+    }
+
+private:
+    ///
+    static constexpr int TileSize = gis::detail::StatsCache< T >::TileSize;
+
+    ///
+    std::size_t across() const
+    {
+        return ( static_cast< std::size_t >( m_grid.width ) + TileSize - 1 ) / TileSize;
+    }
+
+    ///
+    void flush_tiles()
+    {
+        for( auto& tile : m_tiles )
+        {
+            TileRecord record{};
+            record.count = tile.count;
+            std::memcpy( record.min, &tile.min, sizeof( T ) );
+            std::memcpy( record.max, &tile.max, sizeof( T ) );
+            std::memcpy( record.sum, &tile.sum, sizeof( tile.sum ) );
+            m_records.push_back( record );
+            tile = Summary< T >();
+        }
+    }
+
+    ///
+    detail::Writer m_writer;
+
+    ///
+    Info m_grid;
+
+    ///
+    T m_nodata;
+
+    ///
+    bool m_stats;
+
+    ///Rows written so far
+    int m_row;
+
+    ///Tile row being summarized
+    std::vector< Summary< T > > m_tiles;
+
+    ///One record per finished tile, a few bytes per 64K pixels
+    std::vector< TileRecord > m_records;
+};
+
+///Header of the file at path
+inline Info inspect(
+    std::string const& path )
+{
+    return detail::File( path ).info();
+}
+
+///A band, raster or AnyBand whose pixels are mapped read only. Only const
+///access is given, so a write fails to compile instead of faulting.
+template< typename B >
+class Mapped
+{
+public:
+    ///
+    explicit Mapped(
+        B&& value )
+        :
+        m_value( std::move( value ) )
+    {
+        ;
+    }
+
+    ///
+    B const& get() const
+    {
+        return m_value;
+    }
+
+    ///
+    B const& operator *() const
+    {
+        return m_value;
+    }
+
+    ///
+    B const* operator ->() const
+    {
+        return &m_value;
+    }
+
+private:
+    ///
+    B m_value;
+};
+
+///Maps band index of the file at path read only, without copying; level > 0
+///picks an overview. Loading costs only the header; verify checksums every
+///pixel once, reading the whole band.
+template< typename T >
+Mapped< Band< T > > load(
+    std::string const& path,
+    std::size_t index = 0,
+    int level = 0,
+    bool verify = false )
+{
+    GISRASTER_TRACE_SCOPE( "format::load", 0, 0 );
+    return Mapped< Band< T > >( detail::File( path ).band< T >(
+        index, level, Access::ReadOnly, verify ) );
+}
+
+///As load, but writes go to private copies of the pages they touch
+template< typename T >
+Band< T > load_writable(
+    std::string const& path,
+    std::size_t index = 0,
+    int level = 0,
+    bool verify = false )
+{
+    GISRASTER_TRACE_SCOPE( "format::load", 0, 0 );
+    return detail::File( path ).band< T >( index, level, Access::CopyOnWrite, verify );
+}
+
+namespace detail
+{
+
+///
+template< typename... Ts >
+Raster< Ts... > load_raster(
+    std::string const& path,
+    int level,
+    Access access,
+    bool verify )
+{
+    File const file( path );
+    if( file.info().types.size() != sizeof...( Ts ) )
+    {
+        throw std::runtime_error( "format::load_raster: " + path +
+            ": wrong number of bands" );
+    }
+    return load_raster< Ts... >( file, level, access, verify,
+        std::index_sequence_for< Ts... >{} );
+}
+
+///
+inline AnyBand load_any(
+    std::string const& path,
+    std::size_t index,
+    int level,
+    Access access,
+    bool verify )
+{
+    File const file( path );
+    return gis::detail::with_pixel_type( file.type( index ),
+        [ & ]( auto tag )
+        {
+            using T = typename decltype( tag )::type;
+            return AnyBand( file.band< T >( index, level, access, verify ) );
+        } );
+}
+
+} //end detail
+
+///Maps every band of the file at path read only; the pixel types must
+///match Ts...
+template< typename... Ts >
+Mapped< Raster< Ts... > > load_raster(
+    std::string const& path,
+    int level = 0,
+    bool verify = false )
+{
+    return Mapped< Raster< Ts... > >( detail::load_raster< Ts... >(
+        path, level, Access::ReadOnly, verify ) );
+}
+
+///As load_raster, with copy-on-write pages
+template< typename... Ts >
+Raster< Ts... > load_raster_writable(
+    std::string const& path,
+    int level = 0,
+    bool verify = false )
+{
+    return detail::load_raster< Ts... >( path, level, Access::CopyOnWrite, verify );
+}
+
+///Maps band index of the file at path read only, with the pixel type it was
+///written with
+inline Mapped< AnyBand > load_any(
+    std::string const& path,
+    std::size_t index = 0,
+    int level = 0,
+    bool verify = false )
+{
+    return Mapped< AnyBand >( detail::load_any(
+        path, index, level, Access::ReadOnly, verify ) );
+}
+
+///As load_any, with copy-on-write pages
+inline AnyBand load_any_writable(
+    std::string const& path,
+    std::size_t index = 0,
+    int level = 0,
+    bool verify = false )
+{
+    return detail::load_any( path, index, level, Access::CopyOnWrite, verify );
+}
+
+} //end format
+
+} //end gis
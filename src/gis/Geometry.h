@@ -0,0 +1,64 @@
+/*******************************************************************************
+ *
+ * MIT License
+ *
+ * Copyright (c) 2018 Joshua Koch
+ * 
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ * 
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ * 
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ *
+ ******************************************************************************/
+
+#pragma once
+
+#include <vector>
+
+namespace gis
+{
+
+///Georeferenced coordinate
+struct Point
+{
+    ///
+    double x;
+
+    ///
+    double y;
+};
+
+///
+using LineString = std::vector< Point >;
+
+///Closed ring; the closing vertex may be omitted. A distinct type from
+///LineString so that rings are filled and lines are traced.
+struct Ring : std::vector< Point >
+{
+    using std::vector< Point >::vector;
+};
+
+///Exterior ring followed by any interior rings (holes). A distinct type
+///from a collection of LineStrings.
+struct Polygon : std::vector< Ring >
+{
+    using std::vector< Ring >::vector;
+};
+
+///
+using MultiPolygon = std::vector< Polygon >;
+
+} //end gis
@@ -0,0 +1,427 @@
+/*******************************************************************************
+ *
+ * MIT License
+ *
+ * Copyright (c) 2018 Joshua Koch
+ * 
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ * 
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ * 
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ *
+ ******************************************************************************/
+
+#pragma once
+
+#include <gis/Band.h>
+
+#include <algorithm>
+#include <cstdint>
+#include <cstring>
+#include <limits>
+#include <type_traits>
+
+#if defined( __F16C__ )
+#define GISRASTER_HAS_F16C 1
+#include <immintrin.h>
+#endif
+
+namespace gis
+{
+
+namespace detail
+{
+
+///IEEE binary32 to binary16, rounding to nearest even
+inline std::uint16_t float_to_half_bits(
+    float f )
+{
+#if defined( GISRASTER_HAS_F16C )
+    return static_cast< std::uint16_t >(
+        _cvtss_sh( f, _MM_FROUND_TO_NEAREST_INT ) );
+#else
+    std::uint32_t x;
+    std::memcpy( &x, &f, sizeof( x ) );
+    std::uint32_t const sign = ( x >> 16 ) & 0x8000u;
+    std::uint32_t const absx = x & 0x7FFFFFFFu;
+    if( absx >= 0x7F800000u )
+    {
+        //Inf stays inf, NaN stays a quiet NaN
+        return static_cast< std::uint16_t >( sign | 0x7C00u |
+            ( ( absx > 0x7F800000u ) ? ( 0x200u | ( ( absx >> 13 ) & 0x3FFu ) ) : 0u ) );
+    }
+    if( absx >= 0x477FF000u )
+    {
+        return static_cast< std::uint16_t >( sign | 0x7C00u );
+    }
+    std::uint32_t r, rem, halfway;
+    if( absx < 0x38800000u )
+    {
+        //Subnormal (or zero) result
+        if( absx <= 0x33000000u ) return static_cast< std::uint16_t >( sign );
+        std::uint32_t const e = absx >> 23;
+        std::uint32_t const m = ( absx & 0x7FFFFFu ) | 0x800000u;
+        std::uint32_t const shift = 126u - e;
+        r = m >> shift;
+        rem = m & ( ( 1u << shift ) - 1u );
+        halfway = 1u << ( shift - 1u );
+    }
+    else
+    {
+        r = ( absx >> 13 ) - ( 112u << 10 );
+        rem = absx & 0x1FFFu;
+        halfway = 0x1000u;
+    }
+    if( rem > halfway || ( rem == halfway && ( r & 1u ) ) ) ++r;
+    return static_cast< std::uint16_t >( sign | r );
+#endif
+}
+
+///IEEE binary16 to binary32 (exact)
+inline float half_bits_to_float(
+    std::uint16_t h )
+{
+#if defined( GISRASTER_HAS_F16C )
+    return _cvtsh_ss( h );
+#else
+    std::uint32_t const sign = static_cast< std::uint32_t >( h & 0x8000u ) << 16;
+    std::int32_t e = ( h >> 10 ) & 0x1F;
+    std::uint32_t m = h & 0x3FFu;
+    std::uint32_t x;
+    if( e == 0 )
+    {
+        if( m == 0 )
+        {
+            x = sign;
+        }
+        else
+        {
+            e = 1;
+            while( !( m & 0x400u ) )
+            {
+                m <<= 1;
+                --e;
+            }
+            x = sign | ( static_cast< std::uint32_t >( e + 112 ) << 23 ) |
+                ( ( m & 0x3FFu ) << 13 );
+        }
+    }
+    else if( e == 31 )
+    {
+        x = sign | 0x7F800000u | ( m << 13 );
+    }
+    else
+    {
+        x = sign | ( static_cast< std::uint32_t >( e + 112 ) << 23 ) | ( m << 13 );
+    }
+    float f;
+    std::memcpy( &f, &x, sizeof( f ) );
+    return f;
+#endif
+}
+
+} //end detail
+
+///IEEE 754 binary16 pixel type. Arithmetic is done in float.
+class half
+{
+public:
+    ///
+    half() = default;
+
+    ///
+    template< typename U, typename =
+        typename std::enable_if< std::is_arithmetic< U >::value >::type >
+    explicit half(
+        U val )
+        :
+        m_bits( detail::float_to_half_bits( static_cast< float >( val ) ) )
+    {
+        ;
+    }
+
+    ///
+    static constexpr half from_bits(
+        std::uint16_t bits )
+    {
+        return half( bits, 0 );
+    }
+
+    ///
+    constexpr std::uint16_t bits() const
+    {
+        return m_bits;
+    }
+
+    ///
+    operator float() const
+    {
+        return detail::half_bits_to_float( m_bits );
+    }
+
+    ///
+    half& operator +=(
+        half rhs )
+    {
+        return *this = half( float( *this ) + float( rhs ) );
+    }
+
+    ///
+    half& operator -=(
+        half rhs )
+    {
+        return *this = half( float( *this ) - float( rhs ) );
+    }
+
+    ///
+    half& operator *=(
+        half rhs )
+    {
+        return *this = half( float( *this ) * float( rhs ) );
+    }
+
+    ///
+    half& operator /=(
+        half rhs )
+    {
+        return *this = half( float( *this ) / float( rhs ) );
+    }
+
+private:
+    ///
+    constexpr half(
+        std::uint16_t bits,
+        int )
+        :
+        m_bits( bits )
+    {
+        ;
+    }
+
+    ///
+    std::uint16_t m_bits;
+};
+
+static_assert( sizeof( half ) == 2, "half must be 16 bits" );
+
+///
+inline half operator +( half lhs, half rhs ) { return lhs += rhs; }
+inline half operator -( half lhs, half rhs ) { return lhs -= rhs; }
+inline half operator *( half lhs, half rhs ) { return lhs *= rhs; }
+inline half operator /( half lhs, half rhs ) { return lhs /= rhs; }
+
+///
+inline bool operator ==( half lhs, half rhs ) { return float( lhs ) == float( rhs ); }
+inline bool operator !=( half lhs, half rhs ) { return float( lhs ) != float( rhs ); }
+inline bool operator <( half lhs, half rhs ) { return float( lhs ) < float( rhs ); }
+inline bool operator >( half lhs, half rhs ) { return float( lhs ) > float( rhs ); }
+inline bool operator <=( half lhs, half rhs ) { return float( lhs ) <= float( rhs ); }
+inline bool operator >=( half lhs, half rhs ) { return float( lhs ) >= float( rhs ); }
+
+///
+template<>
+struct is_pixel< half > : std::true_type
+{
+};
+
+///
+template<>
+struct is_half< half > : std::true_type
+{
+};
+
+///Converts n halfs to float, eight at a time with F16C when available
+inline void half_to_float(
+    half const* src,
+    std::size_t n,
+    float* dst )
+{
+    std::size_t i = 0;
+#if defined( GISRASTER_HAS_F16C )
+    for( std::size_t const nv = n - n % 8; i < nv; i += 8 )
+    {
+        __m128i const h = _mm_loadu_si128(
+            reinterpret_cast< __m128i const* >( src + i ) );
+        _mm256_storeu_ps( dst + i, _mm256_cvtph_ps( h ) );
+    }
+#endif
+    for( ; i < n; ++i ) dst[ i ] = float( src[ i ] );
+}
+
+///Converts n floats to half, eight at a time with F16C when available
+inline void float_to_half(
+    float const* src,
+    std::size_t n,
+    half* dst )
+{
+    std::size_t i = 0;
+#if defined( GISRASTER_HAS_F16C )
+    for( std::size_t const nv = n - n % 8; i < nv; i += 8 )
+    {
+        __m128i const h = _mm256_cvtps_ph(
+            _mm256_loadu_ps( src + i ), _MM_FROUND_TO_NEAREST_INT );
+        _mm_storeu_si128( reinterpret_cast< __m128i* >( dst + i ), h );
+    }
+#endif
+    for( ; i < n; ++i ) dst[ i ] = half( src[ i ] );
+}
+
+namespace detail
+{
+
+///Block size used to stage half pixels as float
+static constexpr std::size_t HalfBlock = 256;
+
+///Reductions over half pixels, done on float blocks
+template<>
+struct Reduce< half >
+{
+    ///Merges the summary of the valid pixels of [p, p + n) into s
+    static void summarize(
+        half const* p,
+        std::size_t n,
+        half nodata,
+        Summary< half >& s )
+    {
+        float const nd = nodata;
+        summarize_if( p, n, [ nd ]( float v, std::size_t )
+            {
+                return v != nd;
+            }, s );
+    }
+
+    ///Same for the pixels for which valid( value as float, index ) holds
+    template< typename V >
+    static void summarize_if(
+        half const* p,
+        std::size_t n,
+        V valid_at,
+        Summary< half >& s )
+    {
+        float buf[ HalfBlock ];
+        std::size_t count = 0;
+        float lo = std::numeric_limits< float >::infinity();
+        float hi = -std::numeric_limits< float >::infinity();
+        double sum = 0.0;
+        for( std::size_t b = 0; b < n; b += HalfBlock )
+        {
+            std::size_t const m = std::min( HalfBlock, n - b );
+            half_to_float( p + b, m, buf );
+            float part = 0.0f;
+            for( std::size_t i = 0; i < m; ++i )
+            {
+                bool const valid = valid_at( buf[ i ], b + i );
+                count += valid;
+                part += valid ? buf[ i ] : 0.0f;
+                lo = ( valid && buf[ i ] < lo ) ? buf[ i ] : lo;
+                hi = ( valid && hi < buf[ i ] ) ? buf[ i ] : hi;
+            }
+            sum += part;
+        }
+        Summary< half > r;
+        r.count = count;
+        r.min = half( lo );
+        r.max = half( hi );
+        r.sum = sum;
+        s.merge( r );
+    }
+};
+
+///float to half conversion in bulk
+template<>
+struct Convert< half, float >
+{
+    ///
+    template< typename D, typename Op >
+    static void run(
+        float const* src,
+        std::size_t n,
+        D& dst,
+        Op op )
+    {
+        //Range check first so out of range values behave as in limits()
+        for( std::size_t i = 0; i < n; ++i )
+        {
+            float const v = src[ i ];
+            if( v != v || ( v >= -65504.0f && v <= 65504.0f ) ) continue;
+            std::transform( src, src + n, std::back_inserter( dst ), op );
+            return;
+        }
+        dst.resize( n );
+        float_to_half( src, n, dst.data() );
+    }
+};
+
+///half to float conversion in bulk
+template<>
+struct Convert< float, half >
+{
+    ///
+    template< typename D, typename Op >
+    static void run(
+        half const* src,
+        std::size_t n,
+        D& dst,
+        Op )
+    {
+        dst.resize( n );
+        half_to_float( src, n, dst.data() );
+    }
+};
+
+} //end detail
+
+} //end gis
+
+namespace std
+{
+
+///
+template<>
+class numeric_limits< gis::half >
+{
+public:
+    static constexpr bool is_specialized = true;
+    static constexpr bool is_signed = true;
+    static constexpr bool is_integer = false;
+    static constexpr bool is_exact = false;
+    static constexpr bool has_infinity = true;
+    static constexpr bool has_quiet_NaN = true;
+    static constexpr bool has_signaling_NaN = true;
+    static constexpr bool is_iec559 = true;
+    static constexpr bool is_bounded = true;
+    static constexpr bool is_modulo = false;
+    static constexpr int digits = 11;
+    static constexpr int digits10 = 3;
+    static constexpr int max_digits10 = 5;
+    static constexpr int radix = 2;
+    static constexpr int min_exponent = -13;
+    static constexpr int min_exponent10 = -4;
+    static constexpr int max_exponent = 16;
+    static constexpr int max_exponent10 = 4;
+
+    static constexpr gis::half min() { return gis::half::from_bits( 0x0400 ); }
+    static constexpr gis::half lowest() { return gis::half::from_bits( 0xFBFF ); }
+    static constexpr gis::half max() { return gis::half::from_bits( 0x7BFF ); }
+    static constexpr gis::half epsilon() { return gis::half::from_bits( 0x1400 ); }
+    static constexpr gis::half round_error() { return gis::half::from_bits( 0x3800 ); }
+    static constexpr gis::half infinity() { return gis::half::from_bits( 0x7C00 ); }
+    static constexpr gis::half quiet_NaN() { return gis::half::from_bits( 0x7E00 ); }
+    static constexpr gis::half signaling_NaN() { return gis::half::from_bits( 0x7D00 ); }
+    static constexpr gis::half denorm_min() { return gis::half::from_bits( 0x0001 ); }
+};
+
+} //end std
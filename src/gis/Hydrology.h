@@ -0,0 +1,385 @@
+/*******************************************************************************
+ *
+ * MIT License
+ *
+ * Copyright (c) 2018 Joshua Koch
+ * 
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ * 
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ * 
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ *
+ ******************************************************************************/
+
+#pragma once
+
+#include <gis/Band.h>
+#include <gis/Parallel.h>
+
+#include <cmath>
+#include <cstdint>
+#include <functional>
+#include <limits>
+#include <queue>
+#include <vector>
+
+namespace gis
+{
+
+///D8 flow direction codes
+namespace d8
+{
+
+///
+static constexpr std::uint8_t None = 0;
+static constexpr std::uint8_t East = 1;
+static constexpr std::uint8_t SouthEast = 2;
+static constexpr std::uint8_t South = 4;
+static constexpr std::uint8_t SouthWest = 8;
+static constexpr std::uint8_t West = 16;
+static constexpr std::uint8_t NorthWest = 32;
+static constexpr std::uint8_t North = 64;
+static constexpr std::uint8_t NorthEast = 128;
+
+///Direction band nodata value
+static constexpr std::uint8_t Nodata = 255;
+
+///Neighbor offsets, indexed by the bit position of the code
+static constexpr int dr[ 8 ] = { 0, 1, 1, 1, 0, -1, -1, -1 };
+static constexpr int dc[ 8 ] = { 1, 1, 0, -1, -1, -1, 0, 1 };
+
+} //end d8
+
+namespace detail
+{
+
+///Smallest value of T greater than val
+template< typename T >
+T next_up(
+    T val,
+    std::true_type )
+{
+    return std::nextafter( val, std::numeric_limits< T >::infinity() );
+}
+
+///
+template< typename T >
+T next_up(
+    T val,
+    std::false_type )
+{
+    return ( val < std::numeric_limits< T >::max() ) ? val + 1 : val;
+}
+
+///
+template< typename T >
+T next_up(
+    T val )
+{
+    return next_up( val, std::is_floating_point< T >{} );
+}
+
+///Priority queue entry; I is the narrowest index type that fits the band
+template< typename T, typename I >
+struct FloodCell
+{
+    ///
+    T z;
+
+    ///
+    I i;
+
+    ///
+    bool operator >(
+        FloodCell const& o ) const
+    {
+        return ( z > o.z );
+    }
+};
+
+///
+template< typename I, typename T >
+void fill_depressions(
+    Band< T >& dem,
+    bool epsilon )
+{
+    using Cell = FloodCell< T, I >;
+    int const w = dem.width(), h = dem.height();
+    T* const z = dem.data();
+    T const nodata = dem.nodatavalue();
+    std::priority_queue< Cell, std::vector< Cell >, std::greater< Cell > > open;
+    std::queue< I > pit;
+    std::vector< bool > closed( dem.size(), false );
+
+    //Seed with the edge cells and cells adjacent to nodata
+    for( int r = 0; r < h; ++r )
+    {
+        for( int c = 0; c < w; ++c )
+        {
+            I const i = static_cast< I >( r ) * w + c;
+            if( z[ i ] == nodata )
+            {
+                closed[ i ] = true;
+                continue;
+            }
+            bool edge = ( r == 0 || c == 0 || r == h - 1 || c == w - 1 );
+            for( int k = 0; !edge && k < 8; ++k )
+            {
+                edge = ( z[ i + d8::dr[ k ] * w + d8::dc[ k ] ] == nodata );
+            }
+            if( !edge ) continue;
+            open.push( { z[ i ], i } );
+            closed[ i ] = true;
+        }
+    }
+
+    while( !open.empty() || !pit.empty() )
+    {
+        I i;
+        //Flats are drained through the plain queue; in epsilon mode cells of
+        //equal height in the priority queue are taken first
+        if( !pit.empty() && !( epsilon && !open.empty() &&
+            open.top().z == z[ pit.front() ] ) )
+        {
+            i = pit.front();
+            pit.pop();
+        }
+        else
+        {
+            i = open.top().i;
+            open.pop();
+        }
+
+        int const r = static_cast< int >( i / w );
+        int const c = static_cast< int >( i % w );
+        T const zi = z[ i ];
+        T const fill = epsilon ? next_up( zi ) : zi;
+        for( int k = 0; k < 8; ++k )
+        {
+            int const nr = r + d8::dr[ k ], nc = c + d8::dc[ k ];
+            if( nr < 0 || nc < 0 || nr >= h || nc >= w ) continue;
+            I const n = static_cast< I >( nr ) * w + nc;
+            if( closed[ n ] ) continue;
+            closed[ n ] = true;
+            if( z[ n ] <= fill )
+            {
+                z[ n ] = fill;
+                pit.push( n );
+            }
+            else
+            {
+                open.push( { z[ n ], n } );
+            }
+        }
+    }
+}
+
+///
+template< typename I, typename R >
+void flow_accumulation(
+    Band< std::uint8_t > const& dir,
+    R* acc )
+{
+    int const w = dir.width(), h = dir.height();
+    std::uint8_t const* const d = dir.data();
+    Buffer< std::uint8_t > indegree( dir.size(), 0 );
+
+    //Count inflowing neighbors by pulling, so rows can run in parallel
+    parallel_for( 0, h, [ & ]( int rbegin, int rend )
+        {
+            for( int r = rbegin; r < rend; ++r )
+            {
+                for( int c = 0; c < w; ++c )
+                {
+                    std::uint8_t count = 0;
+                    for( int k = 0; k < 8; ++k )
+                    {
+                        int const nr = r + d8::dr[ k ], nc = c + d8::dc[ k ];
+                        if( nr < 0 || nc < 0 || nr >= h || nc >= w ) continue;
+                        //The neighbor drains into this cell in direction k+4
+                        if( d[ static_cast< I >( nr ) * w + nc ] ==
+                            ( 1 << ( ( k + 4 ) % 8 ) ) ) ++count;
+                    }
+                    indegree[ static_cast< I >( r ) * w + c ] = count;
+                }
+            }
+        }, 64 );
+
+    //Kahn's topological order, starting at the ridge cells
+    std::vector< I > ready;
+    for( I i = 0; i < static_cast< I >( dir.size() ); ++i )
+    {
+        if( d[ i ] != d8::Nodata && indegree[ i ] == 0 ) ready.push_back( i );
+    }
+    while( !ready.empty() )
+    {
+        I const i = ready.back();
+        ready.pop_back();
+        std::uint8_t const code = d[ i ];
+        if( code == d8::None || code == d8::Nodata ) continue;
+        int k = 0;
+        while( k < 8 && code != ( 1 << k ) ) ++k;
+        if( k == 8 ) continue;
+        int const nr = static_cast< int >( i / w ) + d8::dr[ k ];
+        int const nc = static_cast< int >( i % w ) + d8::dc[ k ];
+        if( nr < 0 || nc < 0 || nr >= h || nc >= w ) continue;
+        I const n = static_cast< I >( nr ) * w + nc;
+        if( d[ n ] == d8::Nodata ) continue;
+        acc[ n ] += acc[ i ];
+        if( --indegree[ n ] == 0 ) ready.push_back( n );
+    }
+}
+
+} //end detail
+
+///Bytes fill_depressions needs beyond the band when every cell is queued at
+///once, which bounds its peak
+template< typename T >
+std::size_t fill_depressions_footprint(
+    Band< T > const& dem )
+{
+    std::size_t const cell = ( dem.size() <=
+        std::numeric_limits< std::uint32_t >::max() ) ?
+        sizeof( detail::FloodCell< T, std::uint32_t > ) :
+        sizeof( detail::FloodCell< T, std::uint64_t > );
+    return dem.size() / 8 + dem.size() * cell;
+}
+
+///Peak bytes flow_accumulation allocates for dir
+template< typename R = double >
+std::size_t flow_accumulation_footprint(
+    Band< std::uint8_t > const& dir )
+{
+    std::size_t const index = ( dir.size() <=
+        std::numeric_limits< std::uint32_t >::max() ) ? 4 : 8;
+    return dir.size() * ( sizeof( R ) + 1 + index );
+}
+
+///Fills depressions in place with Priority-Flood (Barnes et al. 2014).
+///Nodata cells are treated as outlets. With epsilon, filled cells are raised
+///by the smallest representable increment so every cell drains.
+template< typename T >
+void fill_depressions(
+    Band< T >& dem,
+    bool epsilon = false )
+{
+    GISRASTER_TRACE_SCOPE( "fill_depressions", dem.size(), dem.size() / 8 );
+    if( dem.size() <= std::numeric_limits< std::uint32_t >::max() )
+    {
+        detail::fill_depressions< std::uint32_t >( dem, epsilon );
+    }
+    else
+    {
+        detail::fill_depressions< std::uint64_t >( dem, epsilon );
+    }
+}
+
+///Steepest descent (D8) flow direction using the band's cell size. Cells with
+///no lower neighbor drain off the raster edge or into adjacent nodata when
+///they border it, and are d8::None otherwise.
+template< typename T >
+Band< std::uint8_t > flow_direction(
+    Band< T > const& dem )
+{
+    GISRASTER_TRACE_SCOPE( "flow_direction", dem.size(), dem.size() );
+    int const w = dem.width(), h = dem.height();
+    T const* const z = dem.data();
+    T const nodata = dem.nodatavalue();
+    double const dx = ( dem.scalex() != 0.0 ) ? std::abs( dem.scalex() ) : 1.0;
+    double const dy = ( dem.scaley() != 0.0 ) ? std::abs( dem.scaley() ) : 1.0;
+    double dist[ 8 ];
+    for( int k = 0; k < 8; ++k )
+    {
+        dist[ k ] = std::sqrt( d8::dr[ k ] * d8::dr[ k ] * dy * dy +
+            d8::dc[ k ] * d8::dc[ k ] * dx * dx );
+    }
+
+    Band< std::uint8_t > result;
+    result.copy_props( dem, d8::Nodata, d8::None );
+    std::uint8_t* const out = result.data();
+    parallel_for( 0, h, [ & ]( int rbegin, int rend )
+        {
+            for( int r = rbegin; r < rend; ++r )
+            {
+                for( int c = 0; c < w; ++c )
+                {
+                    std::size_t const i = static_cast< std::size_t >( r ) * w + c;
+                    if( z[ i ] == nodata )
+                    {
+                        out[ i ] = d8::Nodata;
+                        continue;
+                    }
+                    double best = 0.0;
+                    int outlet = -1;
+                    std::uint8_t code = d8::None;
+                    for( int k = 0; k < 8; ++k )
+                    {
+                        int const nr = r + d8::dr[ k ], nc = c + d8::dc[ k ];
+                        if( nr < 0 || nc < 0 || nr >= h || nc >= w ||
+                            z[ i + d8::dr[ k ] * w + d8::dc[ k ] ] == nodata )
+                        {
+                            if( outlet < 0 ) outlet = k;
+                            continue;
+                        }
+                        double const drop = ( static_cast< double >( z[ i ] ) -
+                            z[ i + d8::dr[ k ] * w + d8::dc[ k ] ] ) / dist[ k ];
+                        if( drop > best )
+                        {
+                            best = drop;
+                            code = static_cast< std::uint8_t >( 1 << k );
+                        }
+                    }
+                    if( code == d8::None && outlet >= 0 )
+                    {
+                        code = static_cast< std::uint8_t >( 1 << outlet );
+                    }
+                    out[ i ] = code;
+                }
+            }
+        }, 64 );
+    return result;
+}
+
+///Number of cells draining through each cell (including itself), computed in
+///topological order of the D8 flow graph
+template< typename R = double >
+Band< R > flow_accumulation(
+    Band< std::uint8_t > const& dir )
+{
+    GISRASTER_TRACE_SCOPE( "flow_accumulation",
+        dir.size(), dir.size() * ( sizeof( R ) + 1 ) );
+    MemoryAccountant::current().check( flow_accumulation_footprint< R >( dir ) );
+    Band< R > result;
+    result.copy_props( dir, Band< R >::Lowest, 1 );
+    if( dir.size() <= std::numeric_limits< std::uint32_t >::max() )
+    {
+        detail::flow_accumulation< std::uint32_t >( dir, result.data() );
+    }
+    else
+    {
+        detail::flow_accumulation< std::uint64_t >( dir, result.data() );
+    }
+
+    std::uint8_t const* const d = dir.data();
+    R* const out = result.data();
+    for( std::size_t i = 0; i < result.size(); ++i )
+    {
+        if( d[ i ] == d8::Nodata ) out[ i ] = result.nodatavalue();
+    }
+    return result;
+}
+
+} //end gis
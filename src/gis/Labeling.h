@@ -0,0 +1,333 @@
+/*******************************************************************************
+ *
+ * MIT License
+ *
+ * Copyright (c) 2018 Joshua Koch
+ * 
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ * 
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ * 
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ *
+ ******************************************************************************/
+
+#pragma once
+
+#include <gis/Band.h>
+#include <gis/Parallel.h>
+
+#include <algorithm>
+#include <cstdint>
+#include <limits>
+#include <vector>
+
+namespace gis
+{
+
+///Pixel neighborhood used to join pixels into regions
+enum class Connectivity
+{
+    ///
+    Four,
+
+    ///
+    Eight
+};
+
+///Summary of a labeled region
+struct Component
+{
+    ///
+    std::int32_t label;
+
+    ///Number of pixels
+    std::size_t area;
+
+    ///Bounding box, inclusive
+    int minrow;
+    int mincol;
+    int maxrow;
+    int maxcol;
+};
+
+namespace detail
+{
+
+///
+inline std::int32_t uf_find(
+    std::vector< std::int32_t >& parent,
+    std::int32_t i )
+{
+    while( parent[ i ] != i )
+    {
+        parent[ i ] = parent[ parent[ i ] ];
+        i = parent[ i ];
+    }
+    return i;
+}
+
+///
+inline void uf_union(
+    std::vector< std::int32_t >& parent,
+    std::int32_t a,
+    std::int32_t b )
+{
+    a = uf_find( parent, a );
+    b = uf_find( parent, b );
+    if( a < b ) parent[ b ] = a;
+    else if( b < a ) parent[ a ] = b;
+}
+
+///Replaces each entry by the 1-based number of its set and returns the number
+///of sets. Relies on parents always having a lower index than their children.
+inline std::int32_t uf_compact(
+    std::vector< std::int32_t >& parent )
+{
+    std::int32_t n = 0;
+    for( std::size_t i = 1; i < parent.size(); ++i )
+    {
+        parent[ i ] = ( parent[ i ] == static_cast< std::int32_t >( i ) ) ?
+            ++n : parent[ parent[ i ] ];
+    }
+    return n;
+}
+
+///Two-pass union-find labeling over parallel row strips. fg( v ) selects
+///foreground pixels and join( a, b ) decides whether two adjacent foreground
+///pixels belong to the same region.
+template< typename T, typename F, typename J >
+std::int32_t label_components(
+    Band< T > const& src,
+    Band< std::int32_t >& labels,
+    Connectivity conn,
+    std::vector< Component >* stats,
+    F fg,
+    J join )
+{
+    GISRASTER_TRACE_SCOPE( "label_components",
+        src.size(), src.size() * sizeof( std::int32_t ) );
+    int const w = src.width(), h = src.height();
+    labels.copy_props( src, 0, 0 );
+    if( stats ) stats->clear();
+    if( w == 0 || h == 0 ) return 0;
+
+    T const* const s = src.data();
+    std::int32_t* const l = labels.data();
+    bool const eight = ( conn == Connectivity::Eight );
+    int const nstrips = std::min( h, static_cast< int >( thread_count() ) );
+    std::vector< int > first( nstrips + 1 );
+    for( int i = 0; i <= nstrips; ++i )
+    {
+        first[ i ] = static_cast< int >(
+            static_cast< long long >( h ) * i / nstrips );
+    }
+
+    //Pass 1: provisional labels and equivalences within each strip, then
+    //compacted to 1..count per strip
+    std::vector< std::vector< std::int32_t > > local( nstrips );
+    std::vector< std::int32_t > count( nstrips, 0 );
+    parallel_for( 0, nstrips, [ & ]( int sbegin, int send )
+        {
+            for( int st = sbegin; st < send; ++st )
+            {
+                auto& parent = local[ st ];
+                parent.assign( 1, 0 );
+                for( int r = first[ st ]; r < first[ st + 1 ]; ++r )
+                {
+                    std::size_t const row = static_cast< std::size_t >( r ) * w;
+                    bool const up = ( r > first[ st ] );
+                    for( int c = 0; c < w; ++c )
+                    {
+                        std::size_t const i = row + c;
+                        if( !fg( s[ i ] ) )
+                        {
+                            l[ i ] = 0;
+                            continue;
+                        }
+                        std::int32_t label = 0;
+                        auto visit = [ & ]( std::size_t n )
+                        {
+                            if( l[ n ] == 0 || !join( s[ i ], s[ n ] ) ) return;
+                            if( label == 0 ) label = l[ n ];
+                            else uf_union( parent, label, l[ n ] );
+                        };
+                        if( c > 0 ) visit( i - 1 );
+                        if( up )
+                        {
+                            visit( i - w );
+                            if( eight && c > 0 ) visit( i - w - 1 );
+                            if( eight && c + 1 < w ) visit( i - w + 1 );
+                        }
+                        if( label == 0 )
+                        {
+                            label = static_cast< std::int32_t >( parent.size() );
+                            parent.push_back( label );
+                        }
+                        l[ i ] = label;
+                    }
+                }
+
+                count[ st ] = uf_compact( parent );
+            }
+        } );
+
+    //Merge equivalences across strip seams in a global label space
+    std::vector< std::int32_t > offset( nstrips + 1, 0 );
+    for( int st = 0; st < nstrips; ++st )
+    {
+        offset[ st + 1 ] = offset[ st ] + count[ st ];
+    }
+    std::vector< std::int32_t > global( offset[ nstrips ] + 1 );
+    for( std::size_t i = 0; i < global.size(); ++i )
+    {
+        global[ i ] = static_cast< std::int32_t >( i );
+    }
+    for( int st = 1; st < nstrips; ++st )
+    {
+        std::size_t const row = static_cast< std::size_t >( first[ st ] ) * w;
+        auto const& above = local[ st - 1 ];
+        auto const& below = local[ st ];
+        for( int c = 0; c < w; ++c )
+        {
+            std::size_t const i = row + c;
+            if( l[ i ] == 0 ) continue;
+            std::int32_t const a = offset[ st ] + below[ l[ i ] ];
+            for( int dc = ( eight ? -1 : 0 ); dc <= ( eight ? 1 : 0 ); ++dc )
+            {
+                if( c + dc < 0 || c + dc >= w ) continue;
+                std::size_t const n = i - w + dc;
+                if( l[ n ] == 0 || !join( s[ i ], s[ n ] ) ) continue;
+                uf_union( global, a, offset[ st - 1 ] + above[ l[ n ] ] );
+            }
+        }
+    }
+    std::int32_t const total = uf_compact( global );
+
+    //Pass 2: final labels, with per strip statistics merged afterwards
+    std::vector< std::vector< Component > > partial( stats ? nstrips : 0 );
+    parallel_for( 0, nstrips, [ & ]( int sbegin, int send )
+        {
+            for( int st = sbegin; st < send; ++st )
+            {
+                auto const& parent = local[ st ];
+                std::vector< Component >* part = nullptr;
+                if( stats )
+                {
+                    part = &partial[ st ];
+                    part->assign( count[ st ] + 1, { 0, 0,
+                        std::numeric_limits< int >::max(),
+                        std::numeric_limits< int >::max(), -1, -1 } );
+                }
+                for( int r = first[ st ]; r < first[ st + 1 ]; ++r )
+                {
+                    std::size_t const row = static_cast< std::size_t >( r ) * w;
+                    for( int c = 0; c < w; ++c )
+                    {
+                        std::int32_t& v = l[ row + c ];
+                        if( v == 0 ) continue;
+                        std::int32_t const compact = parent[ v ];
+                        v = global[ offset[ st ] + compact ];
+                        if( !part ) continue;
+                        Component& comp = ( *part )[ compact ];
+                        comp.label = v;
+                        ++comp.area;
+                        comp.minrow = std::min( comp.minrow, r );
+                        comp.maxrow = std::max( comp.maxrow, r );
+                        comp.mincol = std::min( comp.mincol, c );
+                        comp.maxcol = std::max( comp.maxcol, c );
+                    }
+                }
+            }
+        } );
+
+    if( stats )
+    {
+        stats->assign( total, { 0, 0, std::numeric_limits< int >::max(),
+            std::numeric_limits< int >::max(), -1, -1 } );
+        for( auto const& part : partial )
+        {
+            for( auto const& p : part )
+            {
+                if( p.area == 0 ) continue;
+                Component& comp = ( *stats )[ p.label - 1 ];
+                comp.label = p.label;
+                comp.area += p.area;
+                comp.minrow = std::min( comp.minrow, p.minrow );
+                comp.maxrow = std::max( comp.maxrow, p.maxrow );
+                comp.mincol = std::min( comp.mincol, p.mincol );
+                comp.maxcol = std::max( comp.maxcol, p.maxcol );
+            }
+        }
+    }
+    return total;
+}
+
+} //end detail
+
+///Bytes label_components allocates for src in the worst case (every other
+///pixel a separate region), excluding the statistics
+template< typename T >
+std::size_t label_components_footprint(
+    Band< T > const& src )
+{
+    return src.size() * sizeof( std::int32_t ) +
+        ( src.size() / 2 + 1 ) * sizeof( std::int32_t ) * 2;
+}
+
+///Labels regions of adjacent pixels sharing the same value; nodata pixels
+///are background (0). Labels are 1..N and N is returned. When stats is given
+///it receives the area and bounding box of each region, indexed by label - 1.
+template< typename T >
+std::int32_t label_components(
+    Band< T > const& src,
+    Band< std::int32_t >& labels,
+    Connectivity conn = Connectivity::Eight,
+    std::vector< Component >* stats = nullptr )
+{
+    T const nodata = src.nodatavalue();
+    return detail::label_components( src, labels, conn, stats,
+        [ nodata ]( T v )
+        {
+            return ( v != nodata );
+        },
+        []( T a, T b )
+        {
+            return ( a == b );
+        } );
+}
+
+///Labels regions of adjacent pixels with values above threshold
+template< typename T, typename U >
+std::int32_t label_above(
+    Band< T > const& src,
+    U threshold,
+    Band< std::int32_t >& labels,
+    Connectivity conn = Connectivity::Eight,
+    std::vector< Component >* stats = nullptr )
+{
+    T const nodata = src.nodatavalue();
+    return detail::label_components( src, labels, conn, stats,
+        [ nodata, threshold ]( T v )
+        {
+            return ( v != nodata ) && ( v > threshold );
+        },
+        []( T, T )
+        {
+            return true;
+        } );
+}
+
+} //end gis
@@ -0,0 +1,495 @@
+/*******************************************************************************
+ *
+ * MIT License
+ *
+ * Copyright (c) 2018 Joshua Koch
+ * 
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ * 
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ * 
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ *
+ ******************************************************************************/
+
+#pragma once
+
+#include <gis/Band.h>
+#include <gis/Parallel.h>
+#include <gis/Raster.h>
+#include <gis/Stats.h>
+#include <gis/Trace.h>
+
+#include <algorithm>
+#include <cstdint>
+#include <stdexcept>
+#include <utility>
+#include <vector>
+
+namespace gis
+{
+
+///What a tile of a band holds
+enum class TileState : std::uint8_t
+{
+    ///Every pixel is valid (or, for a mask, set)
+    Valid,
+
+    ///No pixel is valid (or, for a mask, every pixel is clear or nodata)
+    Masked,
+
+    ///
+    Mixed
+};
+
+///
+enum class Compare
+{
+    Less,
+    LessEqual,
+    Equal,
+    NotEqual,
+    GreaterEqual,
+    Greater
+};
+
+namespace detail
+{
+
+///Calls fn( tile, r0, c0, r1, c1 ) for every statistics tile of a width x
+///height band, in parallel
+template< typename T, typename F >
+void for_each_stats_tile(
+    int width,
+    int height,
+    F&& fn )
+{
+    int constexpr shift = StatsCache< T >::TileShift;
+    int constexpr size = StatsCache< T >::TileSize;
+    int const across = ( width + size - 1 ) >> shift;
+    int const down = ( height + size - 1 ) >> shift;
+    parallel_for( 0, across * down, [ & ]( int begin, int end )
+        {
+            for( int t = begin; t < end; ++t )
+            {
+                int const r0 = ( t / across ) << shift;
+                int const c0 = ( t % across ) << shift;
+                fn( static_cast< std::size_t >( t ), r0, c0, std::min( r0 + size, height ),
+                    std::min( c0 + size, width ) );
+            }
+        } );
+}
+
+///
+inline std::size_t tile_pixels(
+    int r0,
+    int c0,
+    int r1,
+    int c1 )
+{
+    return static_cast< std::size_t >( r1 - r0 ) * ( c1 - c0 );
+}
+
+///State of a tile of a mask from its summary: Valid when every pixel is
+///set (valid and not 0), Masked when none is
+template< typename U >
+TileState mask_state(
+    Summary< U > const& s,
+    std::size_t pixels )
+{
+    U const zero = U( 0 );
+    if( s.count == 0 || ( s.min == zero && s.max == zero ) ) return TileState::Masked;
+    bool const has_zero = !( zero < s.min ) && !( s.max < zero );
+    return ( s.count == pixels && !has_zero ) ? TileState::Valid : TileState::Mixed;
+}
+
+///Summary of rows [ r0, r1 ) and columns [ c0, c1 ) of a band of width w
+template< typename T >
+Summary< T > tile_summary(
+    T const* data,
+    int w,
+    T nodata,
+    int r0,
+    int c0,
+    int r1,
+    int c1 )
+{
+    Summary< T > s;
+    for( int r = r0; r < r1; ++r )
+    {
+        Reduce< T >::summarize( data + static_cast< std::size_t >( r ) * w + c0,
+            static_cast< std::size_t >( c1 - c0 ), nodata, s );
+    }
+    return s;
+}
+
+///
+template< typename T >
+void fill_tile(
+    T* data,
+    int w,
+    T value,
+    int r0,
+    int c0,
+    int r1,
+    int c1 )
+{
+    for( int r = r0; r < r1; ++r )
+    {
+        T* row = data + static_cast< std::size_t >( r ) * w;
+        std::fill( row + c0, row + c1, value );
+    }
+}
+
+///
+template< typename T >
+void copy_tile(
+    T const* from,
+    T* to,
+    int w,
+    int r0,
+    int c0,
+    int r1,
+    int c1 )
+{
+    for( int r = r0; r < r1; ++r )
+    {
+        std::size_t const row = static_cast< std::size_t >( r ) * w;
+        std::copy( from + row + c0, from + row + c1, to + row + c0 );
+    }
+}
+
+///Mask bytes of a range: 1 where op holds, 0 where not, 255 on nodata
+template< typename T, typename F >
+void compare_range(
+    T const* p,
+    std::size_t n,
+    T nodata,
+    F op,
+    std::uint8_t* out )
+{
+    for( std::size_t i = 0; i < n; ++i )
+    {
+        std::uint8_t const set = op( p[ i ] ) ? 1 : 0;
+        out[ i ] = ( p[ i ] != nodata ) ? set : std::uint8_t( 255 );
+    }
+}
+
+///
+template< typename T, typename F >
+void compare_tile(
+    Band< T > const& band,
+    F op,
+    std::uint8_t* out,
+    int r0,
+    int c0,
+    int r1,
+    int c1 )
+{
+    int const w = band.width();
+    for( int r = r0; r < r1; ++r )
+    {
+        std::size_t const row = static_cast< std::size_t >( r ) * w + c0;
+        compare_range( band.data() + row, static_cast< std::size_t >( c1 - c0 ),
+            band.nodatavalue(), op, out + row );
+    }
+}
+
+///Summary of a tile of 0 / 1 mask bytes with nodata 255
+inline Summary< std::uint8_t > flag_summary(
+    std::uint8_t const* data,
+    int w,
+    int r0,
+    int c0,
+    int r1,
+    int c1 )
+{
+    std::size_t count = 0;
+    std::size_t ones = 0;
+    for( int r = r0; r < r1; ++r )
+    {
+        std::uint8_t const* row = data + static_cast< std::size_t >( r ) * w;
+        for( int c = c0; c < c1; ++c )
+        {
+            count += ( row[ c ] != 255 );
+            ones += ( row[ c ] == 1 );
+        }
+    }
+    Summary< std::uint8_t > s;
+    s.count = count;
+    s.sum = ones;
+    s.min = ( count > 0 && ones == count ) ? 1 : 0;
+    s.max = ( ones > 0 ) ? 1 : 0;
+    return s;
+}
+
+} //end detail
+
+///State of each statistics tile of band ( Band::tile_summaries() order ),
+///from its cached tile summaries
+template< typename T >
+std::vector< TileState > tile_states(
+    Band< T > const& band )
+{
+    std::vector< Summary< T > > const tiles = band.tile_summaries();
+    std::vector< TileState > result( tiles.size() );
+    detail::for_each_stats_tile< T >( band.width(), band.height(),
+        [ & ]( std::size_t t, int r0, int c0, int r1, int c1 )
+        {
+            std::size_t const n = detail::tile_pixels( r0, c0, r1, c1 );
+            result[ t ] = ( tiles[ t ].count == 0 ) ? TileState::Masked :
+                ( tiles[ t ].count == n ? TileState::Valid : TileState::Mixed );
+        } );
+    return result;
+}
+
+///Calls fn( r0, c0, r1, c1, state ) in parallel for the statistics tiles
+///of band that hold valid pixels, so kernels skip masked tiles and can
+///drop the nodata test on Valid ones
+template< typename T, typename F >
+void for_each_tile(
+    Band< T > const& band,
+    F&& fn )
+{
+    std::vector< TileState > const states = tile_states( band );
+    detail::for_each_stats_tile< T >( band.width(), band.height(),
+        [ & ]( std::size_t t, int r0, int c0, int r1, int c1 )
+        {
+            if( states[ t ] != TileState::Masked ) fn( r0, c0, r1, c1, states[ t ] );
+        } );
+}
+
+///Mask of band against value: 1 where band op value holds, 0 where not
+///and 255 (nodata) on nodata pixels. The tile summaries of the result are
+///filled in as it is written.
+template< typename T >
+Band< std::uint8_t > compare(
+    Band< T > const& band,
+    Compare op,
+    T value )
+{
+    GISRASTER_TRACE_SCOPE( "compare", band.size(), band.size() );
+    std::vector< TileState > const states = tile_states( band );
+    Band< std::uint8_t > result;
+    result.copy_props( band, 255, no_init );
+    std::uint8_t* out = result.data();
+    int const w = band.width();
+    std::vector< Summary< std::uint8_t > > summaries( states.size() );
+    detail::for_each_stats_tile< T >( band.width(), band.height(),
+        [ & ]( std::size_t t, int r0, int c0, int r1, int c1 )
+        {
+            if( states[ t ] == TileState::Masked )
+            {
+                detail::fill_tile( out, w, std::uint8_t( 255 ), r0, c0, r1, c1 );
+                return;
+            }
+            //One loop per operator keeps the comparison out of the loop body
+            switch( op )
+            {
+            case Compare::Less:
+                detail::compare_tile( band, [ value ]( T v ) { return v < value; },
+                    out, r0, c0, r1, c1 );
+                break;
+            case Compare::LessEqual:
+                detail::compare_tile( band, [ value ]( T v ) { return !( value < v ); },
+                    out, r0, c0, r1, c1 );
+                break;
+            case Compare::Equal:
+                detail::compare_tile( band, [ value ]( T v ) { return v == value; },
+                    out, r0, c0, r1, c1 );
+                break;
+            case Compare::NotEqual:
+                detail::compare_tile( band, [ value ]( T v ) { return v != value; },
+                    out, r0, c0, r1, c1 );
+                break;
+            case Compare::GreaterEqual:
+                detail::compare_tile( band, [ value ]( T v ) { return !( v < value ); },
+                    out, r0, c0, r1, c1 );
+                break;
+            default:
+                detail::compare_tile( band, [ value ]( T v ) { return value < v; },
+                    out, r0, c0, r1, c1 );
+                break;
+            }
+            summaries[ t ] = detail::flag_summary( out, w, r0, c0, r1, c1 );
+        } );
+    result.tile_summaries( std::move( summaries ) );
+    return result;
+}
+
+///band where mask is set (valid and not 0), nodata elsewhere. Tiles the
+///mask clears are filled without reading band, tiles it sets are copied,
+///and the result's tile summaries are filled in as it is written.
+template< typename T, typename U >
+Band< T > apply_mask(
+    Band< T > const& band,
+    Band< U > const& mask )
+{
+    if( band.width() != mask.width() || band.height() != mask.height() )
+    {
+        throw std::invalid_argument( "apply_mask: band and mask differ in size" );
+    }
+    GISRASTER_TRACE_SCOPE( "apply_mask", band.size(), band.size() * sizeof( T ) );
+    std::vector< Summary< T > > const tiles = band.tile_summaries();
+    std::vector< Summary< U > > const masks = mask.tile_summaries();
+    Band< T > result;
+    result.copy_props( band, band.nodatavalue(), no_init );
+    T* out = result.data();
+    T const* in = band.data();
+    U const* m = mask.data();
+    T const nodata = band.nodatavalue();
+    U const mnodata = mask.nodatavalue();
+    int const w = band.width();
+    std::vector< Summary< T > > summaries( tiles.size() );
+    detail::for_each_stats_tile< T >( band.width(), band.height(),
+        [ & ]( std::size_t t, int r0, int c0, int r1, int c1 )
+        {
+            std::size_t const n = detail::tile_pixels( r0, c0, r1, c1 );
+            TileState const state = detail::mask_state( masks[ t ], n );
+            if( state == TileState::Masked || tiles[ t ].count == 0 )
+            {
+                detail::fill_tile( out, w, nodata, r0, c0, r1, c1 );
+                return;
+            }
+            if( state == TileState::Valid )
+            {
+                detail::copy_tile( in, out, w, r0, c0, r1, c1 );
+                summaries[ t ] = tiles[ t ];
+                return;
+            }
+            for( int r = r0; r < r1; ++r )
+            {
+                std::size_t const row = static_cast< std::size_t >( r ) * w;
+                for( int c = c0; c < c1; ++c )
+                {
+                    U const k = m[ row + c ];
+                    bool const set = ( k != mnodata ) && ( k != U( 0 ) );
+                    out[ row + c ] = set ? in[ row + c ] : nodata;
+                }
+            }
+            summaries[ t ] = detail::tile_summary( out, w, nodata, r0, c0, r1, c1 );
+        } );
+    result.tile_summaries( std::move( summaries ) );
+    return result;
+}
+
+namespace detail
+{
+
+///
+template< typename... Ts, typename U, std::size_t... Ns >
+Raster< Ts... > apply_mask_bands(
+    Raster< Ts... > const& raster,
+    Band< U > const& mask,
+    std::index_sequence< Ns... > )
+{
+    return Raster< Ts... >( apply_mask( raster.template band< Ns >(), mask )... );
+}
+
+} //end detail
+
+///Every band of raster masked by mask
+template< typename... Ts, typename U >
+Raster< Ts... > apply_mask(
+    Raster< Ts... > const& raster,
+    Band< U > const& mask )
+{
+    return detail::apply_mask_bands( raster, mask, std::index_sequence_for< Ts... >{} );
+}
+
+///a where cond is set (valid and not 0), b where it is clear, nodata (a's)
+///where cond or the chosen pixel is nodata. Whole tiles are copied from a
+///or b when cond is uniform over them.
+template< typename C, typename T >
+Band< T > where(
+    Band< C > const& cond,
+    Band< T > const& a,
+    Band< T > const& b )
+{
+    if( cond.width() != a.width() || cond.height() != a.height() ||
+        b.width() != a.width() || b.height() != a.height() )
+    {
+        throw std::invalid_argument( "where: bands differ in size" );
+    }
+    GISRASTER_TRACE_SCOPE( "where", a.size(), a.size() * sizeof( T ) );
+    std::vector< Summary< C > > const conds = cond.tile_summaries();
+    std::vector< Summary< T > > const as = a.tile_summaries();
+    std::vector< Summary< T > > const bs = b.tile_summaries();
+    Band< T > result;
+    result.copy_props( a, a.nodatavalue(), no_init );
+    T* out = result.data();
+    C const* k = cond.data();
+    C const cnodata = cond.nodatavalue();
+    T const* pa = a.data();
+    T const* pb = b.data();
+    T const nodata = a.nodatavalue();
+    T const bnodata = b.nodatavalue();
+    int const w = a.width();
+    std::vector< Summary< T > > summaries( as.size() );
+    detail::for_each_stats_tile< T >( a.width(), a.height(),
+        [ & ]( std::size_t t, int r0, int c0, int r1, int c1 )
+        {
+            std::size_t const n = detail::tile_pixels( r0, c0, r1, c1 );
+            Summary< C > const& s = conds[ t ];
+            if( s.count == 0 )
+            {
+                detail::fill_tile( out, w, nodata, r0, c0, r1, c1 );
+                return;
+            }
+            TileState const state = detail::mask_state( s, n );
+            if( state == TileState::Valid && as[ t ].count == n )
+            {
+                detail::copy_tile( pa, out, w, r0, c0, r1, c1 );
+                summaries[ t ] = as[ t ];
+                return;
+            }
+            if( s.count == n && state == TileState::Masked && bs[ t ].count == n &&
+                bnodata == nodata )
+            {
+                detail::copy_tile( pb, out, w, r0, c0, r1, c1 );
+                summaries[ t ] = bs[ t ];
+                return;
+            }
+            for( int r = r0; r < r1; ++r )
+            {
+                std::size_t const row = static_cast< std::size_t >( r ) * w;
+                for( int c = c0; c < c1; ++c )
+                {
+                    C const v = k[ row + c ];
+                    bool const set = ( v != C( 0 ) );
+                    T const x = set ? pa[ row + c ] : pb[ row + c ];
+                    bool const missing = ( v == cnodata ) || ( set ? false : x == bnodata );
+                    out[ row + c ] = missing ? nodata : x;
+                }
+            }
+            summaries[ t ] = detail::tile_summary( out, w, nodata, r0, c0, r1, c1 );
+        } );
+    result.tile_summaries( std::move( summaries ) );
+    return result;
+}
+
+///a where cond is set, value where it is clear
+template< typename C, typename T >
+Band< T > where(
+    Band< C > const& cond,
+    Band< T > const& a,
+    T value )
+{
+    Band< T > b;
+    b.copy_props( a, a.nodatavalue(), value );
+    return where( cond, a, b );
+}
+
+} //end gis
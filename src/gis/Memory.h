@@ -0,0 +1,747 @@
+/*******************************************************************************
+ *
+ * MIT License
+ *
+ * Copyright (c) 2018 Joshua Koch
+ * 
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ * 
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ * 
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ *
+ ******************************************************************************/
+
+#pragma once
+
+#include <atomic>
+#include <cassert>
+#include <cstddef>
+#include <cstdlib>
+#include <limits>
+#include <new>
+#include <string>
+#include <type_traits>
+#include <utility>
+#include <vector>
+
+#if !defined( _WIN32 )
+#include <sys/mman.h>
+#include <unistd.h>
+#endif
+
+namespace gis
+{
+
+///Tag for constructors that leave pixels unwritten
+struct no_init_t
+{
+};
+
+///
+static constexpr no_init_t no_init{};
+
+///What to do when an allocation would exceed the budget
+enum class OverBudget
+{
+    ///Throw memory_budget_exceeded
+    Throw,
+
+    ///Back the allocation with an unlinked temporary file instead
+    Spill
+};
+
+///Thrown when an allocation would exceed the memory budget
+class memory_budget_exceeded : public std::bad_alloc
+{
+public:
+    ///
+    memory_budget_exceeded(
+        std::size_t requested,
+        std::size_t used,
+        std::size_t budget )
+        :
+        m_requested( requested ),
+        m_used( used ),
+        m_budget( budget ),
+        m_what( "memory budget exceeded: requested " +
+            std::to_string( requested ) + " bytes with " +
+            std::to_string( used ) + " of " + std::to_string( budget ) +
+            " bytes in use" )
+    {
+        ;
+    }
+
+    ///
+    char const* what() const noexcept override
+    {
+        return m_what.c_str();
+    }
+
+    ///
+    std::size_t requested() const
+    {
+        return m_requested;
+    }
+
+    ///
+    std::size_t used() const
+    {
+        return m_used;
+    }
+
+    ///
+    std::size_t budget() const
+    {
+        return m_budget;
+    }
+
+private:
+    ///
+    std::size_t m_requested;
+
+    ///
+    std::size_t m_used;
+
+    ///
+    std::size_t m_budget;
+
+    ///
+    std::string m_what;
+};
+
+namespace detail
+{
+inline void* tracked_allocate( std::size_t bytes );
+inline void tracked_deallocate( void* p );
+} //end detail
+
+///Tracks the bytes held by band allocations against an optional budget.
+///Every block remembers the accountant it was charged to and releases its
+///bytes there, so an accountant must outlive the blocks allocated under
+///it; destroying one that still has live blocks asserts in debug builds.
+class MemoryAccountant
+{
+public:
+    ///
+    explicit MemoryAccountant(
+        std::size_t budget = 0,
+        OverBudget policy = OverBudget::Throw )
+        :
+        m_used( 0 ),
+        m_peak( 0 ),
+        m_spilled( 0 ),
+        m_blocks( 0 ),
+        m_budget( budget ),
+        m_policy( policy ),
+        m_process( false )
+    {
+        ;
+    }
+
+    ///
+    MemoryAccountant( MemoryAccountant const& ) = delete;
+
+    ///
+    MemoryAccountant& operator =( MemoryAccountant const& ) = delete;
+
+    ///
+    ~MemoryAccountant()
+    {
+        assert( ( m_process || blocks() == 0 ) &&
+            "MemoryAccountant destroyed with live blocks" );
+    }
+
+    ///Process-wide accountant
+    static MemoryAccountant& process()
+    {
+        //Blocks leaked until exit are not an error here
+        static MemoryAccountant accountant;
+        static bool const exempt = ( accountant.m_process = true );
+        ( void )exempt;
+        return accountant;
+    }
+
+    ///Accountant of the innermost MemoryContext on this thread, or the
+    ///process-wide one
+    static MemoryAccountant& current()
+    {
+        MemoryAccountant* a = scoped();
+        return a ? *a : process();
+    }
+
+    ///Bytes held in memory
+    std::size_t used() const
+    {
+        return m_used.load();
+    }
+
+    ///Most bytes held in memory at once
+    std::size_t peak() const
+    {
+        return m_peak.load();
+    }
+
+    ///Bytes held in spill files
+    std::size_t spilled() const
+    {
+        return m_spilled.load();
+    }
+
+    ///Blocks charged here and not yet deallocated, in memory or spilled
+    std::size_t blocks() const
+    {
+        return m_blocks.load();
+    }
+
+    ///0 means unlimited
+    std::size_t budget() const
+    {
+        return m_budget.load();
+    }
+    void budget(
+        std::size_t bytes )
+    {
+        m_budget.store( bytes );
+    }
+
+    ///
+    OverBudget policy() const
+    {
+        return m_policy.load();
+    }
+    void policy(
+        OverBudget val )
+    {
+        m_policy.store( val );
+    }
+
+    ///Bytes that can still be allocated in memory
+    std::size_t available() const
+    {
+        std::size_t const b = budget();
+        if( b == 0 ) return std::numeric_limits< std::size_t >::max();
+        std::size_t const u = used();
+        return ( u < b ) ? b - u : 0;
+    }
+
+    ///
+    bool would_fit(
+        std::size_t bytes ) const
+    {
+        return bytes <= available();
+    }
+
+    ///Throws memory_budget_exceeded unless bytes more would fit
+    void require(
+        std::size_t bytes ) const
+    {
+        if( !would_fit( bytes ) )
+        {
+            throw memory_budget_exceeded( bytes, used(), budget() );
+        }
+    }
+
+    ///Lets an operation fail before it starts when its estimated footprint
+    ///cannot be allocated under the Throw policy
+    void check(
+        std::size_t bytes ) const
+    {
+        if( policy() == OverBudget::Throw ) require( bytes );
+    }
+
+    ///Accounts for bytes if they fit in the budget
+    bool reserve(
+        std::size_t bytes )
+    {
+        std::size_t u = m_used.load();
+        do
+        {
+            std::size_t const b = budget();
+            if( b != 0 && ( bytes > b || u > b - bytes ) ) return false;
+        }
+        while( !m_used.compare_exchange_weak( u, u + bytes ) );
+
+        std::size_t p = m_peak.load();
+        while( u + bytes > p && !m_peak.compare_exchange_weak( p, u + bytes ) )
+        {
+            ;
+        }
+        return true;
+    }
+
+    ///
+    void release(
+        std::size_t bytes )
+    {
+        m_used.fetch_sub( bytes );
+    }
+
+    ///
+    void spill(
+        std::size_t bytes )
+    {
+        m_spilled.fetch_add( bytes );
+    }
+
+    ///
+    void unspill(
+        std::size_t bytes )
+    {
+        m_spilled.fetch_sub( bytes );
+    }
+
+private:
+    friend class MemoryContext;
+    friend void* detail::tracked_allocate( std::size_t );
+    friend void detail::tracked_deallocate( void* );
+
+    ///
+    static MemoryAccountant*& scoped()
+    {
+        static thread_local MemoryAccountant* accountant = nullptr;
+        return accountant;
+    }
+
+    ///
+    std::atomic< std::size_t > m_used;
+
+    ///
+    std::atomic< std::size_t > m_peak;
+
+    ///
+    std::atomic< std::size_t > m_spilled;
+
+    ///
+    std::atomic< std::size_t > m_blocks;
+
+    ///
+    std::atomic< std::size_t > m_budget;
+
+    ///
+    std::atomic< OverBudget > m_policy;
+
+    ///
+    bool m_process;
+};
+
+///Routes the allocations made on this thread to an accountant while alive
+class MemoryContext
+{
+public:
+    ///
+    explicit MemoryContext(
+        MemoryAccountant& accountant )
+        :
+        m_previous( MemoryAccountant::scoped() )
+    {
+        MemoryAccountant::scoped() = &accountant;
+    }
+
+    ///
+    MemoryContext( MemoryContext const& ) = delete;
+
+    ///
+    MemoryContext& operator =( MemoryContext const& ) = delete;
+
+    ///
+    ~MemoryContext()
+    {
+        MemoryAccountant::scoped() = m_previous;
+    }
+
+private:
+    ///
+    MemoryAccountant* m_previous;
+};
+
+namespace detail
+{
+
+///Alignment of band storage
+static constexpr std::size_t MemoryAlignment = 64;
+
+///Blocks at least this large may be backed by transparent huge pages
+static constexpr std::size_t HugePageSize = std::size_t( 1 ) << 21;
+
+///
+inline std::atomic< bool >& huge_pages_flag()
+{
+    static std::atomic< bool > flag( false );
+    return flag;
+}
+
+///
+inline int& default_init_depth()
+{
+    static thread_local int depth = 0;
+    return depth;
+}
+
+///Allocator::construct() default initializes on this thread while alive,
+///leaving trivial pixels unwritten
+class DefaultInit
+{
+public:
+    ///
+    DefaultInit()
+    {
+        ++default_init_depth();
+    }
+
+    ///
+    DefaultInit( DefaultInit const& ) = delete;
+
+    ///
+    DefaultInit& operator =( DefaultInit const& ) = delete;
+
+    ///
+    ~DefaultInit()
+    {
+        --default_init_depth();
+    }
+};
+
+///Bookkeeping stored in front of every block, one alignment unit long
+struct BlockHeader
+{
+    ///Who was charged for the block, nullptr for adopted mappings; must
+    ///outlive the block
+    MemoryAccountant* accountant;
+
+    ///Bytes requested
+    std::size_t bytes;
+
+    ///Length of the file mapping, 0 for heap blocks
+    std::size_t mapped;
+
+    ///Start of the file mapping
+    char* base;
+};
+
+static_assert( sizeof( BlockHeader ) <= MemoryAlignment,
+    "BlockHeader must fit in one alignment unit" );
+
+///
+inline void* aligned_malloc(
+    std::size_t bytes,
+    std::size_t alignment = MemoryAlignment )
+{
+#if defined( _WIN32 )
+    return _aligned_malloc( bytes, alignment );
+#else
+    void* p = nullptr;
+    return ( posix_memalign( &p, alignment, bytes ) == 0 ) ? p : nullptr;
+#endif
+}
+
+///Heap block of bytes; large blocks are huge page aligned and advised as
+///such when huge_pages() is on
+inline void* heap_allocate(
+    std::size_t bytes )
+{
+#if defined( MADV_HUGEPAGE )
+    if( huge_pages_flag().load( std::memory_order_relaxed ) && bytes >= HugePageSize )
+    {
+        void* const p = aligned_malloc( bytes, HugePageSize );
+        if( p ) madvise( p, bytes / HugePageSize * HugePageSize, MADV_HUGEPAGE );
+        return p;
+    }
+#endif
+    return aligned_malloc( bytes );
+}
+
+///
+inline void aligned_free(
+    void* p )
+{
+#if defined( _WIN32 )
+    _aligned_free( p );
+#else
+    std::free( p );
+#endif
+}
+
+///Maps an unlinked temporary file of length bytes, or returns nullptr
+inline void* map_spill_file(
+    std::size_t bytes )
+{
+#if defined( _WIN32 )
+    ( void )bytes;
+    return nullptr;
+#else
+    char const* dir = std::getenv( "TMPDIR" );
+    std::string path = std::string( dir ? dir : "/tmp" ) + "/gisraster-XXXXXX";
+    std::vector< char > name( path.begin(), path.end() );
+    name.push_back( '\0' );
+    int const fd = mkstemp( name.data() );
+    if( fd < 0 ) return nullptr;
+    unlink( name.data() );
+    void* p = MAP_FAILED;
+    if( ftruncate( fd, static_cast< off_t >( bytes ) ) == 0 )
+    {
+        p = mmap( nullptr, bytes, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0 );
+    }
+    close( fd );
+    return ( p == MAP_FAILED ) ? nullptr : p;
+#endif
+}
+
+///
+inline void unmap_spill_file(
+    void* p,
+    std::size_t bytes )
+{
+#if defined( _WIN32 )
+    ( void )p;
+    ( void )bytes;
+#else
+    munmap( p, bytes );
+#endif
+}
+
+///File mapped storage a loader hands to the next allocation on this thread
+///instead of allocating; data is preceded by a writable header slot
+struct Adoption
+{
+    ///
+    char* data;
+
+    ///
+    std::size_t bytes;
+
+    ///
+    char* base;
+
+    ///
+    std::size_t mapped;
+};
+
+///
+inline Adoption*& adoption()
+{
+    static thread_local Adoption* pending = nullptr;
+    return pending;
+}
+
+///Offers a mapping to the allocations made on this thread while alive;
+///elements are default initialized so the mapped pixels are kept. The
+///mapping is released here if no allocation took it.
+class AdoptionScope
+{
+public:
+    ///
+    explicit AdoptionScope(
+        Adoption adoption )
+        :
+        m_adoption( adoption ),
+        m_previous( detail::adoption() )
+    {
+        detail::adoption() = &m_adoption;
+    }
+
+    ///
+    AdoptionScope( AdoptionScope const& ) = delete;
+
+    ///
+    AdoptionScope& operator =( AdoptionScope const& ) = delete;
+
+    ///
+    ~AdoptionScope()
+    {
+        detail::adoption() = m_previous;
+        if( m_adoption.data ) unmap_spill_file( m_adoption.base, m_adoption.mapped );
+    }
+
+    ///True once an allocation took the mapping
+    bool adopted() const
+    {
+        return !m_adoption.data;
+    }
+
+private:
+    ///
+    Adoption m_adoption;
+
+    ///
+    Adoption* m_previous;
+};
+
+///Allocates bytes charged to the current accountant, 64 byte aligned
+inline void* tracked_allocate(
+    std::size_t bytes )
+{
+    Adoption* const pending = adoption();
+    if( pending && pending->data && pending->bytes == bytes )
+    {
+        //Mapped file pages are not charged: the kernel can drop them
+        char* const block = pending->data - MemoryAlignment;
+        ::new( block ) BlockHeader{
+            nullptr, bytes, pending->mapped, pending->base };
+        pending->data = nullptr;
+        return block + MemoryAlignment;
+    }
+
+    MemoryAccountant& accountant = MemoryAccountant::current();
+    std::size_t const total = bytes + MemoryAlignment;
+    char* block = nullptr;
+    std::size_t mapped = 0;
+    if( accountant.reserve( bytes ) )
+    {
+        block = static_cast< char* >( heap_allocate( total ) );
+        if( !block )
+        {
+            accountant.release( bytes );
+            throw std::bad_alloc();
+        }
+    }
+    else if( accountant.policy() == OverBudget::Spill &&
+        ( block = static_cast< char* >( map_spill_file( total ) ) ) )
+    {
+        mapped = total;
+        accountant.spill( bytes );
+    }
+    else
+    {
+        throw memory_budget_exceeded(
+            bytes, accountant.used(), accountant.budget() );
+    }
+    ::new( block ) BlockHeader{ &accountant, bytes, mapped, block };
+    accountant.m_blocks.fetch_add( 1 );
+    return block + MemoryAlignment;
+}
+
+///
+inline void tracked_deallocate(
+    void* p )
+{
+    if( !p ) return;
+    char* const block = static_cast< char* >( p ) - MemoryAlignment;
+    BlockHeader const header = *reinterpret_cast< BlockHeader* >( block );
+    if( header.accountant ) header.accountant->m_blocks.fetch_sub( 1 );
+    if( header.mapped )
+    {
+        if( header.accountant ) header.accountant->unspill( header.bytes );
+        unmap_spill_file( header.base, header.mapped );
+    }
+    else
+    {
+        header.accountant->release( header.bytes );
+        aligned_free( block );
+    }
+}
+
+} //end detail
+
+///Default Band allocator: 64 byte aligned storage charged to
+///MemoryAccountant::current()
+template< typename T >
+class Allocator
+{
+public:
+    ///
+    using value_type = T;
+    using is_always_equal = std::true_type;
+
+    ///
+    Allocator() = default;
+
+    ///
+    template< typename U >
+    Allocator(
+        Allocator< U > const& )
+    {
+        ;
+    }
+
+    ///
+    T* allocate(
+        std::size_t n )
+    {
+        if( n > std::numeric_limits< std::size_t >::max() / sizeof( T ) )
+        {
+            throw std::bad_alloc();
+        }
+        return static_cast< T* >( detail::tracked_allocate( n * sizeof( T ) ) );
+    }
+
+    ///
+    void deallocate(
+        T* p,
+        std::size_t )
+    {
+        detail::tracked_deallocate( p );
+    }
+
+    ///
+    template< typename U, typename... Args >
+    void construct(
+        U* p,
+        Args&&... args )
+    {
+        ::new( static_cast< void* >( p ) ) U( std::forward< Args >( args )... );
+    }
+
+    ///Value initializes, except inside a DefaultInit or AdoptionScope
+    template< typename U >
+    void construct(
+        U* p )
+    {
+        if( detail::default_init_depth() || detail::adoption() )
+        {
+            ::new( static_cast< void* >( p ) ) U;
+        }
+        else
+        {
+            ::new( static_cast< void* >( p ) ) U();
+        }
+    }
+};
+
+///
+template< typename T, typename U >
+bool operator ==(
+    Allocator< T > const&,
+    Allocator< U > const& )
+{
+    return true;
+}
+
+///
+template< typename T, typename U >
+bool operator !=(
+    Allocator< T > const&,
+    Allocator< U > const& )
+{
+    return false;
+}
+
+///Whether large band allocations are aligned to and advised as transparent
+///huge pages (Linux); off by default
+inline bool huge_pages()
+{
+    return detail::huge_pages_flag().load();
+}
+inline void huge_pages(
+    bool val )
+{
+    detail::huge_pages_flag().store( val );
+}
+
+///Scratch storage charged to the memory accountant
+template< typename T >
+using Buffer = std::vector< T, Allocator< T > >;
+
+} //end gis
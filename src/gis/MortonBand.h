@@ -0,0 +1,563 @@
+/*******************************************************************************
+ *
+ * MIT License
+ *
+ * Copyright (c) 2018 Joshua Koch
+ * 
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ * 
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ * 
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ *
+ ******************************************************************************/
+
+#pragma once
+
+#include <gis/Band.h>
+#include <gis/Parallel.h>
+#include <gis/Stats.h>
+
+#include <algorithm>
+#include <cstdint>
+#include <stdexcept>
+#include <type_traits>
+
+#if defined( __BMI2__ )
+#define GISRASTER_HAS_BMI2 1
+#include <immintrin.h>
+#endif
+
+namespace gis
+{
+
+namespace detail
+{
+
+///Spreads the low 32 bits of x to the even bits of the result
+inline std::uint64_t morton_spread(
+    std::uint64_t x )
+{
+    x &= 0x00000000FFFFFFFFull;
+    x = ( x | ( x << 16 ) ) & 0x0000FFFF0000FFFFull;
+    x = ( x | ( x << 8 ) ) & 0x00FF00FF00FF00FFull;
+    x = ( x | ( x << 4 ) ) & 0x0F0F0F0F0F0F0F0Full;
+    x = ( x | ( x << 2 ) ) & 0x3333333333333333ull;
+    x = ( x | ( x << 1 ) ) & 0x5555555555555555ull;
+    return x;
+}
+
+///Gathers the even bits of x into the low 32 bits of the result
+inline std::uint64_t morton_compact(
+    std::uint64_t x )
+{
+    x &= 0x5555555555555555ull;
+    x = ( x | ( x >> 1 ) ) & 0x3333333333333333ull;
+    x = ( x | ( x >> 2 ) ) & 0x0F0F0F0F0F0F0F0Full;
+    x = ( x | ( x >> 4 ) ) & 0x00FF00FF00FF00FFull;
+    x = ( x | ( x >> 8 ) ) & 0x0000FFFF0000FFFFull;
+    x = ( x | ( x >> 16 ) ) & 0x00000000FFFFFFFFull;
+    return x;
+}
+
+///Mask of the even bits below bit 2 * bits
+constexpr std::uint64_t dilated_mask(
+    int bits )
+{
+    std::uint64_t mask = 0;
+    for( int i = 0; i < bits; ++i ) mask |= std::uint64_t( 1 ) << ( 2 * i );
+    return mask;
+}
+
+} //end detail
+
+///Z-order code of ( r, c ): column bits on the even positions, row bits on
+///the odd ones
+inline std::uint64_t morton_encode(
+    std::uint32_t r,
+    std::uint32_t c )
+{
+#if defined( GISRASTER_HAS_BMI2 )
+    return _pdep_u64( c, 0x5555555555555555ull ) |
+        _pdep_u64( r, 0xAAAAAAAAAAAAAAAAull );
+#else
+    return detail::morton_spread( c ) | ( detail::morton_spread( r ) << 1 );
+#endif
+}
+
+///Row and column of a Z-order code
+inline std::pair< std::uint32_t, std::uint32_t > morton_decode(
+    std::uint64_t z )
+{
+#if defined( GISRASTER_HAS_BMI2 )
+    return { static_cast< std::uint32_t >( _pext_u64( z, 0xAAAAAAAAAAAAAAAAull ) ),
+        static_cast< std::uint32_t >( _pext_u64( z, 0x5555555555555555ull ) ) };
+#else
+    return { static_cast< std::uint32_t >( detail::morton_compact( z >> 1 ) ),
+        static_cast< std::uint32_t >( detail::morton_compact( z ) ) };
+#endif
+}
+
+///Band stored in Z-order so that pixels close in either direction are close
+///in memory. The band is cut into BlockSize square blocks, laid out
+///row-major and each stored in Z-order; the band is padded to whole blocks
+///only, and padding pixels hold nodata.
+template< typename T >
+class MortonBand
+{
+public:
+    ///
+    using Data = Buffer< T >;
+
+    ///Blocks are BlockSize pixels on a side (a 4 KiB page of floats), so
+    ///padding stays under one block per row and column of blocks
+    static constexpr int BlockShift = 5;
+    static constexpr int BlockSize = 1 << BlockShift;
+
+    ///Storage position that steps to a neighbouring pixel with dilated
+    ///integer arithmetic instead of encoding ( r, c ) again; stepping off
+    ///the band is not checked
+    class Cursor
+    {
+    public:
+        ///In-block column bits (even) and row bits (odd) of a position
+        static constexpr std::size_t ColBits = detail::dilated_mask( BlockShift );
+        static constexpr std::size_t RowBits = ColBits << 1;
+
+        ///
+        Cursor(
+            std::size_t block,
+            std::size_t row,
+            std::size_t col,
+            std::size_t across )
+            :
+            m_block( block ),
+            m_row( row ),
+            m_col( col ),
+            m_across( across )
+        {
+            ;
+        }
+
+        ///
+        std::size_t index() const
+        {
+            return ( m_block << ( 2 * BlockShift ) ) | m_row | m_col;
+        }
+
+        ///
+        void right()
+        {
+            m_col = ( m_col - ColBits ) & ColBits;
+            m_block += ( m_col == 0 );
+        }
+
+        ///
+        void left()
+        {
+            m_block -= ( m_col == 0 );
+            m_col = ( m_col - 1 ) & ColBits;
+        }
+
+        ///
+        void down()
+        {
+            m_row = ( m_row - RowBits ) & RowBits;
+            m_block += ( m_row == 0 ) ? m_across : 0;
+        }
+
+        ///
+        void up()
+        {
+            m_block -= ( m_row == 0 ) ? m_across : 0;
+            m_row = ( m_row - 2 ) & RowBits;
+        }
+
+    private:
+        ///
+        std::size_t m_block;
+
+        ///
+        std::size_t m_row;
+
+        ///
+        std::size_t m_col;
+
+        ///Blocks per block row
+        std::size_t m_across;
+    };
+
+    ///constructor
+    template< typename N, typename V >
+    MortonBand(
+        int width,
+        int height,
+        N nodataval,
+        V initval )
+        :
+        m_upperleftx( 0.0 ),
+        m_upperlefty( 0.0 ),
+        m_width( width ),
+        m_height( height ),
+        m_srid( 0 ),
+        m_scalex( 0.0 ),
+        m_scaley( 0.0 ),
+        m_nodatavalue( Band< T >::cast( nodataval ) ),
+        m_across( blocks( width ) ),
+        m_data( storage( width, height ), m_nodatavalue )
+    {
+        static_assert( std::is_arithmetic< N >::value,
+            "Nodata value must be an arithmetic type" );
+        static_assert( std::is_arithmetic< V >::value,
+            "Initial value must be an arithmetic type" );
+        T const v = Band< T >::cast( initval );
+        for( int r = 0; r < m_height; ++r )
+        {
+            for( int c = 0; c < m_width; ++c ) m_data[ index( r, c ) ] = v;
+        }
+    }
+
+    ///constructor
+    template< typename N >
+    MortonBand(
+        int width,
+        int height,
+        N nodataval )
+        :
+        MortonBand( width, height, nodataval, nodataval )
+    {
+        ;
+    }
+
+    ///constructor
+    MortonBand()
+        :
+        MortonBand( 0, 0, Band< T >::Lowest )
+    {
+        ;
+    }
+
+    ///Z-order copy of a row-major band
+    explicit MortonBand(
+        Band< T > const& o )
+        :
+        m_upperleftx( o.upperleftx() ),
+        m_upperlefty( o.upperlefty() ),
+        m_width( o.width() ),
+        m_height( o.height() ),
+        m_srid( o.srid() ),
+        m_scalex( o.scalex() ),
+        m_scaley( o.scaley() ),
+        m_nodatavalue( o.nodatavalue() ),
+        m_across( blocks( o.width() ) ),
+        m_data( storage( o.width(), o.height() ), o.nodatavalue() )
+    {
+        GISRASTER_TRACE_SCOPE( "MortonBand::convert", o.size(), bytes() );
+        T const* src = o.data();
+        T* dst = m_data.data();
+        parallel_for( 0, m_height,
+            [ & ]( int begin, int end )
+            {
+                for( int r = begin; r < end; ++r )
+                {
+                    T const* row = src + static_cast< std::size_t >( r ) * m_width;
+                    Cursor at = cursor( r, 0 );
+                    for( int c = 0; c < m_width; ++c, at.right() )
+                    {
+                        dst[ at.index() ] = row[ c ];
+                    }
+                }
+            }, BlockSize );
+    }
+
+    ///
+    bool oor(
+        int r,
+        int c ) const
+    {
+        return !( r >= 0 && r < m_height && c >= 0 && c < m_width );
+    }
+
+    ///Storage position of ( r, c ), unchecked
+    std::size_t index(
+        int r,
+        int c ) const
+    {
+        std::uint32_t const mask = BlockSize - 1;
+        std::size_t const block = static_cast< std::size_t >( r >> BlockShift ) *
+            m_across + static_cast< std::size_t >( c >> BlockShift );
+        return ( block << ( 2 * BlockShift ) ) | static_cast< std::size_t >(
+            morton_encode( static_cast< std::uint32_t >( r ) & mask,
+                static_cast< std::uint32_t >( c ) & mask ) );
+    }
+
+    ///Cursor at ( r, c ), unchecked
+    Cursor cursor(
+        int r,
+        int c ) const
+    {
+        std::uint32_t const mask = BlockSize - 1;
+        std::uint32_t const rr = static_cast< std::uint32_t >( r ) & mask;
+        std::uint32_t const cc = static_cast< std::uint32_t >( c ) & mask;
+        return Cursor( static_cast< std::size_t >( r >> BlockShift ) * m_across +
+            static_cast< std::size_t >( c >> BlockShift ),
+            static_cast< std::size_t >( morton_encode( rr, 0 ) ),
+            static_cast< std::size_t >( morton_encode( 0, cc ) ),
+            static_cast< std::size_t >( m_across ) );
+    }
+
+    ///
+    T& operator ()(
+        int r,
+        int c )
+    {
+        if( oor( r, c ) ) throw std::out_of_range(
+            "MortonBand::operator(): out of range" );
+        return m_data[ index( r, c ) ];
+    }
+
+    ///
+    T const& operator ()(
+        int r,
+        int c ) const
+    {
+        if( oor( r, c ) ) throw std::out_of_range(
+            "MortonBand::operator(): out of range" );
+        return m_data[ index( r, c ) ];
+    }
+
+    ///Writes the pixels to out in row-major order
+    void unpack(
+        T* out ) const
+    {
+        GISRASTER_TRACE_SCOPE( "MortonBand::unpack", size(), size() * sizeof( T ) );
+        T const* src = m_data.data();
+        parallel_for( 0, m_height,
+            [ & ]( int begin, int end )
+            {
+                for( int r = begin; r < end; ++r )
+                {
+                    T* row = out + static_cast< std::size_t >( r ) * m_width;
+                    Cursor at = cursor( r, 0 );
+                    for( int c = 0; c < m_width; ++c, at.right() )
+                    {
+                        row[ c ] = src[ at.index() ];
+                    }
+                }
+            }, BlockSize );
+    }
+
+    ///Copies rows [ r0, r0 + rows ) and columns [ c0, c0 + cols ) to out,
+    ///row-major; pixels off the band read as nodata. Lets window kernels
+    ///run row-major over a block and its halo.
+    void read(
+        int r0,
+        int c0,
+        int rows,
+        int cols,
+        T* out ) const
+    {
+        T const* src = m_data.data();
+        int const cbegin = std::max( c0, 0 );
+        int const cend = std::max( cbegin, std::min( c0 + cols, m_width ) );
+        for( int r = r0; r < r0 + rows; ++r )
+        {
+            T* row = out + static_cast< std::size_t >( r - r0 ) * cols;
+            if( r < 0 || r >= m_height )
+            {
+                std::fill( row, row + cols, m_nodatavalue );
+                continue;
+            }
+            std::fill( row, row + ( cbegin - c0 ), m_nodatavalue );
+            Cursor at = cursor( r, cbegin );
+            for( int c = cbegin; c < cend; ++c, at.right() )
+            {
+                row[ c - c0 ] = src[ at.index() ];
+            }
+            std::fill( row + ( cend - c0 ), row + cols, m_nodatavalue );
+        }
+    }
+
+    ///Number of pixels
+    std::size_t size() const
+    {
+        return static_cast< std::size_t >( m_width ) * m_height;
+    }
+
+    ///Bytes held, padding included
+    std::size_t bytes() const
+    {
+        return m_data.size() * sizeof( T );
+    }
+
+    ///Z-ordered storage, padding included
+    T const* data() const
+    {
+        return m_data.data();
+    }
+
+    ///Side of the Z-ordered blocks
+    int block_size() const
+    {
+        return BlockSize;
+    }
+
+    ///
+    double upperleftx() const
+    {
+        return m_upperleftx;
+    }
+    void upperleftx(
+        double val )
+    {
+        m_upperleftx = val;
+    }
+
+    ///
+    double upperlefty() const
+    {
+        return m_upperlefty;
+    }
+    void upperlefty(
+        double val )
+    {
+        m_upperlefty = val;
+    }
+
+    ///
+    int width() const
+    {
+        return m_width;
+    }
+
+    ///
+    int height() const
+    {
+        return m_height;
+    }
+
+    ///
+    int srid() const
+    {
+        return m_srid;
+    }
+    void srid(
+        int val )
+    {
+        m_srid = val;
+    }
+
+    ///
+    double scalex() const
+    {
+        return m_scalex;
+    }
+    void scalex(
+        double val )
+    {
+        m_scalex = val;
+    }
+
+    ///
+    double scaley() const
+    {
+        return ( m_scaley > 0 ) ? m_scaley * -1.0 : m_scaley;
+    }
+    void scaley(
+        double val )
+    {
+        m_scaley = ( val > 0 ) ? val * -1.0 : val;
+    }
+
+    ///
+    T nodatavalue() const
+    {
+        return m_nodatavalue;
+    }
+
+    ///Count, extremes and sum of the valid pixels; padding is nodata
+    Summary< T > summary() const
+    {
+        Summary< T > result;
+        detail::Reduce< T >::summarize(
+            m_data.data(), m_data.size(), m_nodatavalue, result );
+        return result;
+    }
+
+private:
+    ///
+    static int blocks(
+        int length )
+    {
+        return ( length + BlockSize - 1 ) >> BlockShift;
+    }
+
+    ///
+    static std::size_t storage(
+        int width,
+        int height )
+    {
+        return static_cast< std::size_t >( blocks( width ) ) *
+            blocks( height ) << ( 2 * BlockShift );
+    }
+
+    ///
+    double m_upperleftx;
+
+    ///
+    double m_upperlefty;
+
+    ///
+    int m_width;
+
+    ///
+    int m_height;
+
+    ///
+    int m_srid;
+
+    ///
+    double m_scalex;
+
+    ///
+    double m_scaley;
+
+    ///
+    T m_nodatavalue;
+
+    ///Blocks per block row
+    int m_across;
+
+    ///
+    Data m_data;
+};
+
+///
+template< typename T >
+constexpr int MortonBand< T >::BlockShift;
+
+///
+template< typename T >
+constexpr int MortonBand< T >::BlockSize;
+
+///
+template< typename T >
+constexpr std::size_t MortonBand< T >::Cursor::ColBits;
+
+///
+template< typename T >
+constexpr std::size_t MortonBand< T >::Cursor::RowBits;
+
+} //end gis
@@ -0,0 +1,409 @@
+/*******************************************************************************
+ *
+ * MIT License
+ *
+ * Copyright (c) 2018 Joshua Koch
+ * 
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ * 
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ * 
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ *
+ ******************************************************************************/
+
+#pragma once
+
+#include <gis/Memory.h>
+#include <gis/Parallel.h>
+#include <gis/Stats.h>
+
+#include <algorithm>
+#include <cstdint>
+#include <limits>
+#include <stdexcept>
+#include <type_traits>
+
+namespace gis
+{
+
+///How a Band knows that a pixel is missing; chosen at compile time so the
+///statistics and arithmetic loops carry only the test the policy needs
+namespace nodata
+{
+
+///Pixels equal to the nodata value are missing (the default)
+struct Sentinel
+{
+};
+
+///No pixel is missing; loops test nothing
+struct None
+{
+};
+
+///NaN pixels are missing and the nodata value is NaN; floating point only
+struct NaN
+{
+};
+
+///A byte per pixel says whether it is valid
+struct Mask
+{
+};
+
+} //end nodata
+
+namespace detail
+{
+
+///Per pixel validity tests, called with the value and its index
+template< typename T >
+struct NotEqual
+{
+    T nodata;
+
+    template< typename V >
+    bool operator ()(
+        V v,
+        std::size_t ) const
+    {
+        return v != nodata;
+    }
+};
+
+///
+struct Always
+{
+    template< typename V >
+    bool operator ()(
+        V,
+        std::size_t ) const
+    {
+        return true;
+    }
+};
+
+///
+struct NotNaN
+{
+    template< typename V >
+    bool operator ()(
+        V v,
+        std::size_t ) const
+    {
+        return v == v;
+    }
+};
+
+///
+struct MaskSet
+{
+    std::uint8_t const* mask;
+
+    template< typename V >
+    bool operator ()(
+        V,
+        std::size_t i ) const
+    {
+        return mask[ i ] != 0;
+    }
+};
+
+///Validity state a Band keeps for policy P. seed() marks the pixels equal
+///to sentinel missing after the pixels were set in bulk (data is nullptr
+///when they were left unwritten) and returns the band's nodata value;
+///test() returns the per pixel test for pixels from offset on.
+template< typename T, typename P >
+class Validity;
+
+///
+template< typename T >
+class Validity< T, nodata::Sentinel >
+{
+public:
+    ///
+    T seed(
+        T*,
+        std::size_t,
+        T sentinel )
+    {
+        return sentinel;
+    }
+
+    ///
+    NotEqual< T > test(
+        T nodata,
+        std::size_t ) const
+    {
+        return NotEqual< T >{ nodata };
+    }
+
+    ///
+    void summarize(
+        T const* p,
+        std::size_t n,
+        T nodata,
+        std::size_t,
+        Summary< T >& s ) const
+    {
+        Reduce< T >::summarize( p, n, nodata, s );
+    }
+
+    ///
+    void transpose(
+        int,
+        int )
+    {
+        ;
+    }
+
+    ///
+    void insert(
+        std::size_t,
+        bool )
+    {
+        ;
+    }
+};
+
+///
+template< typename T >
+class Validity< T, nodata::None >
+{
+public:
+    ///
+    T seed(
+        T*,
+        std::size_t,
+        T sentinel )
+    {
+        return sentinel;
+    }
+
+    ///
+    Always test(
+        T,
+        std::size_t ) const
+    {
+        return Always{};
+    }
+
+    ///Plain min, max and sum
+    void summarize(
+        T const* p,
+        std::size_t n,
+        T,
+        std::size_t,
+        Summary< T >& s ) const
+    {
+        Reduce< T >::summarize_if( p, n, Always{}, s );
+    }
+
+    ///
+    void transpose(
+        int,
+        int )
+    {
+        ;
+    }
+
+    ///
+    void insert(
+        std::size_t,
+        bool )
+    {
+        ;
+    }
+};
+
+///
+template< typename T >
+class Validity< T, nodata::NaN >
+{
+public:
+    static_assert( std::numeric_limits< T >::has_quiet_NaN,
+        "nodata::NaN needs a floating point pixel type" );
+
+    ///Turns sentinel pixels into NaN
+    T seed(
+        T* data,
+        std::size_t n,
+        T sentinel )
+    {
+        T const nan = std::numeric_limits< T >::quiet_NaN();
+        if( data && sentinel == sentinel )
+        {
+            parallel_for( 0, static_cast< int >( ( n + Chunk - 1 ) / Chunk ),
+                [ & ]( int begin, int end )
+                {
+                    std::size_t const e = std::min( n, std::size_t( end ) * Chunk );
+                    for( std::size_t i = std::size_t( begin ) * Chunk; i < e; ++i )
+                    {
+                        data[ i ] = ( data[ i ] == sentinel ) ? nan : data[ i ];
+                    }
+                } );
+        }
+        return nan;
+    }
+
+    ///
+    NotNaN test(
+        T,
+        std::size_t ) const
+    {
+        return NotNaN{};
+    }
+
+    ///
+    void summarize(
+        T const* p,
+        std::size_t n,
+        T,
+        std::size_t,
+        Summary< T >& s ) const
+    {
+        Reduce< T >::summarize_if( p, n, NotNaN{}, s );
+    }
+
+    ///
+    void transpose(
+        int,
+        int )
+    {
+        ;
+    }
+
+    ///
+    void insert(
+        std::size_t,
+        bool )
+    {
+        ;
+    }
+
+private:
+    ///
+    static constexpr std::size_t Chunk = std::size_t( 1 ) << 16;
+};
+
+///
+template< typename T >
+class Validity< T, nodata::Mask >
+{
+public:
+    ///
+    T seed(
+        T* data,
+        std::size_t n,
+        T sentinel )
+    {
+        m_mask.resize( n );
+        std::uint8_t* mask = m_mask.data();
+        parallel_for( 0, static_cast< int >( ( n + Chunk - 1 ) / Chunk ),
+            [ & ]( int begin, int end )
+            {
+                std::size_t const e = std::min( n, std::size_t( end ) * Chunk );
+                for( std::size_t i = std::size_t( begin ) * Chunk; i < e; ++i )
+                {
+                    mask[ i ] = data ? ( data[ i ] != sentinel ) : 1;
+                }
+            } );
+        return sentinel;
+    }
+
+    ///
+    MaskSet test(
+        T,
+        std::size_t offset ) const
+    {
+        return MaskSet{ m_mask.data() + offset };
+    }
+
+    ///
+    void summarize(
+        T const* p,
+        std::size_t n,
+        T,
+        std::size_t offset,
+        Summary< T >& s ) const
+    {
+        Reduce< T >::summarize_if( p, n, MaskSet{ m_mask.data() + offset }, s );
+    }
+
+    ///
+    void set(
+        std::size_t i,
+        bool valid )
+    {
+        m_mask[ i ] = valid;
+    }
+
+    ///
+    std::uint8_t const* mask() const
+    {
+        return m_mask.data();
+    }
+
+    ///
+    std::uint8_t* mask()
+    {
+        return m_mask.data();
+    }
+
+    ///Mask of a width x height band, transposed
+    void transpose(
+        int width,
+        int height )
+    {
+        Buffer< std::uint8_t > result( m_mask.size() );
+        for( int r = 0; r < height; ++r )
+        {
+            for( int c = 0; c < width; ++c )
+            {
+                result[ static_cast< std::size_t >( c ) * height + r ] =
+                    m_mask[ static_cast< std::size_t >( r ) * width + c ];
+            }
+        }
+        m_mask = std::move( result );
+    }
+
+    ///
+    void insert(
+        std::size_t i,
+        bool valid )
+    {
+        m_mask.insert( m_mask.begin() + i, valid );
+    }
+
+private:
+    ///
+    static constexpr std::size_t Chunk = std::size_t( 1 ) << 16;
+
+    ///
+    Buffer< std::uint8_t > m_mask;
+};
+
+///
+template< typename T >
+constexpr std::size_t Validity< T, nodata::NaN >::Chunk;
+
+///
+template< typename T >
+constexpr std::size_t Validity< T, nodata::Mask >::Chunk;
+
+} //end detail
+
+} //end gis
@@ -0,0 +1,594 @@
+/*******************************************************************************
+ *
+ * MIT License
+ *
+ * Copyright (c) 2018 Joshua Koch
+ * 
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ * 
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ * 
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ *
+ ******************************************************************************/
+
+#pragma once
+
+#include <gis/Band.h>
+
+#include <array>
+#include <cmath>
+#include <cstdint>
+#include <stdexcept>
+#include <string>
+#include <type_traits>
+
+namespace gis
+{
+
+namespace detail
+{
+
+///
+inline unsigned popcount(
+    std::uint64_t x )
+{
+#if defined( __GNUC__ ) || defined( __clang__ )
+    return static_cast< unsigned >( __builtin_popcountll( x ) );
+#else
+    x = x - ( ( x >> 1 ) & 0x5555555555555555ull );
+    x = ( x & 0x3333333333333333ull ) + ( ( x >> 2 ) & 0x3333333333333333ull );
+    x = ( x + ( x >> 4 ) ) & 0x0F0F0F0F0F0F0F0Full;
+    return static_cast< unsigned >( ( x * 0x0101010101010101ull ) >> 56 );
+#endif
+}
+
+///Word with the lowest bit of every Bits wide lane set
+template< unsigned Bits >
+constexpr std::uint64_t lane_ones()
+{
+    return ( Bits == 1 ) ? ~0ull :
+        ( Bits == 2 ) ? 0x5555555555555555ull : 0x1111111111111111ull;
+}
+
+///Lowest bit of every lane of x that equals v, all other bits clear
+template< unsigned Bits >
+std::uint64_t lanes_equal(
+    std::uint64_t x,
+    unsigned v )
+{
+    std::uint64_t t = ~( x ^ ( lane_ones< Bits >() * v ) );
+    for( unsigned s = 1; s < Bits; s <<= 1 ) t &= ( t >> s );
+    return t & lane_ones< Bits >();
+}
+
+} //end detail
+
+///Band of 1, 2 or 4 bit unsigned pixels packed into 64 bit words
+template< unsigned Bits >
+class PackedBand
+{
+    static_assert( Bits == 1 || Bits == 2 || Bits == 4,
+        "PackedBand supports 1, 2 and 4 bit pixels" );
+
+public:
+    ///
+    using Word = std::uint64_t;
+    using Data = Buffer< Word >;
+
+    ///Pixels per word
+    static constexpr unsigned PerWord = 64 / Bits;
+
+    ///Number of distinct pixel values
+    static constexpr unsigned Values = 1u << Bits;
+
+    ///
+    static constexpr std::uint8_t Lowest = 0;
+    static constexpr std::uint8_t Max = Values - 1;
+
+    ///Proxy for a single packed pixel
+    class Reference
+    {
+    public:
+        ///
+        Reference(
+            Word& word,
+            unsigned shift )
+            :
+            m_word( word ),
+            m_shift( shift )
+        {
+            ;
+        }
+
+        ///
+        operator std::uint8_t() const
+        {
+            return static_cast< std::uint8_t >( ( m_word >> m_shift ) & Max );
+        }
+
+        ///
+        template< typename U >
+        Reference& operator =(
+            U val )
+        {
+            Word const v = limits( val );
+            m_word = ( m_word & ~( Word( Max ) << m_shift ) ) | ( v << m_shift );
+            return *this;
+        }
+
+        ///
+        Reference& operator =(
+            Reference const& o )
+        {
+            return operator =( static_cast< std::uint8_t >( o ) );
+        }
+
+    private:
+        ///
+        Word& m_word;
+
+        ///
+        unsigned m_shift;
+    };
+
+    ///constructor
+    template< typename N, typename V >
+    PackedBand(
+        int width,
+        int height,
+        N nodataval,
+        V initval )
+        :
+        m_upperleftx( 0.0 ),
+        m_upperlefty( 0.0 ),
+        m_width( width ),
+        m_height( height ),
+        m_srid( 0 ),
+        m_scalex( 0.0 ),
+        m_scaley( 0.0 ),
+        m_nodatavalue( limits( nodataval ) ),
+        m_data( words( static_cast< std::size_t >( width ) * height ),
+            detail::lane_ones< Bits >() * limits( initval ) )
+    {
+        static_assert( std::is_arithmetic< N >::value,
+            "Nodata value must be an arithmetic type" );
+        static_assert( std::is_arithmetic< V >::value,
+            "Initial value must be an arithmetic type" );
+    }
+
+    ///constructor
+    template< typename N >
+    PackedBand(
+        int width,
+        int height,
+        N nodataval )
+        :
+        PackedBand( width, height, nodataval, nodataval )
+    {
+        ;
+    }
+
+    ///constructor
+    PackedBand(
+        int width,
+        int height )
+        :
+        PackedBand( width, height, Max )
+    {
+        ;
+    }
+
+    ///constructor
+    PackedBand()
+        :
+        PackedBand( 0, 0 )
+    {
+        ;
+    }
+
+    ///packing constructor; the source nodata value is kept and must fit in
+    ///Bits, otherwise std::invalid_argument is thrown
+    template< typename T >
+    explicit PackedBand(
+        Band< T > const& o,
+        bool clamp = false )
+        :
+        PackedBand( o, packable_nodata( o.nodatavalue() ), clamp )
+    {
+        ;
+    }
+
+    ///packing constructor; nodata pixels of o become nodataval, which
+    ///clamped pixels may collide with
+    template< typename T, typename N, typename =
+        typename std::enable_if< std::is_arithmetic< N >::value &&
+            !std::is_same< N, bool >::value >::type >
+    PackedBand(
+        Band< T > const& o,
+        N nodataval,
+        bool clamp = false )
+        :
+        m_upperleftx( o.upperleftx() ),
+        m_upperlefty( o.upperlefty() ),
+        m_width( o.width() ),
+        m_height( o.height() ),
+        m_srid( o.srid() ),
+        m_scalex( o.scalex() ),
+        m_scaley( o.scaley() ),
+        m_nodatavalue( limits( nodataval ) ),
+        m_data( words( o.size() ), 0 )
+    {
+        T const* const src = o.data();
+        T const nodata = o.nodatavalue();
+        std::size_t const n = o.size();
+        for( std::size_t w = 0; w < m_data.size(); ++w )
+        {
+            Word word = 0;
+            std::size_t const base = w * PerWord;
+            unsigned const lanes = static_cast< unsigned >(
+                std::min< std::size_t >( PerWord, n - base ) );
+            for( unsigned l = 0; l < lanes; ++l )
+            {
+                T const v = src[ base + l ];
+                Word const p = ( v == nodata ) ?
+                    m_nodatavalue : limits( v, clamp );
+                word |= p << ( l * Bits );
+            }
+            m_data[ w ] = word;
+        }
+    }
+
+    ///
+    bool oor_r(
+        int r ) const
+    {
+        return !( r >= 0 && r < m_height );
+    }
+
+    ///
+    bool oor_c(
+        int c ) const
+    {
+        return !( c >= 0 && c < m_width );
+    }
+
+    ///
+    bool oor(
+        int r,
+        int c ) const
+    {
+        return oor_r( r ) || oor_c( c );
+    }
+
+    ///
+    std::size_t idx(
+        int r,
+        int c ) const
+    {
+        if( oor( r, c ) ) throw std::out_of_range(
+            "PackedBand::idx: out of range" );
+        return ( static_cast< std::size_t >( r ) * m_width + c );
+    }
+
+    ///
+    Reference operator ()(
+        int r,
+        int c )
+    {
+        return at( idx( r, c ) );
+    }
+
+    ///
+    std::uint8_t operator ()(
+        int r,
+        int c ) const
+    {
+        return at( idx( r, c ) );
+    }
+
+    ///
+    Reference at(
+        std::size_t i )
+    {
+        if( i >= size() ) throw std::out_of_range(
+            "PackedBand::at: out of range" );
+        return Reference( m_data[ i / PerWord ],
+            static_cast< unsigned >( ( i % PerWord ) * Bits ) );
+    }
+
+    ///
+    std::uint8_t at(
+        std::size_t i ) const
+    {
+        if( i >= size() ) throw std::out_of_range(
+            "PackedBand::at: out of range" );
+        return static_cast< std::uint8_t >(
+            ( m_data[ i / PerWord ] >> ( ( i % PerWord ) * Bits ) ) & Max );
+    }
+
+    ///
+    template< typename U >
+    void set_at(
+        std::size_t i,
+        U val )
+    {
+        at( i ) = val;
+    }
+
+    ///Number of pixels
+    std::size_t size() const
+    {
+        return static_cast< std::size_t >( m_width ) * m_height;
+    }
+
+    ///Packed words
+    Word const* data() const
+    {
+        return m_data.data();
+    }
+
+    ///
+    std::size_t bytes() const
+    {
+        return m_data.size() * sizeof( Word );
+    }
+
+    ///
+    double upperleftx() const
+    {
+        return m_upperleftx;
+    }
+    void upperleftx(
+        double val )
+    {
+        m_upperleftx = val;
+    }
+
+    ///
+    double upperlefty() const
+    {
+        return m_upperlefty;
+    }
+    void upperlefty(
+        double val )
+    {
+        m_upperlefty = val;
+    }
+
+    ///
+    int width() const
+    {
+        return m_width;
+    }
+
+    ///
+    int height() const
+    {
+        return m_height;
+    }
+
+    ///
+    int srid() const
+    {
+        return m_srid;
+    }
+    void srid(
+        int val )
+    {
+        m_srid = val;
+    }
+
+    ///
+    double scalex() const
+    {
+        return m_scalex;
+    }
+    void scalex(
+        double val )
+    {
+        m_scalex = val;
+    }
+
+    ///
+    double scaley() const
+    {
+        return ( m_scaley > 0 ) ? m_scaley * -1.0 : m_scaley;
+    }
+    void scaley(
+        double val )
+    {
+        m_scaley = ( val > 0 ) ? val * -1.0 : val;
+    }
+
+    ///
+    std::uint8_t nodatavalue() const
+    {
+        return m_nodatavalue;
+    }
+    template< typename N >
+    void nodatavalue(
+        N nodataval )
+    {
+        static_assert( std::is_arithmetic< N >::value,
+            "Nodata value must be an arithmetic type" );
+        m_nodatavalue = limits( nodataval );
+    }
+
+    ///Number of pixels holding each value, counted a word at a time
+    std::array< std::size_t, Values > histogram() const
+    {
+        std::array< std::size_t, Values > result{};
+        std::size_t const n = size();
+        std::size_t const full = n / PerWord;
+        for( std::size_t w = 0; w < full; ++w )
+        {
+            Word const x = m_data[ w ];
+            for( unsigned v = 0; v < Values; ++v )
+            {
+                result[ v ] += detail::popcount( detail::lanes_equal< Bits >( x, v ) );
+            }
+        }
+        if( full < m_data.size() )
+        {
+            //Only count the lanes in use in the last word
+            Word const tail =
+                ( Word( 1 ) << ( ( n - full * PerWord ) * Bits ) ) - 1;
+            Word const x = m_data[ full ];
+            for( unsigned v = 0; v < Values; ++v )
+            {
+                result[ v ] += detail::popcount(
+                    detail::lanes_equal< Bits >( x, v ) & tail );
+            }
+        }
+        return result;
+    }
+
+    ///
+    std::size_t count() const
+    {
+        return size() - histogram()[ m_nodatavalue ];
+    }
+
+    ///
+    std::uint8_t min() const
+    {
+        auto const h = histogram();
+        for( unsigned v = 0; v < Values; ++v )
+        {
+            if( v != m_nodatavalue && h[ v ] != 0 )
+            {
+                return static_cast< std::uint8_t >( v );
+            }
+        }
+        return m_nodatavalue;
+    }
+
+    ///
+    std::uint8_t max() const
+    {
+        auto const h = histogram();
+        for( unsigned v = Values; v-- > 0; )
+        {
+            if( v != m_nodatavalue && h[ v ] != 0 )
+            {
+                return static_cast< std::uint8_t >( v );
+            }
+        }
+        return m_nodatavalue;
+    }
+
+    ///
+    std::size_t sum() const
+    {
+        auto const h = histogram();
+        std::size_t result = 0;
+        for( unsigned v = 0; v < Values; ++v )
+        {
+            if( v != m_nodatavalue ) result += v * h[ v ];
+        }
+        return result;
+    }
+
+    ///
+    double avg() const
+    {
+        return sum() / static_cast< double >( count() );
+    }
+
+    ///Writes every pixel to out, a word at a time
+    template< typename T >
+    void unpack(
+        T* out ) const
+    {
+        std::size_t const n = size();
+        for( std::size_t w = 0; w < m_data.size(); ++w )
+        {
+            Word x = m_data[ w ];
+            std::size_t const base = w * PerWord;
+            unsigned const lanes = static_cast< unsigned >(
+                std::min< std::size_t >( PerWord, n - base ) );
+            for( unsigned l = 0; l < lanes; ++l, x >>= Bits )
+            {
+                out[ base + l ] = static_cast< T >( x & Max );
+            }
+        }
+    }
+
+private:
+    ///
+    static std::size_t words(
+        std::size_t n )
+    {
+        return ( n + PerWord - 1 ) / PerWord;
+    }
+
+    ///
+    template< typename U >
+    static std::uint8_t limits(
+        U val,
+        bool clamp = false )
+    {
+        std::uint8_t const v = Band< std::uint8_t >::cast( val, clamp );
+        if( v <= Max ) return v;
+        if( clamp ) return Max;
+        throw std::out_of_range(
+            "PackedBand::limits: value too large " + std::to_string( val ) );
+    }
+
+    ///Source nodata value as a packed value, if it is one exactly
+    template< typename U >
+    static std::uint8_t packable_nodata(
+        U val )
+    {
+        double const d = static_cast< double >( val );
+        if( !( d >= 0.0 && d <= Max && d == std::floor( d ) ) )
+        {
+            throw std::invalid_argument( "PackedBand: nodata value " +
+                std::to_string( d ) + " does not fit in " +
+                std::to_string( Bits ) + " bits; pass a packed nodata value" );
+        }
+        return static_cast< std::uint8_t >( d );
+    }
+
+    ///
+    double m_upperleftx;
+
+    ///
+    double m_upperlefty;
+
+    ///
+    int m_width;
+
+    ///
+    int m_height;
+
+    ///
+    int m_srid;
+
+    ///
+    double m_scalex;
+
+    ///
+    double m_scaley;
+
+    ///
+    std::uint8_t m_nodatavalue;
+
+    ///
+    Data m_data;
+};
+
+} //end gis
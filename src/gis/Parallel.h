@@ -0,0 +1,120 @@
+/*******************************************************************************
+ *
+ * MIT License
+ *
+ * Copyright (c) 2018 Joshua Koch
+ * 
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ * 
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ * 
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ *
+ ******************************************************************************/
+
+#pragma once
+
+#include <gis/Trace.h>
+
+#include <algorithm>
+#include <atomic>
+#include <exception>
+#include <thread>
+#include <vector>
+
+namespace gis
+{
+
+namespace detail
+{
+
+///
+inline std::atomic< unsigned >& thread_count_override()
+{
+    static std::atomic< unsigned > count( 0 );
+    return count;
+}
+
+} //end detail
+
+///Number of threads used by the parallel kernels
+inline unsigned thread_count()
+{
+    unsigned const count = detail::thread_count_override().load();
+    if( count != 0 ) return count;
+    unsigned const hw = std::thread::hardware_concurrency();
+    return ( hw != 0 ) ? hw : 1;
+}
+
+///Overrides the number of threads used by the parallel kernels (0 = auto)
+inline void thread_count(
+    unsigned count )
+{
+    detail::thread_count_override().store( count );
+}
+
+///Splits [begin, end) into contiguous chunks of at least grain items and
+///calls fn( chunkbegin, chunkend ) for each chunk on its own thread
+template< typename F >
+void parallel_for(
+    int begin,
+    int end,
+    F&& fn,
+    int grain = 1 )
+{
+    int const n = end - begin;
+    if( n <= 0 ) return;
+
+    int const maxchunks = std::max( 1, n / std::max( 1, grain ) );
+    int const nchunks =
+        std::min( maxchunks, static_cast< int >( thread_count() ) );
+    GISRASTER_TRACE_THREADS( nchunks );
+    if( nchunks == 1 )
+    {
+        fn( begin, end );
+        return;
+    }
+
+    std::vector< std::thread > threads;
+    std::vector< std::exception_ptr > errors( nchunks );
+    threads.reserve( nchunks - 1 );
+    int const step = n / nchunks;
+    int const extra = n % nchunks;
+    int cbegin = begin;
+    for( int i = 0; i < nchunks; ++i )
+    {
+        int const cend = cbegin + step + ( ( i < extra ) ? 1 : 0 );
+        auto work = [ &fn, &errors, i, cbegin, cend ]()
+        {
+            try
+            {
+                fn( cbegin, cend );
+            }
+            catch( ... )
+            {
+                errors[ i ] = std::current_exception();
+            }
+        };
+        //Run the last chunk on the calling thread
+        if( i == nchunks - 1 ) work();
+        else threads.emplace_back( work );
+        cbegin = cend;
+    }
+
+    for( auto& t : threads ) t.join();
+    for( auto& e : errors ) if( e ) std::rethrow_exception( e );
+}
+
+} //end gis
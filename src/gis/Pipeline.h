@@ -0,0 +1,1025 @@
+/*******************************************************************************
+ *
+ * MIT License
+ *
+ * Copyright (c) 2018 Joshua Koch
+ * 
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ * 
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ * 
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ *
+ ******************************************************************************/
+
+#pragma once
+
+#include <gis/Band.h>
+#include <gis/Format.h>
+#include <gis/Memory.h>
+#include <gis/Trace.h>
+
+#include <algorithm>
+#include <atomic>
+#include <condition_variable>
+#include <deque>
+#include <exception>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <stdexcept>
+#include <string>
+#include <thread>
+#include <type_traits>
+#include <utility>
+#include <vector>
+
+namespace gis
+{
+
+///
+struct PipelineOptions
+{
+    ///Rows per block passed between stages
+    int block_rows = 64;
+
+    ///Blocks that may wait between two stages before the producer blocks
+    int queue = 2;
+};
+
+///Size and georeferencing of a streamed band
+struct Grid
+{
+    int width = 0;
+    int height = 0;
+    int srid = 0;
+    double upperleftx = 0.0;
+    double upperlefty = 0.0;
+    double scalex = 0.0;
+    double scaley = 0.0;
+};
+
+///
+template< typename T >
+Grid grid_of(
+    Band< T > const& band )
+{
+    Grid g;
+    g.width = band.width();
+    g.height = band.height();
+    g.srid = band.srid();
+    g.upperleftx = band.upperleftx();
+    g.upperlefty = band.upperlefty();
+    g.scalex = band.scalex();
+    g.scaley = band.scaley();
+    return g;
+}
+
+///Rows [row, row + rows) of a band
+template< typename T >
+struct RowBlock
+{
+    int row = 0;
+    int rows = 0;
+    Buffer< T > data;
+};
+
+///Consecutive input rows visible to a stage
+template< typename T >
+class RowWindow
+{
+public:
+    ///data holds rows [first, last) of a width x height band
+    RowWindow(
+        T const* data,
+        int first,
+        int last,
+        Grid const& grid,
+        T nodata )
+        :
+        m_data( data ),
+        m_first( first ),
+        m_last( last ),
+        m_grid( grid ),
+        m_nodata( nodata )
+    {
+        ;
+    }
+
+    ///
+    int width() const
+    {
+        return m_grid.width;
+    }
+
+    ///
+    int height() const
+    {
+        return m_grid.height;
+    }
+
+    ///
+    T nodatavalue() const
+    {
+        return m_nodata;
+    }
+
+    ///Row r, or nullptr when r lies outside the band
+    T const* row(
+        int r ) const
+    {
+        if( r < 0 || r >= m_grid.height ) return nullptr;
+        if( r < m_first || r >= m_last ) throw std::out_of_range(
+            "RowWindow::row: row outside the declared halo" );
+        return m_data + static_cast< std::size_t >( r - m_first ) * m_grid.width;
+    }
+
+private:
+    ///
+    T const* m_data;
+
+    ///
+    int m_first;
+
+    ///
+    int m_last;
+
+    ///
+    Grid m_grid;
+
+    ///
+    T m_nodata;
+};
+
+///Producer of the rows of a band, read top to bottom
+template< typename T >
+class Source
+{
+public:
+    ///
+    virtual ~Source() = default;
+
+    ///
+    virtual Grid grid() const = 0;
+
+    ///
+    virtual T nodatavalue() const = 0;
+
+    ///Writes rows [row, row + rows) to out
+    virtual void read(
+        int row,
+        int rows,
+        T* out ) = 0;
+};
+
+///Consumer of the rows of a band, written top to bottom
+template< typename T >
+class Sink
+{
+public:
+    ///
+    virtual ~Sink() = default;
+
+    ///Called once before the first rows
+    virtual void open(
+        Grid const& grid,
+        T nodata ) = 0;
+
+    ///
+    virtual void write(
+        int row,
+        int rows,
+        T const* in ) = 0;
+
+    ///Called once after the last rows
+    virtual void close()
+    {
+        ;
+    }
+};
+
+///Turns rows of In into rows of Out, looking at halo rows above and below
+template< typename In, typename Out >
+class Stage
+{
+public:
+    ///
+    using Input = In;
+
+    ///
+    using Output = Out;
+
+    ///
+    virtual ~Stage() = default;
+
+    ///Rows needed above and below each output row
+    virtual int halo() const
+    {
+        return 0;
+    }
+
+    ///Output nodata for input nodata
+    virtual Out nodata(
+        In input ) const = 0;
+
+    ///Writes output rows [row, row + rows) to out; in holds input rows
+    ///[row - halo, row + rows + halo) that lie inside the band
+    virtual void process(
+        RowWindow< In > const& in,
+        int row,
+        int rows,
+        Out* out ) = 0;
+};
+
+///Reads the rows of a band that outlives the pipeline
+template< typename T >
+class BandSource : public Source< T >
+{
+public:
+    ///
+    explicit BandSource(
+        Band< T > const& band )
+        :
+        m_band( band )
+    {
+        ;
+    }
+
+    ///
+    Grid grid() const override
+    {
+        return grid_of( m_band );
+    }
+
+    ///
+    T nodatavalue() const override
+    {
+        return m_band.nodatavalue();
+    }
+
+    ///
+    void read(
+        int row,
+        int rows,
+        T* out ) override
+    {
+        T const* in = m_band.data() + static_cast< std::size_t >( row ) * m_band.width();
+        std::copy( in, in + static_cast< std::size_t >( rows ) * m_band.width(), out );
+    }
+
+private:
+    ///
+    Band< T > const& m_band;
+};
+
+///Reads one band of a native raster file (see format::write)
+template< typename T >
+class FileSource : public Source< T >
+{
+public:
+    ///
+    explicit FileSource(
+        std::string const& path,
+        std::size_t index = 0 )
+        :
+        m_reader( path, index )
+    {
+        ;
+    }
+
+    ///
+    Grid grid() const override
+    {
+        format::Info const info = m_reader.info();
+        Grid g;
+        g.width = info.width;
+        g.height = info.height;
+        g.srid = info.srid;
+        g.upperleftx = info.upperleftx;
+        g.upperlefty = info.upperlefty;
+        g.scalex = info.scalex;
+        g.scaley = info.scaley;
+        return g;
+    }
+
+    ///
+    T nodatavalue() const override
+    {
+        return m_reader.nodatavalue();
+    }
+
+    ///
+    void read(
+        int row,
+        int rows,
+        T* out ) override
+    {
+        m_reader.read( row, rows, out );
+    }
+
+private:
+    ///
+    format::RowReader< T > m_reader;
+};
+
+///Fills a band, replacing its size, georeferencing and pixels
+template< typename T >
+class BandSink : public Sink< T >
+{
+public:
+    ///
+    explicit BandSink(
+        Band< T >& band )
+        :
+        m_band( band )
+    {
+        ;
+    }
+
+    ///
+    void open(
+        Grid const& grid,
+        T nodata ) override
+    {
+        m_band = Band< T >( typename Band< T >::Data(
+            static_cast< std::size_t >( grid.width ) * grid.height ),
+            grid.width, grid.height, nodata );
+        m_band.upperleftx( grid.upperleftx );
+        m_band.upperlefty( grid.upperlefty );
+        m_band.srid( grid.srid );
+        m_band.scale( grid.scalex, grid.scaley );
+    }
+
+    ///
+    void write(
+        int row,
+        int rows,
+        T const* in ) override
+    {
+        std::size_t const offset = static_cast< std::size_t >( row ) * m_band.width();
+        std::copy( in, in + static_cast< std::size_t >( rows ) * m_band.width(),
+            m_band.data() + offset );
+    }
+
+private:
+    ///
+    Band< T >& m_band;
+};
+
+///Writes a single band native raster file (see format::RowWriter)
+template< typename T >
+class FileSink : public Sink< T >
+{
+public:
+    ///
+    explicit FileSink(
+        std::string const& path,
+        bool stats = true )
+        :
+        m_path( path ),
+        m_stats( stats ),
+        m_writer()
+    {
+        ;
+    }
+
+    ///
+    void open(
+        Grid const& grid,
+        T nodata ) override
+    {
+        format::Info info{};
+        info.width = grid.width;
+        info.height = grid.height;
+        info.srid = grid.srid;
+        info.upperleftx = grid.upperleftx;
+        info.upperlefty = grid.upperlefty;
+        info.scalex = grid.scalex;
+        info.scaley = grid.scaley;
+        m_writer.reset( new format::RowWriter< T >( m_path, info, nodata, m_stats ) );
+    }
+
+    ///
+    void write(
+        int,
+        int rows,
+        T const* in ) override
+    {
+        m_writer->write( in, rows );
+    }
+
+    ///
+    void close() override
+    {
+        m_writer->finish();
+    }
+
+private:
+    ///
+    std::string m_path;
+
+    ///
+    bool m_stats;
+
+    ///
+    std::unique_ptr< format::RowWriter< T > > m_writer;
+};
+
+///Converts pixels to Out, clamping to its range
+template< typename In, typename Out >
+class ConvertStage : public Stage< In, Out >
+{
+public:
+    ///
+    Out nodata(
+        In input ) const override
+    {
+        return Band< Out >::cast( input, true );
+    }
+
+    ///
+    void process(
+        RowWindow< In > const& in,
+        int row,
+        int rows,
+        Out* out ) override
+    {
+        In const* src = in.row( row );
+        In const nd = in.nodatavalue();
+        Out const outnd = nodata( nd );
+        std::size_t const n = static_cast< std::size_t >( rows ) * in.width();
+        for( std::size_t i = 0; i < n; ++i )
+        {
+            out[ i ] = ( src[ i ] == nd ) ? outnd : Band< Out >::cast( src[ i ], true );
+        }
+    }
+};
+
+///Applies a reclassification table (see Reclassify.h)
+template< typename Table >
+class ReclassifyStage :
+    public Stage< typename Table::Input, typename Table::Output >
+{
+public:
+    ///
+    using In = typename Table::Input;
+
+    ///
+    using Out = typename Table::Output;
+
+    ///
+    explicit ReclassifyStage(
+        Table table )
+        :
+        m_table( std::move( table ) )
+    {
+        ;
+    }
+
+    ///
+    Out nodata(
+        In input ) const override
+    {
+        return Band< Out >::cast( input, true );
+    }
+
+    ///
+    void process(
+        RowWindow< In > const& in,
+        int row,
+        int rows,
+        Out* out ) override
+    {
+        m_table.apply( in.row( row ), static_cast< std::size_t >( rows ) * in.width(),
+            in.nodatavalue(), out, nodata( in.nodatavalue() ) );
+    }
+
+private:
+    ///
+    Table m_table;
+};
+
+///Mean of the valid pixels of the square of the given radius around each
+///valid pixel; nodata pixels stay nodata
+template< typename In, typename Out = float >
+class FocalMeanStage : public Stage< In, Out >
+{
+public:
+    ///
+    explicit FocalMeanStage(
+        int radius )
+        :
+        m_radius( radius ),
+        m_sums(),
+        m_counts()
+    {
+        if( radius < 0 ) throw std::invalid_argument(
+            "FocalMeanStage: negative radius" );
+    }
+
+    ///
+    int halo() const override
+    {
+        return m_radius;
+    }
+
+    ///
+    Out nodata(
+        In ) const override
+    {
+        return Band< Out >::Lowest;
+    }
+
+    ///Column sums over the window rows, then a running sum along the row
+    void process(
+        RowWindow< In > const& in,
+        int row,
+        int rows,
+        Out* out ) override
+    {
+        int const w = in.width();
+        In const nd = in.nodatavalue();
+        m_sums.resize( w );
+        m_counts.resize( w );
+        for( int r = row; r < row + rows; ++r )
+        {
+            std::fill( m_sums.begin(), m_sums.end(), 0.0 );
+            std::fill( m_counts.begin(), m_counts.end(), 0 );
+            for( int rr = r - m_radius; rr <= r + m_radius; ++rr )
+            {
+                In const* src = in.row( rr );
+                if( !src ) continue;
+                for( int c = 0; c < w; ++c )
+                {
+                    bool const valid = ( src[ c ] != nd );
+                    m_sums[ c ] += valid ? static_cast< double >( src[ c ] ) : 0.0;
+                    m_counts[ c ] += valid;
+                }
+            }
+
+            In const* center = in.row( r );
+            Out* dst = out + static_cast< std::size_t >( r - row ) * w;
+            double sum = 0.0;
+            int count = 0;
+            for( int c = 0; c < std::min( m_radius, w ); ++c )
+            {
+                sum += m_sums[ c ];
+                count += m_counts[ c ];
+            }
+            for( int c = 0; c < w; ++c )
+            {
+                if( c + m_radius < w )
+                {
+                    sum += m_sums[ c + m_radius ];
+                    count += m_counts[ c + m_radius ];
+                }
+                if( c - m_radius - 1 >= 0 )
+                {
+                    sum -= m_sums[ c - m_radius - 1 ];
+                    count -= m_counts[ c - m_radius - 1 ];
+                }
+                dst[ c ] = ( center[ c ] == nd ) ? Band< Out >::Lowest :
+                    static_cast< Out >( sum / count );
+            }
+        }
+    }
+
+private:
+    ///
+    int m_radius;
+
+    ///
+    std::vector< double > m_sums;
+
+    ///
+    std::vector< int > m_counts;
+};
+
+namespace detail
+{
+
+///Shared by the stages of one pipeline run; the first failure stops every
+///queue so blocked threads return
+class PipelineState
+{
+public:
+    ///
+    void fail(
+        std::exception_ptr e )
+    {
+        std::vector< std::function< void() > > aborts;
+        {
+            std::lock_guard< std::mutex > lock( m_mutex );
+            if( !m_error ) m_error = e;
+            aborts = m_aborts;
+        }
+        for( auto const& abort : aborts ) abort();
+    }
+
+    ///
+    std::exception_ptr error()
+    {
+        std::lock_guard< std::mutex > lock( m_mutex );
+        return m_error;
+    }
+
+    ///
+    void on_fail(
+        std::function< void() > abort )
+    {
+        std::lock_guard< std::mutex > lock( m_mutex );
+        m_aborts.push_back( std::move( abort ) );
+    }
+
+    ///One per stage, run on its own thread
+    std::vector< std::function< void() > > tasks;
+
+private:
+    ///
+    std::mutex m_mutex;
+
+    ///
+    std::exception_ptr m_error;
+
+    ///
+    std::vector< std::function< void() > > m_aborts;
+};
+
+///Bounded queue of blocks between two stages; push blocks while it is full
+template< typename T >
+class BlockQueue
+{
+public:
+    ///
+    explicit BlockQueue(
+        int capacity )
+        :
+        m_capacity( static_cast< std::size_t >( std::max( 1, capacity ) ) ),
+        m_blocks(),
+        m_closed( false ),
+        m_aborted( false )
+    {
+        ;
+    }
+
+    ///False when the pipeline failed
+    bool push(
+        RowBlock< T >&& block )
+    {
+        std::unique_lock< std::mutex > lock( m_mutex );
+        m_space.wait( lock, [ this ]
+            {
+                return m_aborted || m_blocks.size() < m_capacity;
+            } );
+        if( m_aborted ) return false;
+        m_blocks.push_back( std::move( block ) );
+        m_ready.notify_one();
+        return true;
+    }
+
+    ///False once the queue is closed and drained, or the pipeline failed
+    bool pop(
+        RowBlock< T >& block )
+    {
+        std::unique_lock< std::mutex > lock( m_mutex );
+        m_ready.wait( lock, [ this ]
+            {
+                return m_aborted || m_closed || !m_blocks.empty();
+            } );
+        if( m_aborted || m_blocks.empty() ) return false;
+        block = std::move( m_blocks.front() );
+        m_blocks.pop_front();
+        m_space.notify_one();
+        return true;
+    }
+
+    ///No more blocks will be pushed
+    void close()
+    {
+        std::lock_guard< std::mutex > lock( m_mutex );
+        m_closed = true;
+        m_ready.notify_all();
+    }
+
+    ///
+    void abort()
+    {
+        std::lock_guard< std::mutex > lock( m_mutex );
+        m_aborted = true;
+        m_ready.notify_all();
+        m_space.notify_all();
+    }
+
+private:
+    ///
+    std::size_t m_capacity;
+
+    ///
+    std::deque< RowBlock< T > > m_blocks;
+
+    ///
+    bool m_closed;
+
+    ///
+    bool m_aborted;
+
+    ///
+    std::mutex m_mutex;
+
+    ///
+    std::condition_variable m_ready;
+
+    ///
+    std::condition_variable m_space;
+};
+
+///
+template< typename T >
+std::shared_ptr< BlockQueue< T > > make_queue(
+    PipelineState& state,
+    int capacity )
+{
+    auto queue = std::make_shared< BlockQueue< T > >( capacity );
+    std::weak_ptr< BlockQueue< T > > weak = queue;
+    state.on_fail( [ weak ]
+        {
+            if( auto q = weak.lock() ) q->abort();
+        } );
+    return queue;
+}
+
+} //end detail
+
+///A chain of row streaming stages from a source to a sink. Each stage runs
+///on its own thread and at most PipelineOptions::queue blocks wait between
+///two stages, so a slow stage holds back the ones before it. Peak memory is
+///about ( queue + 1 ) * block_rows + 2 * halo rows per stage, whatever the
+///height.
+template< typename T >
+class Pipeline
+{
+public:
+    ///Self friendship
+    template< typename U >
+    friend class Pipeline;
+
+    ///
+    explicit Pipeline(
+        std::shared_ptr< Source< T > > source,
+        PipelineOptions options = PipelineOptions() )
+        :
+        m_state( std::make_shared< detail::PipelineState >() ),
+        m_output(),
+        m_grid( source->grid() ),
+        m_nodata( source->nodatavalue() ),
+        m_options( options )
+    {
+        if( options.block_rows < 1 ) throw std::invalid_argument(
+            "Pipeline: block_rows must be positive" );
+        m_output = detail::make_queue< T >( *m_state, options.queue );
+        auto out = m_output;
+        Grid const grid = m_grid;
+        int const step = options.block_rows;
+        m_state->tasks.push_back( [ source, out, grid, step ]
+            {
+                for( int row = 0; row < grid.height; row += step )
+                {
+                    RowBlock< T > block;
+                    block.row = row;
+                    block.rows = std::min( step, grid.height - row );
+                    block.data.resize( static_cast< std::size_t >( block.rows ) * grid.width );
+                    source->read( row, block.rows, block.data.data() );
+                    if( !out->push( std::move( block ) ) ) return;
+                }
+                out->close();
+            } );
+    }
+
+    ///
+    Grid const& grid() const
+    {
+        return m_grid;
+    }
+
+    ///
+    T nodatavalue() const
+    {
+        return m_nodata;
+    }
+
+    ///Appends stage, any Stage< T, U >
+    template< typename S >
+    Pipeline< typename S::Output > then(
+        std::shared_ptr< S > derived ) &&
+    {
+        using U = typename S::Output;
+        std::shared_ptr< Stage< T, U > > stage = std::move( derived );
+        auto in = m_output;
+        auto out = detail::make_queue< U >( *m_state, m_options.queue );
+        Grid const grid = m_grid;
+        T const nodata = m_nodata;
+        int const step = m_options.block_rows;
+        m_state->tasks.push_back( [ stage, in, out, grid, nodata, step ]
+            {
+                run_stage( *stage, *in, *out, grid, nodata, step );
+            } );
+        return Pipeline< U >( m_state, out, m_grid, stage->nodata( m_nodata ), m_options );
+    }
+
+    ///
+    template< typename U >
+    Pipeline< U > convert() &&
+    {
+        return std::move( *this ).then( std::make_shared< ConvertStage< T, U > >() );
+    }
+
+    ///
+    template< typename Table >
+    Pipeline< typename Table::Output > reclassify(
+        Table table ) &&
+    {
+        static_assert( std::is_same< typename Table::Input, T >::value,
+            "Pipeline::reclassify: table input type must match the pixel type" );
+        return std::move( *this ).then(
+            std::make_shared< ReclassifyStage< Table > >( std::move( table ) ) );
+    }
+
+    ///
+    template< typename U = float >
+    Pipeline< U > focal_mean(
+        int radius ) &&
+    {
+        return std::move( *this ).then(
+            std::make_shared< FocalMeanStage< T, U > >( radius ) );
+    }
+
+    ///Runs every stage, feeding sink on the calling thread; rethrows the
+    ///first exception of any stage
+    void run(
+        Sink< T >& sink ) &&
+    {
+        GISRASTER_TRACE_SCOPE( "Pipeline::run",
+            static_cast< std::size_t >( m_grid.width ) * m_grid.height, 0 );
+        GISRASTER_TRACE_THREADS( static_cast< int >( m_state->tasks.size() ) + 1 );
+        auto state = m_state;
+        std::vector< std::thread > threads;
+        threads.reserve( state->tasks.size() );
+        for( auto& task : state->tasks )
+        {
+            threads.emplace_back( [ state, &task ]
+                {
+                    try
+                    {
+                        task();
+                    }
+                    catch( ... )
+                    {
+                        state->fail( std::current_exception() );
+                    }
+                } );
+        }
+
+        try
+        {
+            sink.open( m_grid, m_nodata );
+            RowBlock< T > block;
+            while( m_output->pop( block ) )
+            {
+                sink.write( block.row, block.rows, block.data.data() );
+            }
+        }
+        catch( ... )
+        {
+            state->fail( std::current_exception() );
+        }
+        for( auto& t : threads ) t.join();
+        if( auto e = state->error() ) std::rethrow_exception( e );
+        sink.close();
+    }
+
+    ///Runs the pipeline into a new band
+    Band< T > to_band() &&
+    {
+        Band< T > result;
+        BandSink< T > sink( result );
+        std::move( *this ).run( sink );
+        return result;
+    }
+
+    ///Runs the pipeline into a native raster file
+    void write(
+        std::string const& path,
+        bool stats = true ) &&
+    {
+        FileSink< T > sink( path, stats );
+        std::move( *this ).run( sink );
+    }
+
+private:
+    ///
+    Pipeline(
+        std::shared_ptr< detail::PipelineState > state,
+        std::shared_ptr< detail::BlockQueue< T > > output,
+        Grid const& grid,
+        T nodata,
+        PipelineOptions options )
+        :
+        m_state( std::move( state ) ),
+        m_output( std::move( output ) ),
+        m_grid( grid ),
+        m_nodata( nodata ),
+        m_options( options )
+    {
+        ;
+    }
+
+    ///Keeps the input rows from halo rows above the next output row to the
+    ///last row received, and emits every output row whose halo below has
+    ///arrived
+    template< typename U >
+    static void run_stage(
+        Stage< T, U >& stage,
+        detail::BlockQueue< T >& in,
+        detail::BlockQueue< U >& out,
+        Grid const& grid,
+        T nodata,
+        int step )
+    {
+        int const halo = stage.halo();
+        std::size_t const width = static_cast< std::size_t >( grid.width );
+        Buffer< T > rows;
+        int first = 0;
+        int last = 0;
+        int next = 0;
+        RowBlock< T > block;
+        while( in.pop( block ) )
+        {
+            rows.insert( rows.end(), block.data.begin(), block.data.end() );
+            last += block.rows;
+            int const ready = ( last == grid.height ) ? last : last - halo;
+            RowWindow< T > const window( rows.data(), first, last, grid, nodata );
+            while( next < ready )
+            {
+                RowBlock< U > result;
+                result.row = next;
+                result.rows = std::min( step, ready - next );
+                result.data.resize( width * result.rows );
+                stage.process( window, next, result.rows, result.data.data() );
+                next += result.rows;
+                if( !out.push( std::move( result ) ) ) return;
+            }
+            int const keep = std::max( first, next - halo );
+            rows.erase( rows.begin(), rows.begin() + width * ( keep - first ) );
+            first = keep;
+        }
+        out.close();
+    }
+
+    ///
+    std::shared_ptr< detail::PipelineState > m_state;
+
+    ///Blocks leaving the last stage
+    std::shared_ptr< detail::BlockQueue< T > > m_output;
+
+    ///
+    Grid m_grid;
+
+    ///
+    T m_nodata;
+
+    ///
+    PipelineOptions m_options;
+};
+
+///Streams the rows of band, which must outlive the pipeline
+template< typename T >
+Pipeline< T > stream(
+    Band< T > const& band,
+    PipelineOptions options = PipelineOptions() )
+{
+    return Pipeline< T >( std::make_shared< BandSource< T > >( band ), options );
+}
+
+///Streams band index of the native raster file at path
+template< typename T >
+Pipeline< T > stream(
+    std::string const& path,
+    std::size_t index = 0,
+    PipelineOptions options = PipelineOptions() )
+{
+    return Pipeline< T >( std::make_shared< FileSource< T > >( path, index ), options );
+}
+
+} //end gis
@@ -0,0 +1,639 @@
+/*******************************************************************************
+ *
+ * MIT License
+ *
+ * Copyright (c) 2018 Joshua Koch
+ * 
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ * 
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ * 
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ *
+ ******************************************************************************/
+
+#pragma once
+
+#include <gis/Band.h>
+#include <gis/Parallel.h>
+#include <gis/Trace.h>
+
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <limits>
+#include <stdexcept>
+#include <type_traits>
+#include <vector>
+
+namespace gis
+{
+
+///How rank_filter() keeps its window
+enum class RankMethod
+{
+    ///Perreault-Hebert for 8 bit integers, Huang for 16 bit, Sorted
+    ///otherwise
+    Auto,
+
+    ///Sliding histogram updated by one column per step (8 and 16 bit
+    ///integers)
+    Huang,
+
+    ///Column histograms, constant time per pixel (8 bit integers)
+    PerreaultHebert,
+
+    ///Sorted window merged with each incoming column (any type)
+    Sorted
+};
+
+namespace detail
+{
+
+///Rows and columns of the tiles rank filters process in parallel
+static constexpr int RankTileRows = 64;
+
+///
+static constexpr int RankTileColumns = 256;
+
+///
+template< typename T >
+struct is_histogram_pixel : std::integral_constant< bool,
+    std::is_integral< T >::value && !std::is_same< T, bool >::value &&
+    sizeof( T ) <= 2 >
+{
+};
+
+///
+template< typename T >
+bool rank_valid(
+    T v,
+    T nodata )
+{
+    return v != nodata && v == v;
+}
+
+///Index of the k-th smallest ( 0 based ) of n values at fraction q, to the
+///nearest rank
+inline int rank_index(
+    int n,
+    double q )
+{
+    return static_cast< int >( std::floor( q * ( n - 1 ) + 0.5 ) );
+}
+
+///Two level histogram of 8 or 16 bit integers: coarse bins of the high half
+///of the bits over fine bins of the low half, so selecting a rank scans at
+///most twice the square root of the number of values
+template< typename T >
+class RankHistogram
+{
+public:
+    ///
+    static constexpr int Bits = 8 * sizeof( T );
+
+    ///
+    static constexpr int Half = Bits / 2;
+
+    ///
+    static constexpr int Fine = 1 << Half;
+
+    ///
+    RankHistogram()
+        :
+        m_coarse( Fine, 0 ),
+        m_fine( static_cast< std::size_t >( Fine ) * Fine, 0 ),
+        m_count( 0 )
+    {
+        ;
+    }
+
+    ///
+    static int bin(
+        T v )
+    {
+        return static_cast< int >( v ) -
+            static_cast< int >( std::numeric_limits< T >::lowest() );
+    }
+
+    ///
+    void add(
+        T v )
+    {
+        int const b = bin( v );
+        ++m_coarse[ b >> Half ];
+        ++m_fine[ b ];
+        ++m_count;
+    }
+
+    ///
+    void remove(
+        T v )
+    {
+        int const b = bin( v );
+        --m_coarse[ b >> Half ];
+        --m_fine[ b ];
+        --m_count;
+    }
+
+    ///
+    int size() const
+    {
+        return m_count;
+    }
+
+    ///k-th smallest value, k < size()
+    T select(
+        int k ) const
+    {
+        int hi = 0;
+        while( k >= m_coarse[ hi ] ) k -= m_coarse[ hi++ ];
+        int const* fine = m_fine.data() + static_cast< std::size_t >( hi ) * Fine;
+        int lo = 0;
+        while( k >= fine[ lo ] ) k -= fine[ lo++ ];
+        return static_cast< T >( ( hi << Half ) + lo +
+            static_cast< int >( std::numeric_limits< T >::lowest() ) );
+    }
+
+private:
+    ///
+    std::vector< int > m_coarse;
+
+    ///
+    std::vector< int > m_fine;
+
+    ///
+    int m_count;
+};
+
+///Window kept as a sorted vector. Each step locates the few outgoing and
+///incoming values by binary search and rebuilds the window with block
+///copies between them, so the per-element cost is that of a memmove.
+template< typename T >
+class RankSorted
+{
+public:
+    ///
+    void update(
+        std::vector< T >& out,
+        std::vector< T >& in )
+    {
+        std::sort( out.begin(), out.end() );
+        std::sort( in.begin(), in.end() );
+        //Outgoing values are all in the window; equal ones take successive
+        //positions
+        m_drops.clear();
+        for( std::size_t i = 0; i < out.size(); ++i )
+        {
+            bool const repeat = ( i > 0 && !( out[ i - 1 ] < out[ i ] ) );
+            m_drops.push_back( repeat ? m_drops.back() + 1 : search( out[ i ], false ) );
+        }
+        m_inserts.clear();
+        for( T v : in ) m_inserts.push_back( search( v, true ) );
+
+        m_next.resize( m_values.size() - out.size() + in.size() );
+        T const* src = m_values.data();
+        T* dst = m_next.data();
+        std::size_t from = 0;
+        std::size_t d = 0;
+        std::size_t e = 0;
+        while( d < m_drops.size() || e < m_inserts.size() )
+        {
+            bool const insert = ( e < m_inserts.size() ) &&
+                ( d == m_drops.size() || m_inserts[ e ] <= m_drops[ d ] );
+            std::size_t const at = insert ? m_inserts[ e ] : m_drops[ d ];
+            dst = std::copy( src + from, src + at, dst );
+            from = at;
+            if( insert )
+            {
+                *dst++ = in[ e++ ];
+            }
+            else
+            {
+                from = at + 1;
+                ++d;
+            }
+        }
+        std::copy( src + from, src + m_values.size(), dst );
+        std::swap( m_values, m_next );
+    }
+
+    ///
+    int size() const
+    {
+        return static_cast< int >( m_values.size() );
+    }
+
+    ///Lower or upper bound of v by a binary search with a fixed number of
+    ///steps and no data dependent branches
+    std::size_t search(
+        T v,
+        bool upper ) const
+    {
+        std::size_t n = m_values.size();
+        if( n == 0 ) return 0;
+        T const* base = m_values.data();
+        while( n > 1 )
+        {
+            std::size_t const half = n / 2;
+            T const x = base[ half ];
+            base = ( upper ? !( v < x ) : ( x < v ) ) ? base + half : base;
+            n -= half;
+        }
+        bool const after = upper ? !( v < *base ) : ( *base < v );
+        return static_cast< std::size_t >( base - m_values.data() ) + after;
+    }
+
+    ///
+    T select(
+        int k ) const
+    {
+        return m_values[ k ];
+    }
+
+private:
+    ///
+    std::vector< T > m_values;
+
+    ///
+    std::vector< T > m_next;
+
+    ///Window positions of the outgoing values
+    std::vector< std::size_t > m_drops;
+
+    ///Window positions the incoming values go before
+    std::vector< std::size_t > m_inserts;
+};
+
+///Adapts RankHistogram to the batch update of RankSorted
+template< typename T >
+class RankHuang
+{
+public:
+    ///
+    void update(
+        std::vector< T >& out,
+        std::vector< T >& in )
+    {
+        for( T v : out ) m_histogram.remove( v );
+        for( T v : in ) m_histogram.add( v );
+    }
+
+    ///
+    int size() const
+    {
+        return m_histogram.size();
+    }
+
+    ///
+    T select(
+        int k ) const
+    {
+        return m_histogram.select( k );
+    }
+
+private:
+    ///
+    RankHistogram< T > m_histogram;
+};
+
+///Valid pixels of rows [ r0, r1 ) and columns [ c0, c1 ), clipped to the
+///band, appended to out
+template< typename T >
+void rank_gather(
+    Band< T > const& band,
+    int r0,
+    int c0,
+    int r1,
+    int c1,
+    std::vector< T >& out )
+{
+    r0 = std::max( r0, 0 );
+    c0 = std::max( c0, 0 );
+    r1 = std::min( r1, band.height() );
+    c1 = std::min( c1, band.width() );
+    T const nodata = band.nodatavalue();
+    for( int r = r0; r < r1; ++r )
+    {
+        T const* row = band.data() + static_cast< std::size_t >( r ) * band.width();
+        for( int c = c0; c < c1; ++c )
+        {
+            if( rank_valid( row[ c ], nodata ) ) out.push_back( row[ c ] );
+        }
+    }
+}
+
+///Rank filter of one tile, sliding Window along a serpentine path so that
+///every step, across or down, exchanges a single line of 2 * radius + 1
+///pixels
+template< typename Window, typename T >
+void rank_serpentine(
+    Band< T > const& band,
+    int radius,
+    double q,
+    int r0,
+    int c0,
+    int r1,
+    int c1,
+    T* out )
+{
+    int const w = band.width();
+    T const nodata = band.nodatavalue();
+    Window window;
+    std::vector< T > leaving;
+    std::vector< T > entering;
+    rank_gather( band, r0 - radius, c0 - radius, r0 + radius + 1, c0 + radius + 1, entering );
+    window.update( leaving, entering );
+
+    int c = c0;
+    for( int r = r0; r < r1; ++r )
+    {
+        bool const right = ( ( r - r0 ) % 2 == 0 );
+        for( int i = 0; i < c1 - c0; ++i )
+        {
+            T const center = band.data()[ static_cast< std::size_t >( r ) * w + c ];
+            out[ static_cast< std::size_t >( r ) * w + c ] =
+                rank_valid( center, nodata ) ?
+                window.select( rank_index( window.size(), q ) ) : nodata;
+            if( i + 1 == c1 - c0 ) break;
+
+            leaving.clear();
+            entering.clear();
+            int const leave = right ? c - radius : c + radius;
+            int const enter = right ? c + radius + 1 : c - radius - 1;
+            rank_gather( band, r - radius, leave, r + radius + 1, leave + 1, leaving );
+            rank_gather( band, r - radius, enter, r + radius + 1, enter + 1, entering );
+            window.update( leaving, entering );
+            c += right ? 1 : -1;
+        }
+        if( r + 1 == r1 ) break;
+
+        leaving.clear();
+        entering.clear();
+        rank_gather( band, r - radius, c - radius, r - radius + 1, c + radius + 1, leaving );
+        rank_gather( band, r + radius + 1, c - radius, r + radius + 2, c + radius + 1, entering );
+        window.update( leaving, entering );
+    }
+}
+
+///Perreault-Hebert rank filter of one tile of an 8 bit band. Each column
+///keeps a histogram of its 2 * radius + 1 rows, updated by one pixel per
+///row; the window histogram adds the entering and drops the leaving column
+///histogram. Fine bins of the window are brought up to date lazily, only for
+///the coarse bin a selection lands in.
+template< typename T >
+void rank_perreault_hebert(
+    Band< T > const& band,
+    int radius,
+    double q,
+    int r0,
+    int c0,
+    int r1,
+    int c1,
+    T* out )
+{
+    using Histogram = RankHistogram< T >;
+    int constexpr Fine = Histogram::Fine;
+    int constexpr Half = Histogram::Half;
+    int const w = band.width();
+    int const h = band.height();
+    T const nodata = band.nodatavalue();
+
+    //Columns c0 - radius to c1 + radius, clipped to the band
+    int const first = std::max( c0 - radius, 0 );
+    int const last = std::min( c1 + radius, w );
+    int const columns = last - first;
+    std::vector< int > coarse( static_cast< std::size_t >( columns ) * Fine, 0 );
+    std::vector< int > fine( static_cast< std::size_t >( columns ) * Fine * Fine, 0 );
+    std::vector< int > counts( columns, 0 );
+    auto change = [ & ]( int r, int delta )
+    {
+        if( r < 0 || r >= h ) return;
+        T const* row = band.data() + static_cast< std::size_t >( r ) * w;
+        for( int j = 0; j < columns; ++j )
+        {
+            T const v = row[ first + j ];
+            if( !rank_valid( v, nodata ) ) continue;
+            int const b = Histogram::bin( v );
+            coarse[ static_cast< std::size_t >( j ) * Fine + ( b >> Half ) ] += delta;
+            fine[ static_cast< std::size_t >( j ) * Fine * Fine + b ] += delta;
+            counts[ j ] += delta;
+        }
+    };
+    //The first row of the loop drops row r0 - radius - 1 again
+    for( int r = r0 - radius - 1; r < r0 + radius; ++r ) change( r, 1 );
+
+    std::vector< int > kcoarse( Fine );
+    std::vector< int > kfine( static_cast< std::size_t >( Fine ) * Fine );
+    //Window start column each coarse bin of kfine was last brought up to
+    std::vector< int > stamp( Fine );
+    for( int r = r0; r < r1; ++r )
+    {
+        change( r - radius - 1, -1 );
+        change( r + radius, 1 );
+
+        //Window of output column c covers histogram columns [ lo, hi )
+        int lo = std::max( c0 - radius, 0 ) - first;
+        int hi = std::min( c0 + radius + 1, w ) - first;
+        std::fill( kcoarse.begin(), kcoarse.end(), 0 );
+        int n = 0;
+        for( int j = lo; j < hi; ++j )
+        {
+            int const* col = coarse.data() + static_cast< std::size_t >( j ) * Fine;
+            for( int b = 0; b < Fine; ++b ) kcoarse[ b ] += col[ b ];
+            n += counts[ j ];
+        }
+        std::fill( stamp.begin(), stamp.end(), -1 );
+
+        for( int c = c0; c < c1; ++c )
+        {
+            if( c > c0 )
+            {
+                int const nlo = std::max( c - radius, 0 ) - first;
+                int const nhi = std::min( c + radius + 1, w ) - first;
+                if( nlo > lo )
+                {
+                    int const* col = coarse.data() + static_cast< std::size_t >( lo ) * Fine;
+                    for( int b = 0; b < Fine; ++b ) kcoarse[ b ] -= col[ b ];
+                    n -= counts[ lo ];
+                }
+                if( nhi > hi )
+                {
+                    int const* col = coarse.data() + static_cast< std::size_t >( hi ) * Fine;
+                    for( int b = 0; b < Fine; ++b ) kcoarse[ b ] += col[ b ];
+                    n += counts[ hi ];
+                }
+                lo = nlo;
+                hi = nhi;
+            }
+
+            std::size_t const at = static_cast< std::size_t >( r ) * w + c;
+            if( !rank_valid( band.data()[ at ], nodata ) )
+            {
+                out[ at ] = nodata;
+                continue;
+            }
+
+            int k = rank_index( n, q );
+            int top = 0;
+            while( k >= kcoarse[ top ] ) k -= kcoarse[ top++ ];
+
+            //Bring the fine bins under coarse bin top to window [ lo, hi ):
+            //rebuild when the columns in between outnumber the window
+            int* segment = kfine.data() + static_cast< std::size_t >( top ) * Fine;
+            auto apply = [ & ]( int j, int delta )
+            {
+                int const* col = fine.data() +
+                    static_cast< std::size_t >( j ) * Fine * Fine +
+                    static_cast< std::size_t >( top ) * Fine;
+                for( int b = 0; b < Fine; ++b ) segment[ b ] += delta * col[ b ];
+            };
+            int const seen = stamp[ top ];
+            if( seen < 0 || c - seen > hi - lo )
+            {
+                std::fill( segment, segment + Fine, 0 );
+                for( int j = lo; j < hi; ++j ) apply( j, 1 );
+            }
+            else
+            {
+                for( int x = seen + 1; x <= c; ++x )
+                {
+                    int const plo = std::max( x - 1 - radius, 0 ) - first;
+                    int const phi = std::min( x + radius, w ) - first;
+                    if( std::max( x - radius, 0 ) - first > plo ) apply( plo, -1 );
+                    if( std::min( x + radius + 1, w ) - first > phi ) apply( phi, 1 );
+                }
+            }
+            stamp[ top ] = c;
+
+            int bottom = 0;
+            while( k >= segment[ bottom ] ) k -= segment[ bottom++ ];
+            out[ at ] = static_cast< T >( ( top << Half ) + bottom +
+                static_cast< int >( std::numeric_limits< T >::lowest() ) );
+        }
+    }
+}
+
+///Filters one tile of an 8 or 16 bit integer band
+template< typename T >
+void rank_tile(
+    Band< T > const& band,
+    int radius,
+    double q,
+    RankMethod method,
+    int r0,
+    int c0,
+    int r1,
+    int c1,
+    T* out,
+    std::true_type )
+{
+    switch( method )
+    {
+    case RankMethod::PerreaultHebert:
+        rank_perreault_hebert( band, radius, q, r0, c0, r1, c1, out );
+        break;
+    case RankMethod::Huang:
+        rank_serpentine< RankHuang< T > >( band, radius, q, r0, c0, r1, c1, out );
+        break;
+    default:
+        rank_serpentine< RankSorted< T > >( band, radius, q, r0, c0, r1, c1, out );
+        break;
+    }
+}
+
+///Filters one tile of any other band
+template< typename T >
+void rank_tile(
+    Band< T > const& band,
+    int radius,
+    double q,
+    RankMethod,
+    int r0,
+    int c0,
+    int r1,
+    int c1,
+    T* out,
+    std::false_type )
+{
+    rank_serpentine< RankSorted< T > >( band, radius, q, r0, c0, r1, c1, out );
+}
+
+} //end detail
+
+///Rank filter over the ( 2 * radius + 1 ) square window: each valid pixel
+///becomes the value at percentile ( 0 to 100 ) of the valid pixels in its
+///window, to the nearest rank. Nodata pixels and pixels outside the band
+///are left out of the windows; nodata pixels stay nodata. Tiles are
+///filtered in parallel, each reading its halo from band.
+template< typename T >
+Band< T > rank_filter(
+    Band< T > const& band,
+    int radius,
+    double percentile,
+    RankMethod method = RankMethod::Auto )
+{
+    if( radius < 0 ) throw std::invalid_argument(
+        "rank_filter: negative radius" );
+    if( !( percentile >= 0.0 && percentile <= 100.0 ) ) throw std::invalid_argument(
+        "rank_filter: percentile outside [0, 100]" );
+    bool constexpr histogram = detail::is_histogram_pixel< T >::value;
+    if( method == RankMethod::Auto )
+    {
+        method = !histogram ? RankMethod::Sorted :
+            ( sizeof( T ) == 1 ? RankMethod::PerreaultHebert : RankMethod::Huang );
+    }
+    if( method == RankMethod::Huang && !histogram ) throw std::invalid_argument(
+        "rank_filter: Huang needs 8 or 16 bit integer pixels" );
+    if( method == RankMethod::PerreaultHebert && !( histogram && sizeof( T ) == 1 ) )
+    {
+        throw std::invalid_argument(
+            "rank_filter: Perreault-Hebert needs 8 bit integer pixels" );
+    }
+    GISRASTER_TRACE_SCOPE( "rank_filter", band.size(), band.size() * sizeof( T ) );
+
+    Band< T > result;
+    result.copy_props( band, band.nodatavalue(), no_init );
+    T* out = result.data();
+    double const q = percentile / 100.0;
+    int const across = ( band.width() + detail::RankTileColumns - 1 ) /
+        detail::RankTileColumns;
+    int const down = ( band.height() + detail::RankTileRows - 1 ) / detail::RankTileRows;
+    parallel_for( 0, across * down, [ & ]( int begin, int end )
+        {
+            for( int tile = begin; tile < end; ++tile )
+            {
+                int const r0 = ( tile / across ) * detail::RankTileRows;
+                int const c0 = ( tile % across ) * detail::RankTileColumns;
+                int const r1 = std::min( r0 + detail::RankTileRows, band.height() );
+                int const c1 = std::min( c0 + detail::RankTileColumns, band.width() );
+                detail::rank_tile( band, radius, q, method, r0, c0, r1, c1, out,
+                    std::integral_constant< bool, histogram >{} );
+            }
+        } );
+    return result;
+}
+
+///
+template< typename T >
+Band< T > median_filter(
+    Band< T > const& band,
+    int radius,
+    RankMethod method = RankMethod::Auto )
+{
+    return rank_filter( band, radius, 50.0, method );
+}
+
+} //end gis
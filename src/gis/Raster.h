@@ -28,26 +28,65 @@
 
 #include <gis/Band.h>
 
+#include <stdexcept>
 #include <tuple>
+#include <utility>
 
 namespace gis
 {
 
+namespace detail
+{
+
+///
+template< std::size_t... Ns >
+constexpr bool unique_indices()
+{
+    std::size_t const ns[] = { Ns..., 0 };
+    for( std::size_t i = 0; i < sizeof...( Ns ); ++i )
+    {
+        for( std::size_t j = i + 1; j < sizeof...( Ns ); ++j )
+        {
+            if( ns[ i ] == ns[ j ] ) return false;
+        }
+    }
+    return true;
+}
+
+} //end detail
+
 ///
 template< typename... Ts >
 class Raster
 {
 public:
+    ///Self friendship
+    template< typename... Us >
+    friend class Raster;
+
     ///
     using Data = std::tuple< Band< Ts >... >;
 
+    ///Pixel type of band N
+    template< std::size_t N >
+    using Type = typename std::tuple_element< N, std::tuple< Ts... > >::type;
+
     ///
     Raster(
         Band< Ts >&&... ts )
         :
+        Raster( Data( std::forward< Band< Ts > >( ts )... ) )
+    {
+        ;
+    }
+
+    ///Takes ownership of the bands in data
+    explicit Raster(
+        Data&& data )
+        :
         m_width(),
         m_height(),
-        m_data( std::forward< Band< Ts > >( ts )... )
+        m_data( std::move( data ) )
     {
         if( !same_size() )
         {
@@ -142,14 +181,57 @@ public:
         return std::get< N >( m_data );
     }
 
-    /*///
+    ///New raster holding these bands followed by band; no pixel data is
+    ///copied
     template< typename U >
     Raster< Ts..., U > append(
-        Band< U >&& band )
+        Band< U >&& band ) &&
     {
-        return Raster( std::tuple_cat( m_data,
+        return Raster< Ts..., U >( std::tuple_cat( std::move( m_data ),
             std::make_tuple( std::forward< Band< U > >( band ) ) ) );
-    }*/
+    }
+
+    ///New raster holding bands Ns... in the given order; the remaining bands
+    ///are released and no pixel data is copied
+    template< std::size_t... Ns >
+    Raster< Type< Ns >... > select() &&
+    {
+        static_assert( sizeof...( Ns ) > 0,
+            "Raster::select: no bands selected" );
+        static_assert( detail::unique_indices< Ns... >(),
+            "Raster::select: band selected more than once" );
+        return Raster< Type< Ns >... >( std::make_tuple(
+            std::move( std::get< Ns >( m_data ) )... ) );
+    }
+
+    ///New raster holding every band in the order Ns...
+    template< std::size_t... Ns >
+    Raster< Type< Ns >... > reorder() &&
+    {
+        static_assert( sizeof...( Ns ) == sizeof...( Ts ),
+            "Raster::reorder: every band must be listed once" );
+        return std::move( *this ).template select< Ns... >();
+    }
+
+    ///References to bands Ns..., borrowed from this raster
+    template< std::size_t... Ns >
+    std::tuple< Band< Type< Ns > >&... > view()
+    {
+        return std::tie( std::get< Ns >( m_data )... );
+    }
+
+    ///
+    template< std::size_t... Ns >
+    std::tuple< Band< Type< Ns > > const&... > view() const
+    {
+        return std::tie( std::get< Ns >( m_data )... );
+    }
+
+    ///Moves the bands out of this raster
+    Data release() &&
+    {
+        return std::move( m_data );
+    }
 
     ///
     constexpr bool same_size() const
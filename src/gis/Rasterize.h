@@ -0,0 +1,510 @@
+/*******************************************************************************
+ *
+ * MIT License
+ *
+ * Copyright (c) 2018 Joshua Koch
+ * 
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ * 
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ * 
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ *
+ ******************************************************************************/
+
+#pragma once
+
+#include <gis/Band.h>
+#include <gis/Geometry.h>
+#include <gis/Parallel.h>
+
+#include <algorithm>
+#include <cmath>
+#include <limits>
+#include <stdexcept>
+#include <vector>
+
+namespace gis
+{
+
+///Pixel selection rule used when burning geometries
+enum class BurnMode
+{
+    ///Pixels whose center falls inside a polygon; one pixel per step for lines
+    Center,
+
+    ///Every pixel touched by the geometry
+    AllTouched
+};
+
+namespace detail
+{
+
+///Polygon edge in pixel space, top < bottom
+struct ScanEdge
+{
+    ///
+    double top;
+
+    ///
+    double bottom;
+
+    ///x at top
+    double x;
+
+    ///
+    double dxdy;
+};
+
+///Segment in pixel space
+struct ScanSegment
+{
+    ///
+    Point a;
+
+    ///
+    Point b;
+};
+
+///Geometry converted to pixel space, ready to be scanned
+struct ScanFeature
+{
+    ///Sorted by top; empty for lines
+    std::vector< ScanEdge > edges;
+
+    ///Outline (polygons) or path (lines)
+    std::vector< ScanSegment > segments;
+
+    ///
+    bool line = false;
+
+    ///
+    double miny = std::numeric_limits< double >::max();
+
+    ///
+    double maxy = std::numeric_limits< double >::lowest();
+
+    ///
+    std::size_t value = 0;
+};
+
+///Clips segment ab to the box [x0, x1] x [y0, y1] (Liang-Barsky)
+inline bool clip_segment(
+    Point& a,
+    Point& b,
+    double x0,
+    double y0,
+    double x1,
+    double y1 )
+{
+    double t0 = 0.0, t1 = 1.0;
+    double const dx = b.x - a.x, dy = b.y - a.y;
+    double const p[ 4 ] = { -dx, dx, -dy, dy };
+    double const q[ 4 ] = { a.x - x0, x1 - a.x, a.y - y0, y1 - a.y };
+    for( int i = 0; i < 4; ++i )
+    {
+        if( p[ i ] == 0.0 )
+        {
+            if( q[ i ] < 0.0 ) return false;
+            continue;
+        }
+        double const t = q[ i ] / p[ i ];
+        if( p[ i ] < 0.0 ) t0 = std::max( t0, t );
+        else t1 = std::min( t1, t );
+        if( t0 > t1 ) return false;
+    }
+    Point const s = a;
+    a = { s.x + t0 * dx, s.y + t0 * dy };
+    b = { s.x + t1 * dx, s.y + t1 * dy };
+    return true;
+}
+
+///Visits every pixel touched by the segment (supercover traversal)
+template< typename F >
+void trace_touched(
+    ScanSegment seg,
+    int rbegin,
+    int rend,
+    int width,
+    F&& pixel )
+{
+    if( !clip_segment( seg.a, seg.b, 0.0, rbegin, width, rend ) ) return;
+
+    double const dx = seg.b.x - seg.a.x, dy = seg.b.y - seg.a.y;
+    int c = static_cast< int >( std::floor( seg.a.x ) );
+    int r = static_cast< int >( std::floor( seg.a.y ) );
+    int const ec = static_cast< int >( std::floor( seg.b.x ) );
+    int const er = static_cast< int >( std::floor( seg.b.y ) );
+    int const sc = ( dx > 0.0 ) ? 1 : -1;
+    int const sr = ( dy > 0.0 ) ? 1 : -1;
+    double constexpr inf = std::numeric_limits< double >::infinity();
+    double const tdc = ( dx != 0.0 ) ? std::abs( 1.0 / dx ) : inf;
+    double const tdr = ( dy != 0.0 ) ? std::abs( 1.0 / dy ) : inf;
+    double tmc = ( dx == 0.0 ) ? inf :
+        ( ( dx > 0.0 ) ? ( c + 1 - seg.a.x ) : ( seg.a.x - c ) ) * tdc;
+    double tmr = ( dy == 0.0 ) ? inf :
+        ( ( dy > 0.0 ) ? ( r + 1 - seg.a.y ) : ( seg.a.y - r ) ) * tdr;
+
+    int n = 1 + std::abs( ec - c ) + std::abs( er - r );
+    while( n-- > 0 )
+    {
+        if( r >= rbegin && r < rend && c >= 0 && c < width ) pixel( r, c );
+        if( tmc < tmr )
+        {
+            tmc += tdc;
+            c += sc;
+        }
+        else
+        {
+            tmr += tdr;
+            r += sr;
+        }
+    }
+}
+
+///Visits one pixel per step along the major axis of the segment
+template< typename F >
+void trace_center(
+    ScanSegment seg,
+    int rbegin,
+    int rend,
+    int width,
+    F&& pixel )
+{
+    if( !clip_segment( seg.a, seg.b, 0.0, rbegin, width, rend ) ) return;
+
+    double const dx = seg.b.x - seg.a.x, dy = seg.b.y - seg.a.y;
+    bool const xmajor = std::abs( dx ) >= std::abs( dy );
+    double const from = xmajor ? seg.a.x : seg.a.y;
+    double const to = xmajor ? seg.b.x : seg.b.y;
+    double const slope = xmajor ?
+        ( dx != 0.0 ? dy / dx : 0.0 ) : ( dy != 0.0 ? dx / dy : 0.0 );
+    int i0 = static_cast< int >( std::floor( std::min( from, to ) ) );
+    int i1 = static_cast< int >( std::floor( std::max( from, to ) ) );
+    for( int i = i0; i <= i1; ++i )
+    {
+        //Sample at the pixel center, clamped to the segment
+        double const t = std::min( std::max( i + 0.5, std::min( from, to ) ),
+            std::max( from, to ) );
+        double const o = ( xmajor ? seg.a.y : seg.a.x ) + ( t - from ) * slope;
+        int const r = xmajor ? static_cast< int >( std::floor( o ) ) : i;
+        int const c = xmajor ? i : static_cast< int >( std::floor( o ) );
+        if( r >= rbegin && r < rend && c >= 0 && c < width ) pixel( r, c );
+    }
+}
+
+///Calls span( r, c0, c1 ) for every run of pixels whose center lies inside the
+///polygon (even-odd rule), using an active edge table
+template< typename F >
+void scan_polygon(
+    ScanFeature const& f,
+    int rbegin,
+    int rend,
+    int width,
+    F&& span )
+{
+    auto const& edges = f.edges;
+    std::vector< ScanEdge const* > active;
+    std::vector< double > xs;
+    std::size_t next = 0;
+    int const rfirst = std::max( rbegin,
+        static_cast< int >( std::ceil( f.miny - 0.5 ) ) );
+    int const rlast = std::min( rend,
+        static_cast< int >( std::floor( f.maxy - 0.5 ) ) + 1 );
+    for( int r = rfirst; r < rlast; ++r )
+    {
+        double const yc = r + 0.5;
+        while( next < edges.size() && edges[ next ].top <= yc )
+        {
+            active.push_back( &edges[ next++ ] );
+        }
+        active.erase( std::remove_if( active.begin(), active.end(),
+            [ yc ]( ScanEdge const* e )
+            {
+                return ( e->bottom <= yc );
+            } ), active.end() );
+
+        xs.clear();
+        for( auto const* e : active )
+        {
+            xs.push_back( e->x + ( yc - e->top ) * e->dxdy );
+        }
+        std::sort( xs.begin(), xs.end() );
+        for( std::size_t i = 0; i + 1 < xs.size(); i += 2 )
+        {
+            int const c0 = std::max( 0,
+                static_cast< int >( std::ceil( xs[ i ] - 0.5 ) ) );
+            int const c1 = std::min( width,
+                static_cast< int >( std::ceil( xs[ i + 1 ] - 0.5 ) ) );
+            if( c0 < c1 ) span( r, c0, c1 );
+        }
+    }
+}
+
+} //end detail
+
+///Burns polygons, rings, multipolygons and lines given in the band's
+///georeferenced coordinates into a band. Features are burned in the order
+///they were added, in parallel across row bands.
+template< typename T >
+class Rasterizer
+{
+public:
+    ///
+    Rasterizer(
+        Band< T >& band,
+        BurnMode mode = BurnMode::Center )
+        :
+        m_band( band ),
+        m_mode( mode ),
+        m_features(),
+        m_values()
+    {
+        if( band.scalex() == 0.0 || band.scaley() == 0.0 )
+        {
+            throw std::runtime_error( "Rasterizer::Rasterizer: "
+                "band has no pixel scale" );
+        }
+    }
+
+    ///
+    template< typename V >
+    void add(
+        Polygon const& polygon,
+        V value )
+    {
+        detail::ScanFeature f = feature( value );
+        for( auto const& ring : polygon ) add_edges( f, ring );
+        push( std::move( f ) );
+    }
+
+    ///Fills ring as a polygon without holes
+    template< typename V >
+    void add(
+        Ring const& ring,
+        V value )
+    {
+        detail::ScanFeature f = feature( value );
+        add_edges( f, ring );
+        push( std::move( f ) );
+    }
+
+    ///
+    template< typename V >
+    void add(
+        MultiPolygon const& multipolygon,
+        V value )
+    {
+        for( auto const& polygon : multipolygon ) add( polygon, value );
+    }
+
+    ///
+    template< typename V >
+    void add(
+        LineString const& line,
+        V value )
+    {
+        detail::ScanFeature f = feature( value );
+        f.line = true;
+        for( std::size_t i = 0; i + 1 < line.size(); ++i )
+        {
+            f.segments.push_back( { pixel( line[ i ] ), pixel( line[ i + 1 ] ) } );
+        }
+        if( line.size() == 1 )
+        {
+            f.segments.push_back( { pixel( line[ 0 ] ), pixel( line[ 0 ] ) } );
+        }
+        push( std::move( f ) );
+    }
+
+    ///Number of queued features
+    std::size_t size() const
+    {
+        return m_features.size();
+    }
+
+    ///Burns and clears the queued features
+    void run()
+    {
+        GISRASTER_TRACE_SCOPE( "Rasterizer::run", m_band.size(), 0 );
+        int const width = m_band.width();
+        T* const data = m_band.data();
+        parallel_for( 0, m_band.height(),
+            [ this, width, data ]( int rbegin, int rend )
+            {
+                for( auto const& f : m_features )
+                {
+                    if( f.maxy < rbegin || f.miny >= rend ) continue;
+                    burn( f, rbegin, rend, width, data );
+                }
+            }, 64 );
+        m_features.clear();
+        m_values.clear();
+    }
+
+private:
+    ///
+    void burn(
+        detail::ScanFeature const& f,
+        int rbegin,
+        int rend,
+        int width,
+        T* data ) const
+    {
+        T const value = m_values[ f.value ];
+        auto set = [ data, width, value ]( int r, int c )
+        {
+            data[ static_cast< std::size_t >( r ) * width + c ] = value;
+        };
+
+        if( !f.line )
+        {
+            detail::scan_polygon( f, rbegin, rend, width,
+                [ data, width, value ]( int r, int c0, int c1 )
+                {
+                    T* row = data + static_cast< std::size_t >( r ) * width;
+                    std::fill( row + c0, row + c1, value );
+                } );
+        }
+        if( m_mode == BurnMode::AllTouched )
+        {
+            for( auto const& s : f.segments )
+            {
+                detail::trace_touched( s, rbegin, rend, width, set );
+            }
+        }
+        else if( f.line )
+        {
+            for( auto const& s : f.segments )
+            {
+                detail::trace_center( s, rbegin, rend, width, set );
+            }
+        }
+    }
+
+    ///Appends the outline and scan edges of ring to f
+    void add_edges(
+        detail::ScanFeature& f,
+        Ring const& ring ) const
+    {
+        if( ring.size() < 2 ) return;
+        for( std::size_t i = 0; i < ring.size(); ++i )
+        {
+            Point const a = pixel( ring[ i ] );
+            Point const b = pixel( ring[ ( i + 1 ) % ring.size() ] );
+            f.segments.push_back( { a, b } );
+            if( a.y == b.y ) continue;
+            detail::ScanEdge e;
+            bool const down = ( a.y < b.y );
+            Point const& t = down ? a : b;
+            Point const& o = down ? b : a;
+            e.top = t.y;
+            e.bottom = o.y;
+            e.x = t.x;
+            e.dxdy = ( o.x - t.x ) / ( o.y - t.y );
+            f.edges.push_back( e );
+        }
+    }
+
+    ///
+    template< typename V >
+    detail::ScanFeature feature(
+        V value )
+    {
+        detail::ScanFeature f;
+        f.value = m_values.size();
+        m_values.push_back( Band< T >::cast( value ) );
+        return f;
+    }
+
+    ///
+    void push(
+        detail::ScanFeature&& f )
+    {
+        for( auto const& s : f.segments )
+        {
+            f.miny = std::min( { f.miny, s.a.y, s.b.y } );
+            f.maxy = std::max( { f.maxy, s.a.y, s.b.y } );
+        }
+        if( f.segments.empty() )
+        {
+            m_values.pop_back();
+            return;
+        }
+        std::sort( f.edges.begin(), f.edges.end(),
+            []( detail::ScanEdge const& lhs, detail::ScanEdge const& rhs )
+            {
+                return ( lhs.top < rhs.top );
+            } );
+        m_features.push_back( std::move( f ) );
+    }
+
+    ///Georeferenced to fractional pixel coordinates
+    Point pixel(
+        Point const& p ) const
+    {
+        return {
+            ( p.x - m_band.upperleftx() ) / m_band.scalex(),
+            ( p.y - m_band.upperlefty() ) / m_band.scaley() };
+    }
+
+    ///
+    Band< T >& m_band;
+
+    ///
+    BurnMode m_mode;
+
+    ///
+    std::vector< detail::ScanFeature > m_features;
+
+    ///
+    std::vector< T > m_values;
+};
+
+///
+template< typename T, typename G, typename V >
+void rasterize(
+    Band< T >& band,
+    G const& geometry,
+    V value,
+    BurnMode mode = BurnMode::Center )
+{
+    Rasterizer< T > rasterizer( band, mode );
+    rasterizer.add( geometry, value );
+    rasterizer.run();
+}
+
+///
+template< typename T, typename G, typename V >
+void rasterize(
+    Band< T >& band,
+    std::vector< G > const& geometries,
+    std::vector< V > const& values,
+    BurnMode mode = BurnMode::Center )
+{
+    if( geometries.size() != values.size() )
+    {
+        throw std::runtime_error( "gis::rasterize: "
+            "geometry and value counts differ" );
+    }
+    Rasterizer< T > rasterizer( band, mode );
+    for( std::size_t i = 0; i < geometries.size(); ++i )
+    {
+        rasterizer.add( geometries[ i ], values[ i ] );
+    }
+    rasterizer.run();
+}
+
+} //end gis
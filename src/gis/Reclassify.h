@@ -0,0 +1,498 @@
+/*******************************************************************************
+ *
+ * MIT License
+ *
+ * Copyright (c) 2018 Joshua Koch
+ * 
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ * 
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ * 
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ *
+ ******************************************************************************/
+
+#pragma once
+
+#include <gis/Band.h>
+#include <gis/Parallel.h>
+
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <stdexcept>
+#include <type_traits>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+
+#if defined( __AVX2__ )
+#define GISRASTER_HAS_AVX2 1
+#include <immintrin.h>
+#endif
+
+namespace gis
+{
+
+namespace detail
+{
+
+///Pixels handed to each reclassification task
+static constexpr int ReclassBlock = 1 << 14;
+
+///True when T keys a dense lookup table
+template< typename T >
+struct is_dense_key : std::integral_constant< bool,
+    std::is_integral< T >::value && sizeof( T ) <= 2 >
+{
+};
+
+///Lookup table slot of v
+template< typename T >
+inline std::size_t lut_index(
+    T v,
+    std::true_type )
+{
+    return static_cast< typename std::make_unsigned< T >::type >( v );
+}
+
+///
+template< typename T >
+inline std::size_t lut_index(
+    T,
+    std::false_type )
+{
+    return 0;
+}
+
+///Looks up n pixels in a 256 or 65536 entry table; no kernel for this pair
+///of types, so none are done
+template< typename T, typename U >
+inline std::size_t lut_simd(
+    T const*,
+    std::size_t,
+    U const*,
+    U*,
+    std::integral_constant< int, 0 > )
+{
+    return 0;
+}
+
+#if defined( GISRASTER_HAS_AVX2 )
+///8 bit to 8 bit: 16 in-register shuffles, one per high nibble
+template< typename T, typename U >
+inline std::size_t lut_simd(
+    T const* src,
+    std::size_t n,
+    U const* lut,
+    U* dst,
+    std::integral_constant< int, 1 > )
+{
+    __m256i tables[ 16 ];
+    for( int h = 0; h < 16; ++h )
+    {
+        __m128i const t = _mm_loadu_si128(
+            reinterpret_cast< __m128i const* >( lut + 16 * h ) );
+        tables[ h ] = _mm256_broadcastsi128_si256( t );
+    }
+    __m256i const nibble = _mm256_set1_epi8( 0x0F );
+    std::size_t i = 0;
+    for( std::size_t const nv = n - n % 32; i < nv; i += 32 )
+    {
+        __m256i const v = _mm256_loadu_si256(
+            reinterpret_cast< __m256i const* >( src + i ) );
+        __m256i const lo = _mm256_and_si256( v, nibble );
+        __m256i const hi = _mm256_and_si256( _mm256_srli_epi16( v, 4 ), nibble );
+        __m256i result = _mm256_setzero_si256();
+        for( int h = 0; h < 16; ++h )
+        {
+            __m256i const hit = _mm256_cmpeq_epi8( hi, _mm256_set1_epi8(
+                static_cast< char >( h ) ) );
+            result = _mm256_blendv_epi8( result,
+                _mm256_shuffle_epi8( tables[ h ], lo ), hit );
+        }
+        _mm256_storeu_si256( reinterpret_cast< __m256i* >( dst + i ), result );
+    }
+    return i;
+}
+
+///8 or 16 bit to 32 bit: hardware gather
+template< typename T, typename U >
+inline std::size_t lut_simd(
+    T const* src,
+    std::size_t n,
+    U const* lut,
+    U* dst,
+    std::integral_constant< int, 2 > )
+{
+    int const* table = reinterpret_cast< int const* >( lut );
+    std::size_t i = 0;
+    for( std::size_t const nv = n - n % 8; i < nv; i += 8 )
+    {
+        __m256i idx;
+        if( sizeof( T ) == 1 )
+        {
+            idx = _mm256_cvtepu8_epi32( _mm_loadl_epi64(
+                reinterpret_cast< __m128i const* >( src + i ) ) );
+        }
+        else
+        {
+            idx = _mm256_cvtepu16_epi32( _mm_loadu_si128(
+                reinterpret_cast< __m128i const* >( src + i ) ) );
+        }
+        _mm256_storeu_si256( reinterpret_cast< __m256i* >( dst + i ),
+            _mm256_i32gather_epi32( table, idx, 4 ) );
+    }
+    return i;
+}
+#endif
+
+///Kernel lut_simd uses for T to U
+template< typename T, typename U >
+struct lut_kernel : std::integral_constant< int,
+#if defined( GISRASTER_HAS_AVX2 )
+    ( sizeof( T ) == 1 && sizeof( U ) == 1 ) ? 1 :
+    ( sizeof( U ) == 4 ) ? 2 :
+#endif
+    0 >
+{
+};
+
+} //end detail
+
+///Exact value reclassification table: pixels equal to a key take its value;
+///other valid pixels keep their value (converted, clamped) or take a
+///fallback. Integer types up to 16 bits use a dense table, others a hash map.
+template< typename T, typename U = T >
+class ValueMap
+{
+public:
+    ///
+    using Input = T;
+
+    ///
+    using Output = U;
+
+    ///Unmatched pixels keep their value
+    explicit ValueMap(
+        std::vector< std::pair< T, U > > const& pairs )
+        :
+        m_keep( true ),
+        m_other(),
+        m_lut(),
+        m_map()
+    {
+        build( pairs );
+    }
+
+    ///Unmatched pixels take other
+    ValueMap(
+        std::vector< std::pair< T, U > > const& pairs,
+        U other )
+        :
+        m_keep( false ),
+        m_other( other ),
+        m_lut(),
+        m_map()
+    {
+        build( pairs );
+    }
+
+    ///Writes the classes of src[0, n) to dst; nodata maps to outnodata
+    void apply(
+        T const* src,
+        std::size_t n,
+        T nodata,
+        U* dst,
+        U outnodata ) const
+    {
+        apply( src, n, nodata, dst, outnodata, Dense{} );
+    }
+
+    ///
+    U operator ()(
+        T v ) const
+    {
+        return lookup( v, Dense{} );
+    }
+
+private:
+    ///
+    using Dense = detail::is_dense_key< T >;
+
+    ///Hash key; 16 bit floats hash as float
+    using Key = typename std::conditional< is_half< T >::value, float, T >::type;
+
+    ///
+    U unmatched(
+        T v ) const
+    {
+        return m_keep ? Band< U >::cast( v, true ) : m_other;
+    }
+
+    ///
+    void build(
+        std::vector< std::pair< T, U > > const& pairs )
+    {
+        for( auto const& p : pairs )
+        {
+            Key const k = static_cast< Key >( p.first );
+            if( k != k ) throw std::invalid_argument(
+                "ValueMap::ValueMap: NaN cannot be a key" );
+        }
+        build( pairs, Dense{} );
+    }
+
+    ///
+    void build(
+        std::vector< std::pair< T, U > > const& pairs,
+        std::true_type )
+    {
+        std::size_t const slots = std::size_t( 1 ) << ( 8 * sizeof( T ) );
+        m_lut.resize( slots );
+        for( std::size_t i = 0; i < slots; ++i )
+        {
+            typename std::make_unsigned< T >::type const u =
+                static_cast< typename std::make_unsigned< T >::type >( i );
+            m_lut[ i ] = unmatched( static_cast< T >( u ) );
+        }
+        for( auto const& p : pairs )
+        {
+            m_lut[ detail::lut_index( p.first, Dense{} ) ] = p.second;
+        }
+    }
+
+    ///
+    void build(
+        std::vector< std::pair< T, U > > const& pairs,
+        std::false_type )
+    {
+        m_map.reserve( pairs.size() );
+        for( auto const& p : pairs )
+        {
+            m_map[ static_cast< Key >( p.first ) ] = p.second;
+        }
+    }
+
+    ///
+    U lookup(
+        T v,
+        std::true_type ) const
+    {
+        return m_lut[ detail::lut_index( v, Dense{} ) ];
+    }
+
+    ///
+    U lookup(
+        T v,
+        std::false_type ) const
+    {
+        auto const it = m_map.find( static_cast< Key >( v ) );
+        return ( it == m_map.end() ) ? unmatched( v ) : it->second;
+    }
+
+    ///Table lookups; nodata is patched into a copy of the table so the inner
+    ///loop is a plain gather
+    void apply(
+        T const* src,
+        std::size_t n,
+        T nodata,
+        U* dst,
+        U outnodata,
+        std::true_type ) const
+    {
+        Buffer< U > lut( m_lut.begin(), m_lut.end() );
+        lut[ detail::lut_index( nodata, Dense{} ) ] = outnodata;
+        U const* table = lut.data();
+        int const nblocks = static_cast< int >(
+            ( n + detail::ReclassBlock - 1 ) / detail::ReclassBlock );
+        parallel_for( 0, nblocks,
+            [ & ]( int begin, int end )
+            {
+                std::size_t const b = std::size_t( begin ) * detail::ReclassBlock;
+                std::size_t const e =
+                    std::min( n, std::size_t( end ) * detail::ReclassBlock );
+                std::size_t i = b + detail::lut_simd( src + b, e - b, table,
+                    dst + b, detail::lut_kernel< T, U >{} );
+                for( ; i < e; ++i )
+                {
+                    dst[ i ] = table[ detail::lut_index( src[ i ], Dense{} ) ];
+                }
+            } );
+    }
+
+    ///Hash lookups
+    void apply(
+        T const* src,
+        std::size_t n,
+        T nodata,
+        U* dst,
+        U outnodata,
+        std::false_type ) const
+    {
+        int const nblocks = static_cast< int >(
+            ( n + detail::ReclassBlock - 1 ) / detail::ReclassBlock );
+        parallel_for( 0, nblocks,
+            [ & ]( int begin, int end )
+            {
+                std::size_t const b = std::size_t( begin ) * detail::ReclassBlock;
+                std::size_t const e =
+                    std::min( n, std::size_t( end ) * detail::ReclassBlock );
+                for( std::size_t i = b; i < e; ++i )
+                {
+                    dst[ i ] = ( src[ i ] == nodata ) ?
+                        outnodata : lookup( src[ i ], std::false_type{} );
+                }
+            } );
+    }
+
+    ///
+    bool m_keep;
+
+    ///
+    U m_other;
+
+    ///Dense table indexed by the unsigned pixel bits
+    Buffer< U > m_lut;
+
+    ///
+    std::unordered_map< Key, U > m_map;
+};
+
+///Range reclassification table: breaks b0 < b1 < ... < bn-1 split the values
+///into n + 1 classes, v taking classes[ i ] for b(i-1) <= v < b(i)
+template< typename T, typename U = T >
+class Breaks
+{
+public:
+    ///
+    using Input = T;
+
+    ///
+    using Output = U;
+
+    ///
+    Breaks(
+        std::vector< T > breaks,
+        std::vector< U > classes )
+        :
+        m_breaks( std::move( breaks ) ),
+        m_classes( std::move( classes ) ),
+        m_steps()
+    {
+        if( m_breaks.empty() ) throw std::invalid_argument(
+            "Breaks::Breaks: no break points" );
+        if( m_classes.size() != m_breaks.size() + 1 ) throw std::invalid_argument(
+            "Breaks::Breaks: need one class more than break points" );
+        for( std::size_t i = 1; i < m_breaks.size(); ++i )
+        {
+            if( !( m_breaks[ i - 1 ] < m_breaks[ i ] ) ) throw std::invalid_argument(
+                "Breaks::Breaks: break points must be strictly increasing" );
+        }
+        for( std::size_t len = m_breaks.size(); len > 1; len -= len / 2 )
+        {
+            m_steps.push_back( len / 2 );
+        }
+    }
+
+    ///Class index of v: the number of break points <= v
+    std::size_t index(
+        T v ) const
+    {
+        T const* b = m_breaks.data();
+        std::size_t pos = 0;
+        for( std::size_t step : m_steps )
+        {
+            pos += ( b[ pos + step ] <= v ) ? step : 0;
+        }
+        return pos + ( b[ pos ] <= v );
+    }
+
+    ///
+    U operator ()(
+        T v ) const
+    {
+        return m_classes[ index( v ) ];
+    }
+
+    ///Writes the classes of src[0, n) to dst; nodata maps to outnodata
+    void apply(
+        T const* src,
+        std::size_t n,
+        T nodata,
+        U* dst,
+        U outnodata ) const
+    {
+        int const nblocks = static_cast< int >(
+            ( n + detail::ReclassBlock - 1 ) / detail::ReclassBlock );
+        parallel_for( 0, nblocks,
+            [ & ]( int begin, int end )
+            {
+                std::size_t const b = std::size_t( begin ) * detail::ReclassBlock;
+                std::size_t const e =
+                    std::min( n, std::size_t( end ) * detail::ReclassBlock );
+                std::size_t i = b;
+                for( ; i + Lanes <= e; i += Lanes ) search( src + i, nodata,
+                    dst + i, outnodata );
+                for( ; i < e; ++i )
+                {
+                    dst[ i ] = ( src[ i ] == nodata ) ?
+                        outnodata : m_classes[ index( src[ i ] ) ];
+                }
+            } );
+    }
+
+private:
+    ///Pixels searched together
+    static constexpr std::size_t Lanes = 8;
+
+    ///Interleaved branch free searches so the loads of Lanes pixels overlap
+    void search(
+        T const* src,
+        T nodata,
+        U* dst,
+        U outnodata ) const
+    {
+        T const* b = m_breaks.data();
+        std::size_t pos[ Lanes ] = {};
+        for( std::size_t step : m_steps )
+        {
+            for( std::size_t k = 0; k < Lanes; ++k )
+            {
+                pos[ k ] += ( b[ pos[ k ] + step ] <= src[ k ] ) ? step : 0;
+            }
+        }
+        for( std::size_t k = 0; k < Lanes; ++k )
+        {
+            U const c = m_classes[ pos[ k ] + ( b[ pos[ k ] ] <= src[ k ] ) ];
+            dst[ k ] = ( src[ k ] == nodata ) ? outnodata : c;
+        }
+    }
+
+    ///
+    std::vector< T > m_breaks;
+
+    ///
+    std::vector< U > m_classes;
+
+    ///Halving steps of the search, fixed by the number of break points
+    std::vector< std::size_t > m_steps;
+};
+
+///
+template< typename T, typename U >
+constexpr std::size_t Breaks< T, U >::Lanes;
+
+} //end gis
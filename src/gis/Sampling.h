@@ -0,0 +1,231 @@
+/*******************************************************************************
+ *
+ * MIT License
+ *
+ * Copyright (c) 2018 Joshua Koch
+ * 
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ * 
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ * 
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ *
+ ******************************************************************************/
+
+#pragma once
+
+#include <gis/Band.h>
+#include <gis/Geometry.h>
+#include <gis/MortonBand.h>
+#include <gis/Parallel.h>
+
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <limits>
+#include <stdexcept>
+#include <utility>
+#include <vector>
+
+namespace gis
+{
+
+///
+enum class Interpolation
+{
+    ///Value of the pixel containing the point
+    Nearest,
+
+    ///Weighted from the four nearest pixel centers; nodata neighbors are left
+    ///out and the weights renormalized
+    Bilinear
+};
+
+namespace detail
+{
+
+///Points handed to each sampling task
+static constexpr int SampleGrain = 4096;
+
+///Z-order key of a point and its position in the input
+using SampleKey = std::pair< std::uint64_t, std::size_t >;
+
+///Sorts chunks in parallel, then merges neighboring runs in parallel rounds
+inline void parallel_sort(
+    std::vector< SampleKey >& keys )
+{
+    int const n = static_cast< int >( keys.size() );
+    int const nruns = std::max( 1, std::min( static_cast< int >( thread_count() ),
+        n / SampleGrain ) );
+    std::vector< int > bounds( nruns + 1 );
+    for( int i = 0; i <= nruns; ++i )
+    {
+        bounds[ i ] = static_cast< int >( static_cast< long long >( n ) * i / nruns );
+    }
+    parallel_for( 0, nruns, [ & ]( int begin, int end )
+        {
+            for( int i = begin; i < end; ++i )
+            {
+                std::sort( keys.begin() + bounds[ i ], keys.begin() + bounds[ i + 1 ] );
+            }
+        } );
+    for( int width = 1; width < nruns; width *= 2 )
+    {
+        int const merges = ( nruns + 2 * width - 1 ) / ( 2 * width );
+        parallel_for( 0, merges, [ & ]( int begin, int end )
+            {
+                for( int m = begin; m < end; ++m )
+                {
+                    int const lo = 2 * width * m;
+                    int const mid = std::min( nruns, lo + width );
+                    int const hi = std::min( nruns, lo + 2 * width );
+                    std::inplace_merge( keys.begin() + bounds[ lo ],
+                        keys.begin() + bounds[ mid ], keys.begin() + bounds[ hi ] );
+                }
+            } );
+    }
+}
+
+} //end detail
+
+///Samples band at the n points ( xs[ i ], ys[ i ] ), given in the band's
+///georeferenced coordinates, writing out[ i ]. Points are visited in Z-order
+///of the pixels they fall in so that neighbors share cache lines and pages;
+///results land in input order. Points outside the band or on nodata get
+///nodata.
+template< typename R, typename T >
+void sample(
+    Band< T > const& band,
+    double const* xs,
+    double const* ys,
+    std::size_t n,
+    R* out,
+    Interpolation mode,
+    R nodata )
+{
+    if( band.scalex() == 0.0 || band.scaley() == 0.0 )
+    {
+        throw std::runtime_error( "gis::sample: band has no pixel scale" );
+    }
+    GISRASTER_TRACE_SCOPE( "sample", n, n * sizeof( detail::SampleKey ) );
+    int const w = band.width(), h = band.height();
+    double const ulx = band.upperleftx(), uly = band.upperlefty();
+    double const sx = band.scalex(), sy = band.scaley();
+    T const* const data = band.data();
+    T const nd = band.nodatavalue();
+    std::uint64_t constexpr Outside = std::numeric_limits< std::uint64_t >::max();
+
+    //Pixel keys; outside points sort last
+    std::vector< detail::SampleKey > keys( n );
+    int const nblocks = static_cast< int >( ( n + detail::SampleGrain - 1 ) /
+        detail::SampleGrain );
+    parallel_for( 0, nblocks, [ & ]( int begin, int end )
+        {
+            std::size_t const b = std::size_t( begin ) * detail::SampleGrain;
+            std::size_t const e = std::min( n, std::size_t( end ) * detail::SampleGrain );
+            for( std::size_t i = b; i < e; ++i )
+            {
+                double const col = ( xs[ i ] - ulx ) / sx;
+                double const row = ( ys[ i ] - uly ) / sy;
+                bool const inside = ( col >= 0.0 && col < w && row >= 0.0 && row < h );
+                std::uint32_t const r = inside ? static_cast< std::uint32_t >( row ) : 0;
+                std::uint32_t const c = inside ? static_cast< std::uint32_t >( col ) : 0;
+                keys[ i ] = { inside ? morton_encode( r, c ) : Outside, i };
+            }
+        } );
+    detail::parallel_sort( keys );
+
+    parallel_for( 0, nblocks, [ & ]( int begin, int end )
+        {
+            std::size_t const b = std::size_t( begin ) * detail::SampleGrain;
+            std::size_t const e = std::min( n, std::size_t( end ) * detail::SampleGrain );
+            for( std::size_t k = b; k < e; ++k )
+            {
+                std::size_t const i = keys[ k ].second;
+                if( keys[ k ].first == Outside )
+                {
+                    out[ i ] = nodata;
+                    continue;
+                }
+                double const col = ( xs[ i ] - ulx ) / sx;
+                double const row = ( ys[ i ] - uly ) / sy;
+                if( mode == Interpolation::Nearest )
+                {
+                    T const v = data[ static_cast< std::size_t >( row ) * w +
+                        static_cast< std::size_t >( col ) ];
+                    out[ i ] = ( v == nd ) ? nodata : static_cast< R >( v );
+                    continue;
+                }
+
+                double const fc = col - 0.5, fr = row - 0.5;
+                double const c0 = std::floor( fc ), r0 = std::floor( fr );
+                double const tx = fc - c0, ty = fr - r0;
+                int const cs[ 2 ] = { std::max( 0, static_cast< int >( c0 ) ),
+                    std::min( w - 1, static_cast< int >( c0 ) + 1 ) };
+                int const rs[ 2 ] = { std::max( 0, static_cast< int >( r0 ) ),
+                    std::min( h - 1, static_cast< int >( r0 ) + 1 ) };
+                double const wc[ 2 ] = { 1.0 - tx, tx };
+                double const wr[ 2 ] = { 1.0 - ty, ty };
+                double sum = 0.0, weight = 0.0;
+                for( int a = 0; a < 2; ++a )
+                {
+                    for( int bb = 0; bb < 2; ++bb )
+                    {
+                        T const v = data[ static_cast< std::size_t >( rs[ a ] ) * w + cs[ bb ] ];
+                        double const wt = ( v == nd ) ? 0.0 : wr[ a ] * wc[ bb ];
+                        sum += ( v == nd ) ? 0.0 : wt * static_cast< double >( v );
+                        weight += wt;
+                    }
+                }
+                out[ i ] = ( weight > 0.0 ) ? static_cast< R >( sum / weight ) : nodata;
+            }
+        } );
+}
+
+///Samples band at every ( xs[ i ], ys[ i ] ); see sample above
+template< typename R = double, typename T >
+std::vector< R > sample(
+    Band< T > const& band,
+    std::vector< double > const& xs,
+    std::vector< double > const& ys,
+    Interpolation mode = Interpolation::Nearest )
+{
+    if( xs.size() != ys.size() )
+    {
+        throw std::runtime_error( "gis::sample: coordinate counts differ" );
+    }
+    std::vector< R > result( xs.size() );
+    sample( band, xs.data(), ys.data(), xs.size(), result.data(), mode,
+        static_cast< R >( band.nodatavalue() ) );
+    return result;
+}
+
+///Samples band at every point; see sample above
+template< typename R = double, typename T >
+std::vector< R > sample(
+    Band< T > const& band,
+    std::vector< Point > const& points,
+    Interpolation mode = Interpolation::Nearest )
+{
+    std::vector< double > xs( points.size() ), ys( points.size() );
+    for( std::size_t i = 0; i < points.size(); ++i )
+    {
+        xs[ i ] = points[ i ].x;
+        ys[ i ] = points[ i ].y;
+    }
+    return sample< R >( band, xs, ys, mode );
+}
+
+} //end gis
@@ -0,0 +1,455 @@
+/*******************************************************************************
+ *
+ * MIT License
+ *
+ * Copyright (c) 2018 Joshua Koch
+ * 
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ * 
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ * 
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ *
+ ******************************************************************************/
+
+#pragma once
+
+#include <gis/Band.h>
+#include <gis/Memory.h>
+#include <gis/Parallel.h>
+#include <gis/Trace.h>
+
+#include <algorithm>
+#include <atomic>
+#include <memory>
+#include <stdexcept>
+#include <unordered_set>
+#include <vector>
+
+namespace gis
+{
+
+///Band whose pixels live in square tiles shared between copies. Copying is
+///O(1); the first write to a tile after a copy duplicates that tile only,
+///so snapshots cost the tiles changed since. Copies may be read and written
+///from different threads; one object is not written from several threads
+///at once.
+template< typename T >
+class SharedBand
+{
+public:
+    ///TileSize x TileSize pixels, row-major; padding pixels are unspecified
+    using Tile = Buffer< T >;
+
+    ///
+    static constexpr int TileShift = 8;
+
+    ///
+    static constexpr int TileSize = 1 << TileShift;
+
+    ///constructor; every tile shares one buffer until written
+    template< typename N, typename V >
+    SharedBand(
+        int width,
+        int height,
+        N nodataval,
+        V initval )
+        :
+        m_upperleftx( 0.0 ),
+        m_upperlefty( 0.0 ),
+        m_width( width ),
+        m_height( height ),
+        m_srid( 0 ),
+        m_scalex( 0.0 ),
+        m_scaley( 0.0 ),
+        m_nodatavalue( Band< T >::cast( nodataval ) ),
+        m_across( tiles( width ) ),
+        m_table( std::make_shared< Table >() )
+    {
+        static_assert( std::is_arithmetic< N >::value,
+            "Nodata value must be an arithmetic type" );
+        static_assert( std::is_arithmetic< V >::value,
+            "Initial value must be an arithmetic type" );
+        std::size_t const n = static_cast< std::size_t >( m_across ) * tiles( height );
+        if( n != 0 )
+        {
+            auto const tile = std::make_shared< Tile >(
+                static_cast< std::size_t >( TileSize ) * TileSize,
+                Band< T >::cast( initval ) );
+            m_table->tiles.assign( n, tile );
+        }
+    }
+
+    ///constructor
+    template< typename N >
+    SharedBand(
+        int width,
+        int height,
+        N nodataval )
+        :
+        SharedBand( width, height, nodataval, nodataval )
+    {
+        ;
+    }
+
+    ///constructor
+    SharedBand()
+        :
+        SharedBand( 0, 0, Band< T >::Lowest )
+    {
+        ;
+    }
+
+    ///Tiled copy of a row-major band
+    explicit SharedBand(
+        Band< T > const& o )
+        :
+        m_upperleftx( o.upperleftx() ),
+        m_upperlefty( o.upperlefty() ),
+        m_width( o.width() ),
+        m_height( o.height() ),
+        m_srid( o.srid() ),
+        m_scalex( o.scalex() ),
+        m_scaley( o.scaley() ),
+        m_nodatavalue( o.nodatavalue() ),
+        m_across( tiles( o.width() ) ),
+        m_table( std::make_shared< Table >() )
+    {
+        GISRASTER_TRACE_SCOPE( "SharedBand::convert", o.size(), o.bytes() );
+        int const down = tiles( m_height );
+        m_table->tiles.resize( static_cast< std::size_t >( m_across ) * down );
+        T const* src = o.data();
+        parallel_for( 0, down,
+            [ & ]( int begin, int end )
+            {
+                for( int tr = begin; tr < end; ++tr )
+                {
+                    for( int tc = 0; tc < m_across; ++tc )
+                    {
+                        auto tile = std::make_shared< Tile >(
+                            static_cast< std::size_t >( TileSize ) * TileSize,
+                            m_nodatavalue );
+                        int const r0 = tr * TileSize;
+                        int const c0 = tc * TileSize;
+                        int const cols = std::min( TileSize, m_width - c0 );
+                        for( int r = r0; r < std::min( r0 + TileSize, m_height ); ++r )
+                        {
+                            T const* row = src + static_cast< std::size_t >( r ) * m_width + c0;
+                            std::copy( row, row + cols, tile->data() +
+                                static_cast< std::size_t >( r - r0 ) * TileSize );
+                        }
+                        m_table->tiles[ static_cast< std::size_t >( tr ) * m_across + tc ] =
+                            std::move( tile );
+                    }
+                }
+            } );
+    }
+
+    ///
+    bool oor(
+        int r,
+        int c ) const
+    {
+        return !( r >= 0 && r < m_height && c >= 0 && c < m_width );
+    }
+
+    ///
+    T operator ()(
+        int r,
+        int c ) const
+    {
+        if( oor( r, c ) ) throw std::out_of_range(
+            "SharedBand::operator(): out of range" );
+        return m_table->tiles[ tile_index( r, c ) ]->data()[ offset( r, c ) ];
+    }
+
+    ///Writes one pixel, duplicating its tile if it is shared
+    void set(
+        int r,
+        int c,
+        T val )
+    {
+        if( oor( r, c ) ) throw std::out_of_range(
+            "SharedBand::set: out of range" );
+        tile_data( tile_index( r, c ) )[ offset( r, c ) ] = val;
+    }
+
+    ///Sets the pixels of rows [r0, r1) and columns [c0, c1), clipped to the
+    ///band; only the tiles touched are duplicated
+    void fill(
+        int r0,
+        int c0,
+        int r1,
+        int c1,
+        T val )
+    {
+        r0 = std::max( r0, 0 );
+        c0 = std::max( c0, 0 );
+        r1 = std::min( r1, m_height );
+        c1 = std::min( c1, m_width );
+        for( int tr = r0 >> TileShift; r0 < r1 && tr <= ( r1 - 1 ) >> TileShift; ++tr )
+        {
+            for( int tc = c0 >> TileShift; c0 < c1 && tc <= ( c1 - 1 ) >> TileShift; ++tc )
+            {
+                T* tile = tile_data( static_cast< std::size_t >( tr ) * m_across + tc );
+                int const rb = std::max( r0, tr * TileSize );
+                int const re = std::min( r1, ( tr + 1 ) * TileSize );
+                int const cb = std::max( c0, tc * TileSize );
+                int const ce = std::min( c1, ( tc + 1 ) * TileSize );
+                for( int r = rb; r < re; ++r )
+                {
+                    std::fill( tile + offset( r, cb ), tile + offset( r, ce - 1 ) + 1, val );
+                }
+            }
+        }
+    }
+
+    ///Number of tiles
+    std::size_t tile_count() const
+    {
+        return m_table->tiles.size();
+    }
+
+    ///Tiles per tile row
+    int tiles_across() const
+    {
+        return m_across;
+    }
+
+    ///Pixels of tile t, TileSize per row
+    T const* tile_data(
+        std::size_t t ) const
+    {
+        return m_table->tiles.at( t )->data();
+    }
+
+    ///Writable pixels of tile t, duplicated first if another band shares it
+    T* tile_data(
+        std::size_t t )
+    {
+        if( t >= tile_count() ) throw std::out_of_range(
+            "SharedBand::tile_data: no such tile" );
+        if( !owned( m_table ) ) m_table = std::make_shared< Table >( *m_table );
+        std::shared_ptr< Tile >& tile = m_table->tiles[ t ];
+        if( !owned( tile ) ) tile = std::make_shared< Tile >( *tile );
+        return tile->data();
+    }
+
+    ///Number of tiles whose pixels are physically shared with o
+    std::size_t shared_tiles(
+        SharedBand const& o ) const
+    {
+        if( m_table == o.m_table ) return tile_count();
+        std::size_t n = 0;
+        for( std::size_t t = 0; t < std::min( tile_count(), o.tile_count() ); ++t )
+        {
+            n += ( m_table->tiles[ t ] == o.m_table->tiles[ t ] );
+        }
+        return n;
+    }
+
+    ///Writes the pixels to out in row-major order
+    void unpack(
+        T* out ) const
+    {
+        GISRASTER_TRACE_SCOPE( "SharedBand::unpack", size(), size() * sizeof( T ) );
+        parallel_for( 0, m_height,
+            [ & ]( int begin, int end )
+            {
+                for( int r = begin; r < end; ++r )
+                {
+                    T* row = out + static_cast< std::size_t >( r ) * m_width;
+                    for( int tc = 0; tc < m_across; ++tc )
+                    {
+                        T const* src = tile_data( tile_index( r, tc * TileSize ) ) +
+                            offset( r, 0 );
+                        int const c0 = tc * TileSize;
+                        std::copy( src, src + std::min( TileSize, m_width - c0 ), row + c0 );
+                    }
+                }
+            }, TileSize );
+    }
+
+    ///Number of pixels
+    std::size_t size() const
+    {
+        return static_cast< std::size_t >( m_width ) * m_height;
+    }
+
+    ///Bytes of the distinct tiles this band references
+    std::size_t bytes() const
+    {
+        std::unordered_set< Tile const* > distinct;
+        for( auto const& tile : m_table->tiles ) distinct.insert( tile.get() );
+        return distinct.size() * sizeof( T ) * TileSize * TileSize;
+    }
+
+    ///
+    double upperleftx() const
+    {
+        return m_upperleftx;
+    }
+    void upperleftx(
+        double val )
+    {
+        m_upperleftx = val;
+    }
+
+    ///
+    double upperlefty() const
+    {
+        return m_upperlefty;
+    }
+    void upperlefty(
+        double val )
+    {
+        m_upperlefty = val;
+    }
+
+    ///
+    int width() const
+    {
+        return m_width;
+    }
+
+    ///
+    int height() const
+    {
+        return m_height;
+    }
+
+    ///
+    int srid() const
+    {
+        return m_srid;
+    }
+    void srid(
+        int val )
+    {
+        m_srid = val;
+    }
+
+    ///
+    double scalex() const
+    {
+        return m_scalex;
+    }
+    void scalex(
+        double val )
+    {
+        m_scalex = val;
+    }
+
+    ///
+    double scaley() const
+    {
+        return m_scaley;
+    }
+    void scaley(
+        double val )
+    {
+        m_scaley = val;
+    }
+
+    ///
+    T nodatavalue() const
+    {
+        return m_nodatavalue;
+    }
+
+private:
+    ///Shared by copies until one of them writes
+    struct Table
+    {
+        std::vector< std::shared_ptr< Tile > > tiles;
+    };
+
+    ///
+    static int tiles(
+        int n )
+    {
+        return ( std::max( n, 0 ) + TileSize - 1 ) >> TileShift;
+    }
+
+    ///True when p is the only reference; the fence pairs with the release
+    ///of the reference count by the last other owner, so its reads of the
+    ///pixels happen before our writes
+    template< typename P >
+    static bool owned(
+        std::shared_ptr< P > const& p )
+    {
+        if( p.use_count() != 1 ) return false;
+        std::atomic_thread_fence( std::memory_order_acquire );
+        return true;
+    }
+
+    ///
+    std::size_t tile_index(
+        int r,
+        int c ) const
+    {
+        return static_cast< std::size_t >( r >> TileShift ) * m_across +
+            static_cast< std::size_t >( c >> TileShift );
+    }
+
+    ///Position of ( r, c ) inside its tile
+    static std::size_t offset(
+        int r,
+        int c )
+    {
+        return static_cast< std::size_t >( r & ( TileSize - 1 ) ) * TileSize +
+            static_cast< std::size_t >( c & ( TileSize - 1 ) );
+    }
+
+    ///
+    double m_upperleftx;
+
+    ///
+    double m_upperlefty;
+
+    ///
+    int m_width;
+
+    ///
+    int m_height;
+
+    ///
+    int m_srid;
+
+    ///
+    double m_scalex;
+
+    ///
+    double m_scaley;
+
+    ///
+    T m_nodatavalue;
+
+    ///
+    int m_across;
+
+    ///
+    std::shared_ptr< Table > m_table;
+};
+
+///
+template< typename T >
+constexpr int SharedBand< T >::TileShift;
+
+///
+template< typename T >
+constexpr int SharedBand< T >::TileSize;
+
+} //end gis
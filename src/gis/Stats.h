@@ -0,0 +1,414 @@
+/*******************************************************************************
+ *
+ * MIT License
+ *
+ * Copyright (c) 2018 Joshua Koch
+ * 
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ * 
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ * 
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ *
+ ******************************************************************************/
+
+#pragma once
+
+#include <gis/Parallel.h>
+
+#include <algorithm>
+#include <atomic>
+#include <cstdint>
+#include <limits>
+#include <memory>
+#include <mutex>
+#include <stdexcept>
+#include <type_traits>
+#include <utility>
+#include <vector>
+
+namespace gis
+{
+
+///Count, extremes and sum of the valid pixels of a range
+template< typename T >
+struct Summary
+{
+    ///Sum type wide enough not to overflow on a band
+    using Accum = typename std::conditional< std::is_integral< T >::value,
+        typename std::conditional< std::is_signed< T >::value,
+            long long, unsigned long long >::type,
+        double >::type;
+
+    ///
+    std::size_t count = 0;
+
+    ///Undefined when count is 0
+    T min = T();
+
+    ///Undefined when count is 0
+    T max = T();
+
+    ///
+    Accum sum = 0;
+
+    ///
+    void merge(
+        Summary const& o )
+    {
+        if( o.count == 0 ) return;
+        if( count == 0 )
+        {
+            min = o.min;
+            max = o.max;
+        }
+        else
+        {
+            if( o.min < min ) min = o.min;
+            if( max < o.max ) max = o.max;
+        }
+        count += o.count;
+        sum += o.sum;
+    }
+};
+
+namespace detail
+{
+
+///Pixel range reductions used by Band; specialized for pixel types that are
+///not plain arithmetic
+template< typename T >
+struct Reduce
+{
+    ///Merges the summary of the valid pixels of [p, p + n) into s
+    static void summarize(
+        T const* p,
+        std::size_t n,
+        T nodata,
+        Summary< T >& s )
+    {
+        summarize_if( p, n, [ nodata ]( T v, std::size_t )
+            {
+                return v != nodata;
+            }, s );
+    }
+
+    ///Same for the pixels for which valid( value, index ) holds; a test
+    ///that is always true leaves a plain min/max/sum loop
+    template< typename V >
+    static void summarize_if(
+        T const* p,
+        std::size_t n,
+        V valid_at,
+        Summary< T >& s )
+    {
+        using Accum = typename Summary< T >::Accum;
+        Summary< T > r;
+        T lo = std::numeric_limits< T >::max();
+        T hi = std::numeric_limits< T >::lowest();
+        std::size_t count = 0;
+        Accum sum = 0;
+        //Branch free so the loop vectorizes
+        for( std::size_t i = 0; i < n; ++i )
+        {
+            T const v = p[ i ];
+            bool const valid = valid_at( v, i );
+            count += valid;
+            sum += valid ? static_cast< Accum >( v ) : Accum( 0 );
+            lo = ( valid && v < lo ) ? v : lo;
+            hi = ( valid && hi < v ) ? v : hi;
+        }
+        r.count = count;
+        r.min = lo;
+        r.max = hi;
+        r.sum = sum;
+        s.merge( r );
+    }
+};
+
+///Per tile summaries of a band, recomputed only for tiles written since the
+///last query
+template< typename T >
+class StatsCache
+{
+public:
+    ///Tiles are TileSize x TileSize pixels
+    static constexpr int TileShift = 8;
+    static constexpr int TileSize = 1 << TileShift;
+
+    ///
+    StatsCache()
+        :
+        m_mutex(),
+        m_built( false ),
+        m_across( 0 ),
+        m_tiles(),
+        m_dirty()
+    {
+        ;
+    }
+
+    ///
+    StatsCache(
+        StatsCache const& o )
+        :
+        StatsCache()
+    {
+        copy( o );
+    }
+
+    ///
+    StatsCache& operator =(
+        StatsCache const& o )
+    {
+        if( this != &o ) copy( o );
+        return *this;
+    }
+
+    ///
+    StatsCache(
+        StatsCache&& o ) noexcept
+        :
+        StatsCache()
+    {
+        swap( o );
+    }
+
+    ///
+    StatsCache& operator =(
+        StatsCache&& o ) noexcept
+    {
+        if( this != &o )
+        {
+            invalidate();
+            swap( o );
+        }
+        return *this;
+    }
+
+    ///Records a write to pixel ( r, c )
+    void mark(
+        int r,
+        int c )
+    {
+        if( !m_built.load( std::memory_order_relaxed ) ) return;
+        m_dirty[ static_cast< std::size_t >( r >> TileShift ) * m_across +
+            ( c >> TileShift ) ].store( 1, std::memory_order_relaxed );
+    }
+
+    ///Records a write to pixel i of a band width pixels wide
+    void mark(
+        std::size_t i,
+        int width )
+    {
+        mark( static_cast< int >( i / width ), static_cast< int >( i % width ) );
+    }
+
+    ///Records a write to any pixel, or a change of size or nodata
+    void invalidate()
+    {
+        m_built.store( false );
+    }
+
+    ///Number of tiles that will be recomputed by the next query
+    std::size_t dirty() const
+    {
+        std::lock_guard< std::mutex > lock( m_mutex );
+        if( !m_built.load() ) return m_tiles.size();
+        std::size_t result = 0;
+        for( std::size_t i = 0; i < m_tiles.size(); ++i )
+        {
+            result += m_dirty[ i ].load( std::memory_order_relaxed );
+        }
+        return result;
+    }
+
+    ///Summary of the valid pixels of data, a width x height band
+    Summary< T > summary(
+        T const* data,
+        int width,
+        int height,
+        T nodata ) const
+    {
+        return summary( width, height, sentinel( data, nodata ) );
+    }
+
+    ///Summary of a width x height band whose pixels reduce( i, n, s )
+    ///merges into s for the n pixels from index i
+    template< typename R >
+    Summary< T > summary(
+        int width,
+        int height,
+        R reduce ) const
+    {
+        std::lock_guard< std::mutex > lock( m_mutex );
+        refresh( width, height, reduce );
+        Summary< T > result;
+        for( auto const& s : m_tiles ) result.merge( s );
+        return result;
+    }
+
+    ///Up to date summaries of every tile, row-major
+    std::vector< Summary< T > > tiles(
+        T const* data,
+        int width,
+        int height,
+        T nodata ) const
+    {
+        return tiles( width, height, sentinel( data, nodata ) );
+    }
+
+    ///
+    template< typename R >
+    std::vector< Summary< T > > tiles(
+        int width,
+        int height,
+        R reduce ) const
+    {
+        std::lock_guard< std::mutex > lock( m_mutex );
+        refresh( width, height, reduce );
+        return m_tiles;
+    }
+
+    ///Installs tile summaries computed elsewhere for a width x height band
+    void seed(
+        std::vector< Summary< T > > tiles,
+        int width,
+        int height )
+    {
+        int const across = ( width + TileSize - 1 ) >> TileShift;
+        int const down = ( height + TileSize - 1 ) >> TileShift;
+        std::size_t const ntiles = static_cast< std::size_t >( across ) * down;
+        if( tiles.size() != ntiles ) throw std::invalid_argument(
+            "StatsCache::seed: wrong number of tiles" );
+        std::lock_guard< std::mutex > lock( m_mutex );
+        m_across = across;
+        m_tiles = std::move( tiles );
+        m_dirty.reset( new std::atomic< std::uint8_t >[ ntiles ] );
+        for( std::size_t i = 0; i < ntiles; ++i ) m_dirty[ i ].store( 0 );
+        m_built.store( true );
+    }
+
+private:
+    ///
+    static auto sentinel(
+        T const* data,
+        T nodata )
+    {
+        return [ data, nodata ]( std::size_t i, std::size_t n, Summary< T >& s )
+        {
+            Reduce< T >::summarize( data + i, n, nodata, s );
+        };
+    }
+
+    ///Recomputes the dirty tiles; the caller holds m_mutex
+    template< typename R >
+    void refresh(
+        int width,
+        int height,
+        R& reduce ) const
+    {
+        int const across = ( width + TileSize - 1 ) >> TileShift;
+        int const down = ( height + TileSize - 1 ) >> TileShift;
+        std::size_t const ntiles = static_cast< std::size_t >( across ) * down;
+        if( !m_built.load() )
+        {
+            m_across = across;
+            m_tiles.assign( ntiles, Summary< T >() );
+            m_dirty.reset( new std::atomic< std::uint8_t >[ ntiles ] );
+            for( std::size_t i = 0; i < ntiles; ++i ) m_dirty[ i ].store( 1 );
+            m_built.store( true );
+        }
+
+        std::vector< std::size_t > stale;
+        for( std::size_t i = 0; i < ntiles; ++i )
+        {
+            //Cleared before recomputing so concurrent writes mark it again
+            if( m_dirty[ i ].exchange( 0, std::memory_order_relaxed ) )
+            {
+                stale.push_back( i );
+            }
+        }
+        parallel_for( 0, static_cast< int >( stale.size() ),
+            [ & ]( int begin, int end )
+            {
+                for( int k = begin; k < end; ++k )
+                {
+                    std::size_t const t = stale[ k ];
+                    int const r0 = static_cast< int >( t / across ) * TileSize;
+                    int const c0 = static_cast< int >( t % across ) * TileSize;
+                    int const r1 = std::min( height, r0 + TileSize );
+                    int const c1 = std::min( width, c0 + TileSize );
+                    std::size_t const n = static_cast< std::size_t >( c1 - c0 );
+                    Summary< T > s;
+                    for( int r = r0; r < r1; ++r )
+                    {
+                        reduce( static_cast< std::size_t >( r ) * width + c0, n, s );
+                    }
+                    m_tiles[ t ] = s;
+                }
+            }, 16 );
+    }
+
+    ///
+    void copy(
+        StatsCache const& o )
+    {
+        std::lock( m_mutex, o.m_mutex );
+        std::lock_guard< std::mutex > lock( m_mutex, std::adopt_lock );
+        std::lock_guard< std::mutex > olock( o.m_mutex, std::adopt_lock );
+        m_built.store( false );
+        if( !o.m_built.load() ) return;
+        m_across = o.m_across;
+        m_tiles = o.m_tiles;
+        m_dirty.reset( new std::atomic< std::uint8_t >[ m_tiles.size() ] );
+        for( std::size_t i = 0; i < m_tiles.size(); ++i )
+        {
+            m_dirty[ i ].store( o.m_dirty[ i ].load() );
+        }
+        m_built.store( true );
+    }
+
+    ///
+    void swap(
+        StatsCache& o )
+    {
+        bool const built = o.m_built.load();
+        o.m_built.store( m_built.load() );
+        m_built.store( built );
+        std::swap( m_across, o.m_across );
+        m_tiles.swap( o.m_tiles );
+        m_dirty.swap( o.m_dirty );
+    }
+
+    ///
+    mutable std::mutex m_mutex;
+
+    ///
+    mutable std::atomic< bool > m_built;
+
+    ///Tiles per tile row
+    mutable int m_across;
+
+    ///
+    mutable std::vector< Summary< T > > m_tiles;
+
+    ///
+    mutable std::unique_ptr< std::atomic< std::uint8_t >[] > m_dirty;
+};
+
+} //end detail
+
+} //end gis
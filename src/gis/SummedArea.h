@@ -0,0 +1,494 @@
+/*******************************************************************************
+ *
+ * MIT License
+ *
+ * Copyright (c) 2018 Joshua Koch
+ * 
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ * 
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ * 
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ *
+ ******************************************************************************/
+
+#pragma once
+
+#include <gis/Band.h>
+#include <gis/Memory.h>
+#include <gis/Parallel.h>
+
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <limits>
+#include <stdexcept>
+#include <type_traits>
+
+namespace gis
+{
+
+///Unevaluated sum hi + lo carrying about 106 bits, so that the differences
+///of large prefix sums keep their low order digits
+struct DoubleDouble
+{
+    ///
+    double hi;
+
+    ///
+    double lo;
+
+    ///
+    DoubleDouble(
+        double val = 0.0 )
+        :
+        hi( val ),
+        lo( 0.0 )
+    {
+        ;
+    }
+
+    ///
+    DoubleDouble(
+        double h,
+        double l )
+        :
+        hi( h ),
+        lo( l )
+    {
+        ;
+    }
+
+    ///Exact product of two doubles
+    static DoubleDouble product(
+        double a,
+        double b )
+    {
+        double const p = a * b;
+        return DoubleDouble( p, std::fma( a, b, -p ) );
+    }
+
+    ///
+    explicit operator double() const
+    {
+        return hi + lo;
+    }
+
+    ///
+    DoubleDouble& operator +=(
+        DoubleDouble const& o )
+    {
+        //Knuth's two-sum on the high parts, then renormalize
+        double const s = hi + o.hi;
+        double const bb = s - hi;
+        double const err = ( hi - ( s - bb ) ) + ( o.hi - bb );
+        double const l = err + lo + o.lo;
+        hi = s + l;
+        lo = l - ( hi - s );
+        return *this;
+    }
+
+    ///
+    DoubleDouble& operator -=(
+        DoubleDouble const& o )
+    {
+        return *this += DoubleDouble( -o.hi, -o.lo );
+    }
+};
+
+///
+inline DoubleDouble operator +(
+    DoubleDouble lhs,
+    DoubleDouble const& rhs )
+{
+    return lhs += rhs;
+}
+
+///
+inline DoubleDouble operator -(
+    DoubleDouble lhs,
+    DoubleDouble const& rhs )
+{
+    return lhs -= rhs;
+}
+
+///Integral image of a band: prefix tables of the valid pixel sum, count and
+///(optionally) sum of squares, giving the sum, count, mean and variance of
+///any rectangle in O(1). Windows are rows [r0, r1) and columns [c0, c1),
+///clipped to the band.
+template< typename T >
+class SummedAreaTable
+{
+public:
+    ///Exact 64 bit sums for integer pixels up to 32 bits, double-double
+    ///otherwise
+    using Sum = typename std::conditional< std::is_integral< T >::value &&
+        sizeof( T ) <= 4, std::int64_t, DoubleDouble >::type;
+
+    ///Bytes the tables of a width x height band take
+    static std::size_t footprint(
+        int width,
+        int height,
+        bool squares = true )
+    {
+        return ( static_cast< std::size_t >( width ) + 1 ) * ( height + 1 ) *
+            ( sizeof( Sum ) + sizeof( std::int64_t ) +
+                ( squares ? sizeof( DoubleDouble ) : 0 ) );
+    }
+
+    ///Builds the tables in two parallel passes, along rows then down columns
+    explicit SummedAreaTable(
+        Band< T > const& band,
+        bool squares = true )
+        :
+        m_width( band.width() ),
+        m_height( band.height() ),
+        m_stride( static_cast< std::size_t >( band.width() ) + 1 ),
+        m_sum(),
+        m_squares(),
+        m_count()
+    {
+        GISRASTER_TRACE_SCOPE( "SummedAreaTable::build", band.size(),
+            footprint( m_width, m_height, squares ) );
+        MemoryAccountant::current().check( footprint( m_width, m_height, squares ) );
+        std::size_t const n = m_stride * ( m_height + 1 );
+        m_sum.resize( n );
+        m_count.resize( n );
+        if( squares ) m_squares.resize( n );
+        prefix_rows( band, 0, m_height, 0, m_width );
+        prefix_columns( 1, m_height, 0, m_width );
+    }
+
+    ///
+    int width() const
+    {
+        return m_width;
+    }
+
+    ///
+    int height() const
+    {
+        return m_height;
+    }
+
+    ///
+    bool has_squares() const
+    {
+        return !m_squares.empty();
+    }
+
+    ///Sum of the valid pixels of the window
+    double sum(
+        int r0,
+        int c0,
+        int r1,
+        int c1 ) const
+    {
+        if( !clip( r0, c0, r1, c1 ) ) return 0.0;
+        return static_cast< double >( rect( m_sum, r0, c0, r1, c1 ) );
+    }
+
+    ///Number of valid pixels in the window
+    std::size_t count(
+        int r0,
+        int c0,
+        int r1,
+        int c1 ) const
+    {
+        if( !clip( r0, c0, r1, c1 ) ) return 0;
+        return static_cast< std::size_t >( rect( m_count, r0, c0, r1, c1 ) );
+    }
+
+    ///NaN when the window has no valid pixel
+    double mean(
+        int r0,
+        int c0,
+        int r1,
+        int c1 ) const
+    {
+        std::size_t const n = count( r0, c0, r1, c1 );
+        if( n == 0 ) return std::numeric_limits< double >::quiet_NaN();
+        return sum( r0, c0, r1, c1 ) / static_cast< double >( n );
+    }
+
+    ///Population variance of the valid pixels; NaN when there are none
+    double variance(
+        int r0,
+        int c0,
+        int r1,
+        int c1 ) const
+    {
+        if( !has_squares() ) throw std::logic_error(
+            "SummedAreaTable::variance: built without the squared table" );
+        std::size_t const n = count( r0, c0, r1, c1 );
+        if( n == 0 ) return std::numeric_limits< double >::quiet_NaN();
+        clip( r0, c0, r1, c1 );
+        DoubleDouble const s = widen( rect( m_sum, r0, c0, r1, c1 ) );
+        DoubleDouble const sq = rect( m_squares, r0, c0, r1, c1 );
+        //( sum of squares - sum^2 / n ) / n, in double-double
+        double const mean = static_cast< double >( s ) / n;
+        DoubleDouble const ss = sq - DoubleDouble::product( mean, s.hi ) -
+            DoubleDouble::product( mean, s.lo );
+        return std::max( 0.0, static_cast< double >( ss ) / n );
+    }
+
+    ///Brings the tables up to date after the pixels of band in the window
+    ///changed; costs O( ( height - r0 ) * ( width - c0 ) ) additions and
+    ///reads only the pixels of the window
+    void update(
+        Band< T > const& band,
+        int r0,
+        int c0,
+        int r1,
+        int c1 )
+    {
+        if( band.width() != m_width || band.height() != m_height )
+        {
+            throw std::invalid_argument(
+                "SummedAreaTable::update: band size changed" );
+        }
+        if( !clip( r0, c0, r1, c1 ) ) return;
+        GISRASTER_TRACE_SCOPE( "SummedAreaTable::update",
+            static_cast< std::size_t >( m_height - r0 ) * ( m_width - c0 ), 0 );
+
+        //Old last column and row of the rewritten block; their changes carry
+        //to the columns right of the window and to the rows below it
+        Edges< Sum > sums = edges( m_sum, r0, c0, r1, c1 );
+        Edges< std::int64_t > counts = edges( m_count, r0, c0, r1, c1 );
+        Edges< DoubleDouble > squares;
+        if( has_squares() ) squares = edges( m_squares, r0, c0, r1, c1 );
+
+        prefix_rows( band, r0, r1, c0, c1 );
+        prefix_columns( r0 + 1, r1, c0, c1 );
+
+        carry( m_sum, sums, r0, c0, r1, c1 );
+        carry( m_count, counts, r0, c0, r1, c1 );
+        if( has_squares() ) carry( m_squares, squares, r0, c0, r1, c1 );
+    }
+
+private:
+    ///
+    static DoubleDouble widen(
+        std::int64_t v )
+    {
+        double const hi = static_cast< double >( v );
+        return DoubleDouble( hi, static_cast< double >(
+            v - static_cast< std::int64_t >( hi ) ) );
+    }
+
+    ///
+    static DoubleDouble widen(
+        DoubleDouble const& v )
+    {
+        return v;
+    }
+
+    ///
+    bool clip(
+        int& r0,
+        int& c0,
+        int& r1,
+        int& c1 ) const
+    {
+        r0 = std::max( r0, 0 );
+        c0 = std::max( c0, 0 );
+        r1 = std::min( r1, m_height );
+        c1 = std::min( c1, m_width );
+        return ( r0 < r1 ) && ( c0 < c1 );
+    }
+
+    ///
+    template< typename S >
+    S rect(
+        Buffer< S > const& t,
+        int r0,
+        int c0,
+        int r1,
+        int c1 ) const
+    {
+        std::size_t const a = static_cast< std::size_t >( r0 ) * m_stride;
+        std::size_t const b = static_cast< std::size_t >( r1 ) * m_stride;
+        return ( t[ b + c1 ] - t[ a + c1 ] ) - ( t[ b + c0 ] - t[ a + c0 ] );
+    }
+
+    ///Table rows r0 + 1 .. r1, columns c0 + 1 .. c1, from band rows
+    ///r0 .. r1 - 1: prefix along the row from column c0, continuing the
+    ///unchanged prefix before it
+    void prefix_rows(
+        Band< T > const& band,
+        int r0,
+        int r1,
+        int c0,
+        int c1 )
+    {
+        T const* const data = band.data();
+        T const nodata = band.nodatavalue();
+        bool const squares = has_squares();
+        parallel_for( r0, r1, [ & ]( int begin, int end )
+            {
+                for( int r = begin; r < end; ++r )
+                {
+                    std::size_t const above = static_cast< std::size_t >( r ) * m_stride;
+                    std::size_t const row = above + m_stride;
+                    //Prefix of this band row alone up to column c0
+                    Sum s = m_sum[ row + c0 ] - m_sum[ above + c0 ];
+                    std::int64_t n = m_count[ row + c0 ] - m_count[ above + c0 ];
+                    DoubleDouble q = squares ?
+                        m_squares[ row + c0 ] - m_squares[ above + c0 ] : DoubleDouble();
+                    if( c0 == 0 )
+                    {
+                        s = Sum();
+                        n = 0;
+                        q = DoubleDouble();
+                    }
+                    T const* const in = data + static_cast< std::size_t >( r ) * m_width;
+                    for( int c = c0; c < c1; ++c )
+                    {
+                        bool const valid = ( in[ c ] != nodata );
+                        double const v = valid ? static_cast< double >( in[ c ] ) : 0.0;
+                        s = s + static_cast< Sum >( v );
+                        n += valid;
+                        m_sum[ row + c + 1 ] = s;
+                        m_count[ row + c + 1 ] = n;
+                        if( squares )
+                        {
+                            q += DoubleDouble::product( v, v );
+                            m_squares[ row + c + 1 ] = q;
+                        }
+                    }
+                }
+            }, 64 );
+    }
+
+    ///Adds the table row above to table rows r0 .. r1, columns c0 + 1 .. c1;
+    ///parallel over column blocks, serial down the rows
+    void prefix_columns(
+        int r0,
+        int r1,
+        int c0,
+        int c1 )
+    {
+        bool const squares = has_squares();
+        parallel_for( c0 + 1, c1 + 1, [ & ]( int begin, int end )
+            {
+                for( int r = r0; r <= r1; ++r )
+                {
+                    std::size_t const row = static_cast< std::size_t >( r ) * m_stride;
+                    std::size_t const above = row - m_stride;
+                    for( int c = begin; c < end; ++c )
+                    {
+                        m_sum[ row + c ] = m_sum[ row + c ] + m_sum[ above + c ];
+                        m_count[ row + c ] += m_count[ above + c ];
+                        if( squares ) m_squares[ row + c ] += m_squares[ above + c ];
+                    }
+                }
+            }, 1024 );
+    }
+
+    ///Last column ( rows r0 + 1 .. r1 ) and last row ( columns c0 + 1 .. c1 )
+    ///of the table block an update rewrites
+    template< typename S >
+    struct Edges
+    {
+        ///
+        Buffer< S > column;
+
+        ///
+        Buffer< S > row;
+    };
+
+    ///
+    template< typename S >
+    Edges< S > edges(
+        Buffer< S > const& t,
+        int r0,
+        int c0,
+        int r1,
+        int c1 ) const
+    {
+        Edges< S > result;
+        result.column.resize( static_cast< std::size_t >( r1 - r0 ) );
+        for( int r = r0 + 1; r <= r1; ++r )
+        {
+            result.column[ r - r0 - 1 ] =
+                t[ static_cast< std::size_t >( r ) * m_stride + c1 ];
+        }
+        std::size_t const last = static_cast< std::size_t >( r1 ) * m_stride;
+        result.row.assign( t.begin() + last + c0 + 1, t.begin() + last + c1 + 1 );
+        return result;
+    }
+
+    ///Adds the change of the rewritten block's last column to the table
+    ///right of it and the change of its last row to the table below it;
+    ///old holds the edges from before the rewrite
+    template< typename S >
+    void carry(
+        Buffer< S >& t,
+        Edges< S >& old,
+        int r0,
+        int c0,
+        int r1,
+        int c1 )
+    {
+        for( int r = r0 + 1; r <= r1; ++r )
+        {
+            S& d = old.column[ r - r0 - 1 ];
+            d = t[ static_cast< std::size_t >( r ) * m_stride + c1 ] - d;
+        }
+        std::size_t const last = static_cast< std::size_t >( r1 ) * m_stride;
+        for( int c = c0 + 1; c <= c1; ++c )
+        {
+            S& d = old.row[ c - c0 - 1 ];
+            d = t[ last + c ] - d;
+        }
+        S const corner = old.column.back();
+        parallel_for( r0 + 1, m_height + 1, [ & ]( int begin, int end )
+            {
+                for( int r = begin; r < end; ++r )
+                {
+                    S* const row = t.data() + static_cast< std::size_t >( r ) * m_stride;
+                    S const right = ( r <= r1 ) ? old.column[ r - r0 - 1 ] : corner;
+                    if( r > r1 )
+                    {
+                        for( int c = c0 + 1; c <= c1; ++c )
+                        {
+                            row[ c ] = row[ c ] + old.row[ c - c0 - 1 ];
+                        }
+                    }
+                    for( int c = c1 + 1; c <= m_width; ++c ) row[ c ] = row[ c ] + right;
+                }
+            }, 64 );
+    }
+
+    ///
+    int m_width;
+
+    ///
+    int m_height;
+
+    ///Table row length, width + 1
+    std::size_t m_stride;
+
+    ///
+    Buffer< Sum > m_sum;
+
+    ///
+    Buffer< DoubleDouble > m_squares;
+
+    ///
+    Buffer< std::int64_t > m_count;
+};
+
+} //end gis
@@ -0,0 +1,383 @@
+/*******************************************************************************
+ *
+ * MIT License
+ *
+ * Copyright (c) 2018 Joshua Koch
+ * 
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ * 
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ * 
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ *
+ ******************************************************************************/
+
+#pragma once
+
+#include <gis/Band.h>
+#include <gis/Parallel.h>
+
+#include <algorithm>
+#include <cmath>
+#include <limits>
+#include <vector>
+
+#if defined( __SSE2__ )
+#define GISRASTER_HAS_SSE2 1
+#include <emmintrin.h>
+#endif
+
+namespace gis
+{
+
+///
+enum class SlopeUnit
+{
+    Degrees,
+    Percent
+};
+
+///
+struct TerrainOptions
+{
+    ///Multiplies elevations, e.g. to match vertical and horizontal units
+    double zfactor = 1.0;
+
+    ///
+    SlopeUnit slope = SlopeUnit::Degrees;
+
+    ///Sun direction for hillshade, degrees clockwise from north
+    double azimuth = 315.0;
+
+    ///Sun elevation for hillshade, degrees above the horizon
+    double altitude = 45.0;
+};
+
+///Bands terrain() writes; null ones are skipped
+template< typename R = float >
+struct TerrainBands
+{
+    ///Steepest slope (Horn), in TerrainOptions::slope units
+    Band< R >* slope = nullptr;
+
+    ///Downslope direction in degrees clockwise from north, -1 where flat
+    Band< R >* aspect = nullptr;
+
+    ///Illumination 0 to 255
+    Band< R >* hillshade = nullptr;
+
+    ///Curvature (Zevenbergen & Thorne) in 1/100 elevation units; positive
+    ///on convex surfaces
+    Band< R >* curvature = nullptr;
+};
+
+namespace detail
+{
+
+///Rows handed to each terrain task
+static constexpr int TerrainStrip = 64;
+
+///Row r of dem as float with a one pixel border; nodata, the border and
+///rows outside the band are NaN
+template< typename T >
+void terrain_row(
+    Band< T > const& dem,
+    int r,
+    float* out )
+{
+    int const w = dem.width();
+    float constexpr nan = std::numeric_limits< float >::quiet_NaN();
+    out[ 0 ] = nan;
+    out[ w + 1 ] = nan;
+    if( r < 0 || r >= dem.height() )
+    {
+        std::fill( out + 1, out + w + 1, nan );
+        return;
+    }
+    T const* row = dem.data() + static_cast< std::size_t >( r ) * w;
+    T const nodata = dem.nodatavalue();
+    for( int c = 0; c < w; ++c )
+    {
+        out[ c + 1 ] = ( row[ c ] == nodata ) ? nan : static_cast< float >( row[ c ] );
+    }
+}
+
+///Scale factors of the 3x3 derivatives
+struct TerrainCoefficients
+{
+    float kx;
+    float ky;
+    float kcx;
+    float kcy;
+};
+
+///Gradient p (east), q (north) and curvature k of a row from three
+///bordered rows; missing neighbors take the center value
+inline void terrain_gradient(
+    float const* top,
+    float const* mid,
+    float const* bot,
+    int w,
+    TerrainCoefficients const& k,
+    float* p,
+    float* q,
+    float* curv )
+{
+    int c = 0;
+#if defined( GISRASTER_HAS_SSE2 )
+    __m128 const two = _mm_set1_ps( 2.0f );
+    __m128 const half = _mm_set1_ps( 0.5f );
+    __m128 const kx = _mm_set1_ps( k.kx );
+    __m128 const ky = _mm_set1_ps( k.ky );
+    __m128 const kcx = _mm_set1_ps( -200.0f * k.kcx );
+    __m128 const kcy = _mm_set1_ps( -200.0f * k.kcy );
+    for( ; c + 4 <= w; c += 4 )
+    {
+        __m128 const e = _mm_loadu_ps( mid + c + 1 );
+        auto load = [ e ]( float const* x )
+        {
+            __m128 const v = _mm_loadu_ps( x );
+            __m128 const ok = _mm_cmpeq_ps( v, v );
+            return _mm_or_ps( _mm_and_ps( ok, v ), _mm_andnot_ps( ok, e ) );
+        };
+        __m128 const a = load( top + c );
+        __m128 const b = load( top + c + 1 );
+        __m128 const cc = load( top + c + 2 );
+        __m128 const d = load( mid + c );
+        __m128 const f = load( mid + c + 2 );
+        __m128 const g = load( bot + c );
+        __m128 const h = load( bot + c + 1 );
+        __m128 const i = load( bot + c + 2 );
+        __m128 const east = _mm_add_ps( _mm_add_ps( cc, i ), _mm_mul_ps( two, f ) );
+        __m128 const west = _mm_add_ps( _mm_add_ps( a, g ), _mm_mul_ps( two, d ) );
+        __m128 const north = _mm_add_ps( _mm_add_ps( a, cc ), _mm_mul_ps( two, b ) );
+        __m128 const south = _mm_add_ps( _mm_add_ps( g, i ), _mm_mul_ps( two, h ) );
+        _mm_storeu_ps( p + c, _mm_mul_ps( _mm_sub_ps( east, west ), kx ) );
+        _mm_storeu_ps( q + c, _mm_mul_ps( _mm_sub_ps( north, south ), ky ) );
+        __m128 const dd = _mm_sub_ps( _mm_mul_ps( half, _mm_add_ps( d, f ) ), e );
+        __m128 const ee = _mm_sub_ps( _mm_mul_ps( half, _mm_add_ps( b, h ) ), e );
+        _mm_storeu_ps( curv + c,
+            _mm_add_ps( _mm_mul_ps( dd, kcx ), _mm_mul_ps( ee, kcy ) ) );
+    }
+#endif
+    for( ; c < w; ++c )
+    {
+        float const e = mid[ c + 1 ];
+        auto load = [ e ]( float v ) { return ( v == v ) ? v : e; };
+        float const a = load( top[ c ] ), b = load( top[ c + 1 ] );
+        float const cc = load( top[ c + 2 ] ), d = load( mid[ c ] );
+        float const f = load( mid[ c + 2 ] ), g = load( bot[ c ] );
+        float const h = load( bot[ c + 1 ] ), i = load( bot[ c + 2 ] );
+        p[ c ] = ( ( cc + 2.0f * f + i ) - ( a + 2.0f * d + g ) ) * k.kx;
+        q[ c ] = ( ( a + 2.0f * b + cc ) - ( g + 2.0f * h + i ) ) * k.ky;
+        curv[ c ] = -200.0f * ( ( 0.5f * ( d + f ) - e ) * k.kcx +
+            ( 0.5f * ( b + h ) - e ) * k.kcy );
+    }
+}
+
+///Illumination of a row from its gradient and the sun vector
+inline void terrain_shade(
+    float const* p,
+    float const* q,
+    int w,
+    float sinalt,
+    float sx,
+    float sy,
+    float* out )
+{
+    int c = 0;
+#if defined( GISRASTER_HAS_SSE2 )
+    __m128 const one = _mm_set1_ps( 1.0f );
+    __m128 const full = _mm_set1_ps( 255.0f );
+    __m128 const alt = _mm_set1_ps( sinalt );
+    __m128 const vx = _mm_set1_ps( sx );
+    __m128 const vy = _mm_set1_ps( sy );
+    for( ; c + 4 <= w; c += 4 )
+    {
+        __m128 const pp = _mm_loadu_ps( p + c );
+        __m128 const qq = _mm_loadu_ps( q + c );
+        __m128 const len = _mm_sqrt_ps( _mm_add_ps( one, _mm_add_ps(
+            _mm_mul_ps( pp, pp ), _mm_mul_ps( qq, qq ) ) ) );
+        __m128 const lit = _mm_div_ps( _mm_sub_ps( alt, _mm_add_ps(
+            _mm_mul_ps( pp, vx ), _mm_mul_ps( qq, vy ) ) ), len );
+        _mm_storeu_ps( out + c,
+            _mm_mul_ps( full, _mm_max_ps( _mm_setzero_ps(), lit ) ) );
+    }
+#endif
+    for( ; c < w; ++c )
+    {
+        float const lit = ( sinalt - p[ c ] * sx - q[ c ] * sy ) /
+            std::sqrt( 1.0f + p[ c ] * p[ c ] + q[ c ] * q[ c ] );
+        out[ c ] = 255.0f * std::max( 0.0f, lit );
+    }
+}
+
+} //end detail
+
+///Slope, aspect, hillshade and curvature of dem in one pass. Each task
+///streams a strip of rows through a three row buffer, reading one halo row
+///above and below. Missing neighbors (nodata or off the band) take the
+///center value; nodata centers give nodata (Band< R >::Lowest).
+template< typename R, typename T >
+void terrain(
+    Band< T > const& dem,
+    TerrainBands< R > const& out,
+    TerrainOptions const& options = TerrainOptions() )
+{
+    GISRASTER_TRACE_SCOPE( "terrain", dem.size(), dem.size() * sizeof( R ) );
+    int const w = dem.width(), h = dem.height();
+    double const dx = ( dem.scalex() != 0.0 ) ? std::abs( dem.scalex() ) : 1.0;
+    double const dy = ( dem.scaley() != 0.0 ) ? std::abs( dem.scaley() ) : 1.0;
+    double constexpr pi = 3.14159265358979323846;
+    double const azimuth = options.azimuth * pi / 180.0;
+    double const altitude = options.altitude * pi / 180.0;
+
+    R const nodata = Band< R >::Lowest;
+    R* slope = nullptr;
+    R* aspect = nullptr;
+    R* shade = nullptr;
+    R* curv = nullptr;
+    for( auto b : { out.slope, out.aspect, out.hillshade, out.curvature } )
+    {
+        if( b ) b->copy_props( dem, nodata, no_init );
+    }
+    if( out.slope ) slope = out.slope->data();
+    if( out.aspect ) aspect = out.aspect->data();
+    if( out.hillshade ) shade = out.hillshade->data();
+    if( out.curvature ) curv = out.curvature->data();
+
+    //Horn's gradient scaled by zfactor, east and north positive
+    detail::TerrainCoefficients const k{
+        static_cast< float >( options.zfactor / ( 8.0 * dx ) ),
+        static_cast< float >( options.zfactor / ( 8.0 * dy ) ),
+        static_cast< float >( options.zfactor / ( dx * dx ) ),
+        static_cast< float >( options.zfactor / ( dy * dy ) ) };
+    float const sinalt = static_cast< float >( std::sin( altitude ) );
+    float const sx = static_cast< float >( std::sin( azimuth ) * std::cos( altitude ) );
+    float const sy = static_cast< float >( std::cos( azimuth ) * std::cos( altitude ) );
+    float constexpr todeg = static_cast< float >( 180.0 / pi );
+    bool const degrees = ( options.slope == SlopeUnit::Degrees );
+
+    parallel_for( 0, h, [ & ]( int rbegin, int rend )
+        {
+            std::vector< float > buffer( 3 * static_cast< std::size_t >( w + 2 ) );
+            std::vector< float > p( w ), q( w ), curvature( w ), lit( w );
+            float* top = buffer.data();
+            float* mid = top + w + 2;
+            float* bot = mid + w + 2;
+            detail::terrain_row( dem, rbegin - 1, top );
+            detail::terrain_row( dem, rbegin, mid );
+            for( int r = rbegin; r < rend; ++r )
+            {
+                detail::terrain_row( dem, r + 1, bot );
+                detail::terrain_gradient( top, mid, bot, w, k,
+                    p.data(), q.data(), curvature.data() );
+                if( shade )
+                {
+                    detail::terrain_shade( p.data(), q.data(), w, sinalt, sx, sy,
+                        lit.data() );
+                }
+
+                std::size_t const row = static_cast< std::size_t >( r ) * w;
+                for( int c = 0; c < w; ++c )
+                {
+                    bool const valid = ( mid[ c + 1 ] == mid[ c + 1 ] );
+                    if( !valid )
+                    {
+                        if( slope ) slope[ row + c ] = nodata;
+                        if( aspect ) aspect[ row + c ] = nodata;
+                        if( shade ) shade[ row + c ] = nodata;
+                        if( curv ) curv[ row + c ] = nodata;
+                        continue;
+                    }
+                    if( slope )
+                    {
+                        float const rise = std::sqrt( p[ c ] * p[ c ] + q[ c ] * q[ c ] );
+                        slope[ row + c ] = static_cast< R >(
+                            degrees ? std::atan( rise ) * todeg : 100.0f * rise );
+                    }
+                    if( aspect )
+                    {
+                        float a = -1.0f;
+                        if( p[ c ] != 0.0f || q[ c ] != 0.0f )
+                        {
+                            a = std::atan2( -p[ c ], -q[ c ] ) * todeg;
+                            if( a < 0.0f ) a += 360.0f;
+                        }
+                        aspect[ row + c ] = static_cast< R >( a );
+                    }
+                    if( shade ) shade[ row + c ] = static_cast< R >( lit[ c ] );
+                    if( curv ) curv[ row + c ] = static_cast< R >( curvature[ c ] );
+                }
+
+                std::swap( top, mid );
+                std::swap( mid, bot );
+            }
+        }, detail::TerrainStrip );
+}
+
+///
+template< typename R = float, typename T >
+Band< R > slope(
+    Band< T > const& dem,
+    TerrainOptions const& options = TerrainOptions() )
+{
+    Band< R > result;
+    TerrainBands< R > out;
+    out.slope = &result;
+    terrain( dem, out, options );
+    return result;
+}
+
+///
+template< typename R = float, typename T >
+Band< R > aspect(
+    Band< T > const& dem,
+    TerrainOptions const& options = TerrainOptions() )
+{
+    Band< R > result;
+    TerrainBands< R > out;
+    out.aspect = &result;
+    terrain( dem, out, options );
+    return result;
+}
+
+///
+template< typename R = float, typename T >
+Band< R > hillshade(
+    Band< T > const& dem,
+    TerrainOptions const& options = TerrainOptions() )
+{
+    Band< R > result;
+    TerrainBands< R > out;
+    out.hillshade = &result;
+    terrain( dem, out, options );
+    return result;
+}
+
+///
+template< typename R = float, typename T >
+Band< R > curvature(
+    Band< T > const& dem,
+    TerrainOptions const& options = TerrainOptions() )
+{
+    Band< R > result;
+    TerrainBands< R > out;
+    out.curvature = &result;
+    terrain( dem, out, options );
+    return result;
+}
+
+} //end gis
@@ -0,0 +1,718 @@
+/*******************************************************************************
+ *
+ * MIT License
+ *
+ * Copyright (c) 2018 Joshua Koch
+ * 
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ * 
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ * 
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ *
+ ******************************************************************************/
+
+#pragma once
+
+#include <gis/Band.h>
+#include <gis/Memory.h>
+#include <gis/Parallel.h>
+#include <gis/Raster.h>
+#include <gis/Trace.h>
+
+#include <algorithm>
+#include <cmath>
+#include <cstddef>
+#include <limits>
+#include <stdexcept>
+#include <type_traits>
+#include <utility>
+#include <vector>
+
+#if defined( __SSE2__ )
+#define GISRASTER_HAS_SSE2 1
+#include <emmintrin.h>
+#endif
+
+namespace gis
+{
+
+namespace detail
+{
+
+///Compare-exchange pairs of Batcher's odd-even merge sort for n inputs.
+///The network is built for the next power of two with the extra inputs
+///taken as +infinity; pairs touching those never swap and are left out.
+inline std::vector< std::pair< int, int > > sorting_network(
+    int inputs )
+{
+    int n = 1;
+    while( n < inputs ) n <<= 1;
+    std::vector< std::pair< int, int > > pairs;
+    for( int p = 1; p < n; p <<= 1 )
+    {
+        for( int k = p; k >= 1; k >>= 1 )
+        {
+            for( int j = k % p; j + k < n; j += 2 * k )
+            {
+                for( int i = 0; i < std::min( k, n - j - k ); ++i )
+                {
+                    if( ( i + j ) / ( 2 * p ) == ( i + j + k ) / ( 2 * p ) &&
+                        i + j + k < inputs )
+                    {
+                        pairs.emplace_back( i + j, i + j + k );
+                    }
+                }
+            }
+        }
+    }
+    return pairs;
+}
+
+///a[ l ], b[ l ] = min, max of a[ l ], b[ l ] for lanes l < n
+inline void compare_exchange(
+    float* a,
+    float* b,
+    int n )
+{
+    int l = 0;
+#if defined( GISRASTER_HAS_SSE2 )
+    for( ; l + 4 <= n; l += 4 )
+    {
+        __m128 const x = _mm_loadu_ps( a + l );
+        __m128 const y = _mm_loadu_ps( b + l );
+        _mm_storeu_ps( a + l, _mm_min_ps( x, y ) );
+        _mm_storeu_ps( b + l, _mm_max_ps( x, y ) );
+    }
+#endif
+    for( ; l < n; ++l )
+    {
+        float const x = a[ l ];
+        a[ l ] = std::min( x, b[ l ] );
+        b[ l ] = std::max( x, b[ l ] );
+    }
+}
+
+///
+inline void compare_exchange(
+    double* a,
+    double* b,
+    int n )
+{
+    int l = 0;
+#if defined( GISRASTER_HAS_SSE2 )
+    for( ; l + 2 <= n; l += 2 )
+    {
+        __m128d const x = _mm_loadu_pd( a + l );
+        __m128d const y = _mm_loadu_pd( b + l );
+        _mm_storeu_pd( a + l, _mm_min_pd( x, y ) );
+        _mm_storeu_pd( b + l, _mm_max_pd( x, y ) );
+    }
+#endif
+    for( ; l < n; ++l )
+    {
+        double const x = a[ l ];
+        a[ l ] = std::min( x, b[ l ] );
+        b[ l ] = std::max( x, b[ l ] );
+    }
+}
+
+///Value at fraction q of the sorted values v[0, n), interpolated linearly
+///between neighbours
+template< typename W >
+double order_statistic(
+    W const* v,
+    int n,
+    double q )
+{
+    double const pos = q * ( n - 1 );
+    int const i = static_cast< int >( pos );
+    double const frac = pos - i;
+    if( i + 1 >= n ) return static_cast< double >( v[ n - 1 ] );
+    return static_cast< double >( v[ i ] ) +
+        frac * ( static_cast< double >( v[ i + 1 ] ) - static_cast< double >( v[ i ] ) );
+}
+
+} //end detail
+
+///Co-registered bands of one variable over time, stored pixel-major in
+///square tiles: the steps() values of a pixel are contiguous, so per pixel
+///reductions read one short run instead of one value from each band.
+///Reductions run tile-parallel.
+template< typename T >
+class TimeStack
+{
+public:
+    ///Tiles are TileSize x TileSize pixels
+    static constexpr int TileShift = 6;
+
+    ///
+    static constexpr int TileSize = 1 << TileShift;
+
+    ///Longest series sorted with a sorting network; longer ones use
+    ///nth_element
+    static constexpr int MaxNetwork = 32;
+
+    ///Stacks bands, oldest first; times default to 0, 1, ... Pixels equal
+    ///to the nodata value of their band are missing; the stack uses the
+    ///nodata value of the first band.
+    explicit TimeStack(
+        std::vector< Band< T > > const& bands,
+        std::vector< double > times = std::vector< double >() )
+        :
+        TimeStack( pointers( bands ), std::move( times ) )
+    {
+        ;
+    }
+
+    ///Stacks the bands of raster, which must all hold T pixels
+    template< typename T0, typename... Ts >
+    explicit TimeStack(
+        Raster< T0, Ts... > const& raster,
+        std::vector< double > times = std::vector< double >() )
+        :
+        TimeStack( pointers( raster, std::index_sequence_for< T0, Ts... >{} ),
+            std::move( times ) )
+    {
+        ;
+    }
+
+    ///
+    int width() const
+    {
+        return m_width;
+    }
+
+    ///
+    int height() const
+    {
+        return m_height;
+    }
+
+    ///Number of time steps
+    int steps() const
+    {
+        return m_steps;
+    }
+
+    ///
+    std::vector< double > const& times() const
+    {
+        return m_times;
+    }
+
+    ///
+    T nodatavalue() const
+    {
+        return m_nodatavalue;
+    }
+
+    ///Value of pixel ( r, c ) at step t
+    T operator ()(
+        int r,
+        int c,
+        int t ) const
+    {
+        if( r < 0 || r >= m_height || c < 0 || c >= m_width || t < 0 || t >= m_steps )
+        {
+            throw std::out_of_range( "TimeStack::operator(): out of range" );
+        }
+        return series( r, c )[ t ];
+    }
+
+    ///The steps() values of pixel ( r, c )
+    T const* series(
+        int r,
+        int c ) const
+    {
+        std::size_t const tile = static_cast< std::size_t >( r >> TileShift ) *
+            m_across + static_cast< std::size_t >( c >> TileShift );
+        std::size_t const pixel = static_cast< std::size_t >(
+            ( ( r & ( TileSize - 1 ) ) << TileShift ) | ( c & ( TileSize - 1 ) ) );
+        return m_data.data() + ( tile * TileSize * TileSize + pixel ) * m_steps;
+    }
+
+    ///Step t as a band
+    Band< T > band(
+        int t ) const
+    {
+        if( t < 0 || t >= m_steps ) throw std::out_of_range(
+            "TimeStack::band: no such step" );
+        return map< T >( m_nodatavalue, [ t ]( T const* s )
+            {
+                return s[ t ];
+            } );
+    }
+
+    ///Band of fn( series ) for every pixel, where series points to the
+    ///steps() values of the pixel
+    template< typename R, typename F >
+    Band< R > map(
+        R nodata,
+        F fn ) const
+    {
+        Band< R > result = output< R >( nodata );
+        R* const data = result.data();
+        for_each_tile( [ & ]( int r0, int c0, int r1, int c1 )
+            {
+                for( int r = r0; r < r1; ++r )
+                {
+                    R* out = data + static_cast< std::size_t >( r ) * m_width;
+                    for( int c = c0; c < c1; ++c ) out[ c ] = fn( series( r, c ) );
+                }
+            } );
+        return result;
+    }
+
+    ///Number of valid observations of each pixel
+    Band< int > count() const
+    {
+        GISRASTER_TRACE_SCOPE( "TimeStack::count", size(), size() * sizeof( int ) );
+        T const nd = m_nodatavalue;
+        int const n = m_steps;
+        return map< int >( -1, [ nd, n ]( T const* s )
+            {
+                int k = 0;
+                for( int t = 0; t < n; ++t ) k += ( s[ t ] != nd );
+                return k;
+            } );
+    }
+
+    ///Value at percentile p ( 0 to 100 ) of the valid observations, linearly
+    ///interpolated; Band< R >::Lowest where there are none
+    template< typename R = float >
+    Band< R > percentile(
+        double p ) const
+    {
+        if( !( p >= 0.0 && p <= 100.0 ) ) throw std::invalid_argument(
+            "TimeStack::percentile: percentile outside [0, 100]" );
+        GISRASTER_TRACE_SCOPE( "TimeStack::percentile", size(), size() * sizeof( R ) );
+        double const q = p / 100.0;
+        if( m_steps <= MaxNetwork ) return sorted< R >( q );
+
+        Band< R > result = output< R >( Band< R >::Lowest );
+        R* const data = result.data();
+        T const nd = m_nodatavalue;
+        for_each_tile( [ & ]( int r0, int c0, int r1, int c1 )
+            {
+                std::vector< T > valid( m_steps );
+                for( int r = r0; r < r1; ++r )
+                {
+                    for( int c = c0; c < c1; ++c )
+                    {
+                        R& out = data[ static_cast< std::size_t >( r ) * m_width + c ];
+                        T const* s = series( r, c );
+                        auto const end = std::remove_copy( s, s + m_steps, valid.begin(), nd );
+                        int const k = static_cast< int >( end - valid.begin() );
+                        if( k == 0 )
+                        {
+                            out = Band< R >::Lowest;
+                            continue;
+                        }
+                        double const pos = q * ( k - 1 );
+                        int const i = static_cast< int >( pos );
+                        std::nth_element( valid.begin(), valid.begin() + i, end );
+                        double v = static_cast< double >( valid[ i ] );
+                        if( i + 1 < k )
+                        {
+                            double const next = static_cast< double >(
+                                *std::min_element( valid.begin() + i + 1, end ) );
+                            v += ( pos - i ) * ( next - v );
+                        }
+                        out = Band< R >::cast( v, true );
+                    }
+                }
+            } );
+        return result;
+    }
+
+    ///
+    template< typename R = float >
+    Band< R > median() const
+    {
+        return percentile< R >( 50.0 );
+    }
+
+    ///Least squares slope of value over time, in value units per time unit;
+    ///Band< R >::Lowest where fewer than two observations are valid
+    template< typename R = float >
+    Band< R > slope() const
+    {
+        GISRASTER_TRACE_SCOPE( "TimeStack::slope", size(), size() * sizeof( R ) );
+        T const nd = m_nodatavalue;
+        int const n = m_steps;
+        double const* times = m_times.data();
+        return map< R >( Band< R >::Lowest, [ nd, n, times ]( T const* s )
+            {
+                //Branch free sums over the valid observations
+                double k = 0.0;
+                double st = 0.0;
+                double sv = 0.0;
+                double stt = 0.0;
+                double stv = 0.0;
+                for( int t = 0; t < n; ++t )
+                {
+                    double const w = ( s[ t ] != nd ) ? 1.0 : 0.0;
+                    double const v = w * static_cast< double >( s[ t ] );
+                    k += w;
+                    st += w * times[ t ];
+                    sv += v;
+                    stt += w * times[ t ] * times[ t ];
+                    stv += v * times[ t ];
+                }
+                double const den = k * stt - st * st;
+                if( k < 2.0 || den == 0.0 ) return Band< R >::Lowest;
+                return Band< R >::cast( ( k * stv - st * sv ) / den, true );
+            } );
+    }
+
+    ///Step of the largest valid observation of each pixel, the earliest on
+    ///ties; -1 where there is none
+    Band< int > argmax() const
+    {
+        GISRASTER_TRACE_SCOPE( "TimeStack::argmax", size(), size() * sizeof( int ) );
+        T const nd = m_nodatavalue;
+        int const n = m_steps;
+        return map< int >( -1, [ nd, n ]( T const* s )
+            {
+                int best = -1;
+                for( int t = 0; t < n; ++t )
+                {
+                    if( s[ t ] != nd && ( best < 0 || s[ best ] < s[ t ] ) ) best = t;
+                }
+                return best;
+            } );
+    }
+
+    ///Maximum value compositing: each pixel of values taken at the step
+    ///where this stack (e.g. NDVI) peaks
+    template< typename U >
+    Band< U > composite(
+        TimeStack< U > const& values ) const
+    {
+        if( values.width() != m_width || values.height() != m_height ||
+            values.steps() != m_steps )
+        {
+            throw std::invalid_argument( "TimeStack::composite: stacks differ in shape" );
+        }
+        GISRASTER_TRACE_SCOPE( "TimeStack::composite", size(), size() * sizeof( U ) );
+        Band< int > const best = argmax();
+        Band< U > result = values.template output< U >( values.nodatavalue() );
+        U* const data = result.data();
+        for_each_tile( [ & ]( int r0, int c0, int r1, int c1 )
+            {
+                for( int r = r0; r < r1; ++r )
+                {
+                    std::size_t const row = static_cast< std::size_t >( r ) * m_width;
+                    for( int c = c0; c < c1; ++c )
+                    {
+                        int const t = best.data()[ row + c ];
+                        data[ row + c ] = ( t >= 0 ) ?
+                            values.series( r, c )[ t ] : values.nodatavalue();
+                    }
+                }
+            } );
+        return result;
+    }
+
+    ///Number of pixels
+    std::size_t size() const
+    {
+        return static_cast< std::size_t >( m_width ) * m_height;
+    }
+
+    ///Bytes of pixel storage
+    std::size_t bytes() const
+    {
+        return m_data.size() * sizeof( T );
+    }
+
+private:
+    ///Self friendship
+    template< typename U >
+    friend class TimeStack;
+
+    ///Sort type: float where it holds T exactly
+    using Work = typename std::conditional< ( sizeof( T ) <= 2 &&
+        !std::is_same< T, std::uint16_t >::value ) || std::is_same< T, float >::value ||
+        is_half< T >::value, float, double >::type;
+
+    ///Pixels sorted together, one per SIMD lane
+    static constexpr int Lanes = 8;
+
+    ///
+    explicit TimeStack(
+        std::vector< Band< T > const* > bands,
+        std::vector< double > times )
+        :
+        m_width( bands.empty() ? 0 : bands.front()->width() ),
+        m_height( bands.empty() ? 0 : bands.front()->height() ),
+        m_steps( static_cast< int >( bands.size() ) ),
+        m_across( ( m_width + TileSize - 1 ) >> TileShift ),
+        m_nodatavalue( bands.empty() ? Band< T >::Lowest : bands.front()->nodatavalue() ),
+        m_times( std::move( times ) ),
+        m_upperleftx( bands.empty() ? 0.0 : bands.front()->upperleftx() ),
+        m_upperlefty( bands.empty() ? 0.0 : bands.front()->upperlefty() ),
+        m_srid( bands.empty() ? 0 : bands.front()->srid() ),
+        m_scalex( bands.empty() ? 0.0 : bands.front()->scalex() ),
+        m_scaley( bands.empty() ? 0.0 : bands.front()->scaley() ),
+        m_data()
+    {
+        if( bands.empty() ) throw std::invalid_argument( "TimeStack: no bands" );
+        for( auto const* b : bands )
+        {
+            if( b->width() != m_width || b->height() != m_height )
+            {
+                throw std::invalid_argument( "TimeStack: bands differ in size" );
+            }
+        }
+        if( m_times.empty() )
+        {
+            for( int t = 0; t < m_steps; ++t ) m_times.push_back( t );
+        }
+        if( m_times.size() != bands.size() ) throw std::invalid_argument(
+            "TimeStack: one time per band needed" );
+
+        int const down = ( m_height + TileSize - 1 ) >> TileShift;
+        std::size_t const n = static_cast< std::size_t >( m_across ) * down *
+            TileSize * TileSize * m_steps;
+        GISRASTER_TRACE_SCOPE( "TimeStack::build", size() * m_steps, n * sizeof( T ) );
+        MemoryAccountant::current().check( n * sizeof( T ) );
+        {
+            detail::DefaultInit scope;
+            m_data.resize( n );
+        }
+        //Tile-parallel transpose into pixel-major order; padding holds
+        //nodata
+        parallel_for( 0, down * m_across, [ & ]( int begin, int end )
+            {
+                for( int tile = begin; tile < end; ++tile )
+                {
+                    int const r0 = ( tile / m_across ) * TileSize;
+                    int const c0 = ( tile % m_across ) * TileSize;
+                    T* dst = m_data.data() + static_cast< std::size_t >( tile ) *
+                        TileSize * TileSize * m_steps;
+                    for( int r = r0; r < r0 + TileSize; ++r )
+                    {
+                        for( int t = 0; t < m_steps; ++t )
+                        {
+                            Band< T > const& b = *bands[ t ];
+                            T const bnd = b.nodatavalue();
+                            T* out = dst + static_cast< std::size_t >( r - r0 ) *
+                                TileSize * m_steps + t;
+                            for( int c = c0; c < c0 + TileSize; ++c, out += m_steps )
+                            {
+                                T v = m_nodatavalue;
+                                if( r < m_height && c < m_width )
+                                {
+                                    v = b.data()[ static_cast< std::size_t >( r ) * m_width + c ];
+                                    if( v == bnd ) v = m_nodatavalue;
+                                }
+                                *out = v;
+                            }
+                        }
+                    }
+                }
+            } );
+    }
+
+    ///
+    static std::vector< Band< T > const* > pointers(
+        std::vector< Band< T > > const& bands )
+    {
+        std::vector< Band< T > const* > result;
+        for( auto const& b : bands ) result.push_back( &b );
+        return result;
+    }
+
+    ///
+    template< typename... Ts, std::size_t... Ns >
+    static std::vector< Band< T > const* > pointers(
+        Raster< Ts... > const& raster,
+        std::index_sequence< Ns... > )
+    {
+        static_assert( same_types< Ts... >(),
+            "TimeStack: every band of the raster must hold the stack pixel type" );
+        return { &raster.template band< Ns >()... };
+    }
+
+    ///
+    template< typename... Ts >
+    static constexpr bool same_types()
+    {
+        bool const same[] = { std::is_same< Ts, T >::value..., true };
+        for( bool s : same ) if( !s ) return false;
+        return true;
+    }
+
+    ///Output band with the stack's size and georeference, pixels unwritten
+    template< typename R >
+    Band< R > output(
+        R nodata ) const
+    {
+        //Band takes an arithmetic nodata value; half goes through float
+        using N = typename std::conditional< std::is_arithmetic< R >::value,
+            R, float >::type;
+        Band< R > result( m_width, m_height, static_cast< N >( nodata ), no_init );
+        result.upperleftx( m_upperleftx );
+        result.upperlefty( m_upperlefty );
+        result.srid( m_srid );
+        result.scale( m_scalex, m_scaley );
+        return result;
+    }
+
+    ///Calls fn( r0, c0, r1, c1 ) for every tile, in parallel
+    template< typename F >
+    void for_each_tile(
+        F&& fn ) const
+    {
+        int const down = ( m_height + TileSize - 1 ) >> TileShift;
+        parallel_for( 0, down * m_across, [ & ]( int begin, int end )
+            {
+                for( int tile = begin; tile < end; ++tile )
+                {
+                    int const r0 = ( tile / m_across ) * TileSize;
+                    int const c0 = ( tile % m_across ) * TileSize;
+                    fn( r0, c0, std::min( r0 + TileSize, m_height ),
+                        std::min( c0 + TileSize, m_width ) );
+                }
+            } );
+    }
+
+    ///Percentile through a sorting network applied to Lanes pixels at once,
+    ///branch free across the lanes: missing values become +infinity and
+    ///sort last
+    template< typename R >
+    Band< R > sorted(
+        double q ) const
+    {
+        auto const network = detail::sorting_network( m_steps );
+        Band< R > result = output< R >( Band< R >::Lowest );
+        R* const data = result.data();
+        T const nd = m_nodatavalue;
+        Work const inf = std::numeric_limits< Work >::infinity();
+        for_each_tile( [ & ]( int r0, int c0, int r1, int c1 )
+            {
+                Work work[ MaxNetwork ][ Lanes ];
+                Work column[ MaxNetwork ];
+                int counts[ Lanes ];
+                int rows[ Lanes ];
+                int cols[ Lanes ];
+                int lanes = 0;
+                auto flush = [ & ]()
+                {
+                    for( auto const& p : network )
+                    {
+                        detail::compare_exchange( work[ p.first ], work[ p.second ], Lanes );
+                    }
+                    for( int l = 0; l < lanes; ++l )
+                    {
+                        R& out = data[ static_cast< std::size_t >( rows[ l ] ) * m_width +
+                            cols[ l ] ];
+                        if( counts[ l ] == 0 )
+                        {
+                            out = Band< R >::Lowest;
+                            continue;
+                        }
+                        for( int t = 0; t < counts[ l ]; ++t ) column[ t ] = work[ t ][ l ];
+                        out = Band< R >::cast(
+                            detail::order_statistic( column, counts[ l ], q ), true );
+                    }
+                    lanes = 0;
+                };
+                for( int r = r0; r < r1; ++r )
+                {
+                    for( int c = c0; c < c1; ++c )
+                    {
+                        T const* s = series( r, c );
+                        int k = 0;
+                        for( int t = 0; t < m_steps; ++t )
+                        {
+                            bool const valid = s[ t ] != nd;
+                            work[ t ][ lanes ] = valid ? static_cast< Work >( s[ t ] ) : inf;
+                            k += valid;
+                        }
+                        counts[ lanes ] = k;
+                        rows[ lanes ] = r;
+                        cols[ lanes ] = c;
+                        if( ++lanes == Lanes ) flush();
+                    }
+                }
+                if( lanes )
+                {
+                    for( int l = lanes; l < Lanes; ++l )
+                    {
+                        for( int t = 0; t < m_steps; ++t ) work[ t ][ l ] = inf;
+                    }
+                    flush();
+                }
+            } );
+        return result;
+    }
+
+    ///
+    int m_width;
+
+    ///
+    int m_height;
+
+    ///
+    int m_steps;
+
+    ///Tiles per tile row
+    int m_across;
+
+    ///
+    T m_nodatavalue;
+
+    ///
+    std::vector< double > m_times;
+
+    ///
+    double m_upperleftx;
+
+    ///
+    double m_upperlefty;
+
+    ///
+    int m_srid;
+
+    ///
+    double m_scalex;
+
+    ///
+    double m_scaley;
+
+    ///Tiles row-major, pixels row-major within a tile, steps within a pixel
+    Buffer< T > m_data;
+};
+
+///
+template< typename T >
+constexpr int TimeStack< T >::TileShift;
+
+///
+template< typename T >
+constexpr int TimeStack< T >::TileSize;
+
+///
+template< typename T >
+constexpr int TimeStack< T >::MaxNetwork;
+
+///
+template< typename T >
+constexpr int TimeStack< T >::Lanes;
+
+} //end gis
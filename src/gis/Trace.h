@@ -0,0 +1,327 @@
+/*******************************************************************************
+ *
+ * MIT License
+ *
+ * Copyright (c) 2018 Joshua Koch
+ * 
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ * 
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ * 
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ *
+ ******************************************************************************/
+
+#pragma once
+
+//Hot path instrumentation. Compiled out unless GISRASTER_TRACE is defined to
+//a non-zero value (CMake option GISRASTER_ENABLE_TRACE).
+
+#if defined( GISRASTER_TRACE ) && GISRASTER_TRACE
+
+#include <chrono>
+#include <cstdint>
+#include <fstream>
+#include <functional>
+#include <map>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+namespace gis
+{
+
+namespace trace
+{
+
+///Totals for one operation name
+struct Stats
+{
+    ///
+    std::uint64_t calls = 0;
+
+    ///
+    std::uint64_t nanoseconds = 0;
+
+    ///
+    std::uint64_t pixels = 0;
+
+    ///
+    std::uint64_t bytes = 0;
+
+    ///Most threads used by a single call
+    unsigned threads = 1;
+};
+
+///One timed call
+struct Event
+{
+    ///
+    char const* name;
+
+    ///Since the registry was created
+    std::int64_t start;
+
+    ///
+    std::int64_t duration;
+
+    ///
+    std::uint64_t pixels;
+
+    ///
+    std::uint64_t bytes;
+
+    ///
+    unsigned threads;
+
+    ///
+    std::size_t tid;
+};
+
+///Process-wide store of recorded calls
+class Registry
+{
+public:
+    ///Events kept for the trace file; totals are always kept
+    static constexpr std::size_t MaxEvents = 1 << 20;
+
+    ///
+    static Registry& instance()
+    {
+        static Registry registry;
+        return registry;
+    }
+
+    ///
+    std::int64_t now() const
+    {
+        return std::chrono::duration_cast< std::chrono::nanoseconds >(
+            std::chrono::steady_clock::now() - m_epoch ).count();
+    }
+
+    ///
+    void record(
+        Event const& e )
+    {
+        std::lock_guard< std::mutex > lock( m_mutex );
+        Stats& s = m_stats[ e.name ];
+        ++s.calls;
+        s.nanoseconds += static_cast< std::uint64_t >( e.duration );
+        s.pixels += e.pixels;
+        s.bytes += e.bytes;
+        if( e.threads > s.threads ) s.threads = e.threads;
+        if( m_events.size() < MaxEvents ) m_events.push_back( e );
+    }
+
+    ///
+    std::map< std::string, Stats > summary() const
+    {
+        std::lock_guard< std::mutex > lock( m_mutex );
+        return m_stats;
+    }
+
+    ///
+    std::vector< Event > events() const
+    {
+        std::lock_guard< std::mutex > lock( m_mutex );
+        return m_events;
+    }
+
+    ///
+    void reset()
+    {
+        std::lock_guard< std::mutex > lock( m_mutex );
+        m_stats.clear();
+        m_events.clear();
+    }
+
+    ///Writes the recorded calls in Chrome trace event format
+    bool write_chrome_trace(
+        std::string const& path ) const
+    {
+        std::ofstream out( path );
+        if( !out ) return false;
+        auto const events = this->events();
+        out << "{\"traceEvents\":[";
+        for( std::size_t i = 0; i < events.size(); ++i )
+        {
+            Event const& e = events[ i ];
+            out << ( i ? ",\n" : "\n" ) << "{\"name\":\"" << e.name
+                << "\",\"cat\":\"gis\",\"ph\":\"X\",\"pid\":0,\"tid\":"
+                << e.tid << ",\"ts\":" << e.start / 1000.0
+                << ",\"dur\":" << e.duration / 1000.0
+                << ",\"args\":{\"pixels\":" << e.pixels
+                << ",\"bytes\":" << e.bytes
+                << ",\"threads\":" << e.threads << "}}";
+        }
+        out << "\n],\"displayTimeUnit\":\"ms\"}\n";
+        return static_cast< bool >( out );
+    }
+
+    ///Writes the per operation totals as JSON
+    bool write_summary(
+        std::string const& path ) const
+    {
+        std::ofstream out( path );
+        if( !out ) return false;
+        auto const stats = summary();
+        out << "{";
+        bool first = true;
+        for( auto const& s : stats )
+        {
+            out << ( first ? "\n" : ",\n" ) << "\"" << s.first
+                << "\":{\"calls\":" << s.second.calls
+                << ",\"nanoseconds\":" << s.second.nanoseconds
+                << ",\"pixels\":" << s.second.pixels
+                << ",\"bytes\":" << s.second.bytes
+                << ",\"threads\":" << s.second.threads << "}";
+            first = false;
+        }
+        out << "\n}\n";
+        return static_cast< bool >( out );
+    }
+
+private:
+    ///
+    Registry()
+        :
+        m_epoch( std::chrono::steady_clock::now() ),
+        m_mutex(),
+        m_stats(),
+        m_events()
+    {
+        ;
+    }
+
+    ///
+    std::chrono::steady_clock::time_point m_epoch;
+
+    ///
+    mutable std::mutex m_mutex;
+
+    ///
+    std::map< std::string, Stats > m_stats;
+
+    ///
+    std::vector< Event > m_events;
+};
+
+///Times the enclosing block and records it on destruction
+class Scope
+{
+public:
+    ///
+    Scope(
+        char const* name,
+        std::uint64_t pixels = 0,
+        std::uint64_t bytes = 0 )
+        :
+        m_parent( current() ),
+        m_event{ name, Registry::instance().now(), 0, pixels, bytes, 1,
+            std::hash< std::thread::id >()( std::this_thread::get_id() ) }
+    {
+        current() = this;
+    }
+
+    ///
+    Scope( Scope const& ) = delete;
+
+    ///
+    Scope& operator =( Scope const& ) = delete;
+
+    ///
+    ~Scope()
+    {
+        current() = m_parent;
+        Registry& registry = Registry::instance();
+        m_event.duration = registry.now() - m_event.start;
+        registry.record( m_event );
+    }
+
+    ///
+    void threads(
+        unsigned count )
+    {
+        if( count > m_event.threads ) m_event.threads = count;
+        if( m_parent ) m_parent->threads( count );
+    }
+
+    ///
+    void bytes(
+        std::uint64_t count )
+    {
+        m_event.bytes += count;
+    }
+
+    ///Innermost scope on this thread
+    static Scope*& current()
+    {
+        static thread_local Scope* scope = nullptr;
+        return scope;
+    }
+
+private:
+    ///
+    Scope* m_parent;
+
+    ///
+    Event m_event;
+};
+
+///Notes the thread count used by the innermost scope on this thread
+inline void threads(
+    unsigned count )
+{
+    if( Scope* s = Scope::current() ) s->threads( count );
+}
+
+///
+inline bool write_chrome_trace(
+    std::string const& path )
+{
+    return Registry::instance().write_chrome_trace( path );
+}
+
+///
+inline bool write_summary(
+    std::string const& path )
+{
+    return Registry::instance().write_summary( path );
+}
+
+} //end trace
+
+} //end gis
+
+#define GISRASTER_TRACE_CONCAT_( a, b ) a##b
+#define GISRASTER_TRACE_CONCAT( a, b ) GISRASTER_TRACE_CONCAT_( a, b )
+
+///Times the rest of the enclosing block as operation name
+#define GISRASTER_TRACE_SCOPE( name, pixels, bytes ) \
+    ::gis::trace::Scope GISRASTER_TRACE_CONCAT( gisraster_trace_, __LINE__ )( \
+        name, static_cast< std::uint64_t >( pixels ), \
+        static_cast< std::uint64_t >( bytes ) )
+
+///Records the number of threads used by the enclosing operation
+#define GISRASTER_TRACE_THREADS( count ) \
+    ::gis::trace::threads( static_cast< unsigned >( count ) )
+
+#else
+
+#define GISRASTER_TRACE_SCOPE( name, pixels, bytes ) ( ( void )0 )
+#define GISRASTER_TRACE_THREADS( count ) ( ( void )0 )
+
+#endif
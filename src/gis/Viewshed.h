@@ -0,0 +1,578 @@
+/*******************************************************************************
+ *
+ * MIT License
+ *
+ * Copyright (c) 2018 Joshua Koch
+ * 
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ * 
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ * 
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ *
+ ******************************************************************************/
+
+#pragma once
+
+#include <gis/Band.h>
+#include <gis/Parallel.h>
+#include <gis/Trace.h>
+
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <limits>
+#include <mutex>
+#include <stdexcept>
+#include <vector>
+
+namespace gis
+{
+
+///
+enum class ViewshedMethod
+{
+    ///Each ring of cells interpolates the horizon of the ring inside it;
+    ///fastest, one visit per cell
+    XDraw,
+
+    ///Rays to every cell on the edge of the area, each cell taking the
+    ///result of the ray passing closest to its center; more accurate
+    R2
+};
+
+///Observer cell and eye height above the ground
+struct Observer
+{
+    ///
+    int row;
+
+    ///
+    int col;
+
+    ///
+    double height = 1.7;
+};
+
+///
+struct ViewshedOptions
+{
+    ///Height above the ground of the points looked at
+    double target_height = 0.0;
+
+    ///Largest ground distance analysed; 0 for the whole band
+    double radius = 0.0;
+
+    ///Lowers distant ground for the curvature of the earth; needs
+    ///projected, metric coordinates
+    bool curvature = true;
+
+    ///Coefficient of atmospheric refraction, which offsets part of the
+    ///curvature
+    double refraction = 0.13;
+
+    ///
+    double earth_radius = 6371008.8;
+
+    ///
+    ViewshedMethod method = ViewshedMethod::XDraw;
+};
+
+namespace detail
+{
+
+///One observer over one dem. The area around the observer is split into
+///eight octants, each walked outwards along its primary axis and owning a
+///disjoint set of cells, so octants run in parallel without sharing output.
+template< typename T >
+class ViewshedFrame
+{
+public:
+    ///
+    ViewshedFrame(
+        Band< T > const& dem,
+        Observer const& observer,
+        ViewshedOptions const& options )
+        :
+        m_dem( dem ),
+        m_options( options ),
+        m_row( observer.row ),
+        m_col( observer.col ),
+        m_dx( dem.scalex() != 0.0 ? std::abs( dem.scalex() ) : 1.0 ),
+        m_dy( dem.scaley() != 0.0 ? std::abs( dem.scaley() ) : 1.0 ),
+        m_drop( options.curvature ?
+            ( 1.0 - options.refraction ) / ( 2.0 * options.earth_radius ) : 0.0 ),
+        m_eye( 0.0 ),
+        m_r0( 0 ),
+        m_c0( 0 ),
+        m_r1( dem.height() ),
+        m_c1( dem.width() )
+    {
+        if( m_row < 0 || m_row >= dem.height() || m_col < 0 || m_col >= dem.width() )
+        {
+            throw std::out_of_range( "viewshed: observer outside the band" );
+        }
+        T const ground = dem.data()[ index( m_row, m_col ) ];
+        if( ground == dem.nodatavalue() ) throw std::invalid_argument(
+            "viewshed: observer on a nodata cell" );
+        m_eye = static_cast< double >( ground ) + observer.height;
+        if( options.radius > 0.0 )
+        {
+            int const ry = static_cast< int >( std::ceil( options.radius / m_dy ) );
+            int const rx = static_cast< int >( std::ceil( options.radius / m_dx ) );
+            m_r0 = std::max( 0, m_row - ry );
+            m_r1 = std::min( dem.height(), m_row + ry + 1 );
+            m_c0 = std::max( 0, m_col - rx );
+            m_c1 = std::min( dem.width(), m_col + rx + 1 );
+        }
+    }
+
+    ///Rows [ r0, r1 ) and columns [ c0, c1 ) analysed
+    int r0() const
+    {
+        return m_r0;
+    }
+
+    ///
+    int c0() const
+    {
+        return m_c0;
+    }
+
+    ///
+    int r1() const
+    {
+        return m_r1;
+    }
+
+    ///
+    int c1() const
+    {
+        return m_c1;
+    }
+
+    ///
+    std::size_t index(
+        int r,
+        int c ) const
+    {
+        return static_cast< std::size_t >( r ) * m_dem.width() + c;
+    }
+
+    ///Sets visible[ index ] to 1 for the visible cells of octant k and to 0
+    ///for its other cells; best is scratch of the band's size for R2
+    void octant(
+        int k,
+        std::uint8_t* visible,
+        float* best ) const
+    {
+        Octant const o = octant( k );
+        if( m_options.method == ViewshedMethod::R2 )
+        {
+            rays( o, visible, best );
+        }
+        else
+        {
+            xdraw( o, visible );
+        }
+        if( k == 0 ) visible[ index( m_row, m_col ) ] = 1;
+    }
+
+    ///Whether the cell at row, col can be seen
+    bool sees(
+        int row,
+        int col ) const
+    {
+        if( row == m_row && col == m_col ) return true;
+        int const dr = row - m_row;
+        int const dc = col - m_col;
+        bool const swap = std::abs( dr ) > std::abs( dc );
+        Octant o;
+        o.swap = swap;
+        o.sa = ( swap ? dr : dc ) < 0 ? -1 : 1;
+        o.sb = ( swap ? dc : dr ) < 0 ? -1 : 1;
+        int const length = std::abs( swap ? dr : dc );
+        int const side = std::abs( swap ? dc : dr );
+        bool result = false;
+        trace( o, length, side, [ & ]( int i, int j, bool visible, double )
+            {
+                if( i == length && j == side ) result = visible;
+            } );
+        return result;
+    }
+
+private:
+    ///Cell ( i, j ) of an octant lies i steps along its primary axis, sign
+    ///sa, and j steps along its secondary axis, sign sb
+    struct Octant
+    {
+        ///Primary axis is the rows
+        bool swap;
+
+        ///
+        int sa;
+
+        ///
+        int sb;
+
+        ///Steps to the edge of the area along each axis
+        int length;
+
+        ///
+        int side;
+    };
+
+    ///
+    Octant octant(
+        int k ) const
+    {
+        Octant o;
+        o.swap = ( k & 4 ) != 0;
+        o.sa = ( k & 1 ) ? -1 : 1;
+        o.sb = ( k & 2 ) ? -1 : 1;
+        int const right = m_c1 - 1 - m_col;
+        int const left = m_col - m_c0;
+        int const down = m_r1 - 1 - m_row;
+        int const up = m_row - m_r0;
+        int const along_c = ( o.sa > 0 ) ? right : left;
+        int const along_r = ( o.sa > 0 ) ? down : up;
+        int const across_c = ( o.sb > 0 ) ? right : left;
+        int const across_r = ( o.sb > 0 ) ? down : up;
+        o.length = o.swap ? along_r : along_c;
+        o.side = o.swap ? across_c : across_r;
+        return o;
+    }
+
+    ///
+    int row_of(
+        Octant const& o,
+        int i,
+        int j ) const
+    {
+        return m_row + ( o.swap ? o.sa * i : o.sb * j );
+    }
+
+    ///
+    int col_of(
+        Octant const& o,
+        int i,
+        int j ) const
+    {
+        return m_col + ( o.swap ? o.sb * j : o.sa * i );
+    }
+
+    ///Octants share their axes and diagonals; the axes go to the octant
+    ///turning positive and the diagonals to the octants along the columns
+    bool owns(
+        Octant const& o,
+        int i,
+        int j ) const
+    {
+        if( j == 0 && o.sb < 0 ) return false;
+        return o.swap ? j < i : j <= i;
+    }
+
+    ///
+    double distance(
+        Octant const& o,
+        int i,
+        int j ) const
+    {
+        return o.swap ? std::hypot( j * m_dx, i * m_dy ) : std::hypot( i * m_dx, j * m_dy );
+    }
+
+    ///Slope from the eye to the ground ( lift 0 ) or the target ( lift
+    ///target_height ) at cell ( i, j ) at distance d, NaN on nodata
+    double slope(
+        Octant const& o,
+        int i,
+        int j,
+        double d,
+        double lift ) const
+    {
+        T const z = m_dem.data()[ index( row_of( o, i, j ), col_of( o, i, j ) ) ];
+        if( z == m_dem.nodatavalue() ) return std::numeric_limits< double >::quiet_NaN();
+        return ( static_cast< double >( z ) + lift - m_drop * d * d - m_eye ) / d;
+    }
+
+    ///
+    bool inside(
+        double d ) const
+    {
+        return m_options.radius <= 0.0 || d <= m_options.radius;
+    }
+
+    ///Horizon slopes a and b mixed at fraction f; -infinity (no horizon)
+    ///gives way to the other
+    static double mix(
+        double a,
+        double b,
+        double f )
+    {
+        double constexpr none = -std::numeric_limits< double >::infinity();
+        if( f == 0.0 || b == none ) return a;
+        if( a == none ) return b;
+        return a + f * ( b - a );
+    }
+
+    ///Ring by ring: the horizon of cell ( i, j ) is interpolated where its
+    ///line of sight crosses ring i - 1
+    void xdraw(
+        Octant const& o,
+        std::uint8_t* visible ) const
+    {
+        double constexpr none = -std::numeric_limits< double >::infinity();
+        std::vector< double > previous( o.side + 2, none );
+        std::vector< double > current( o.side + 2, none );
+        for( int i = 1; i <= o.length; ++i )
+        {
+            int const end = std::min( i, o.side );
+            for( int j = 0; j <= end; ++j )
+            {
+                double horizon = none;
+                if( i > 1 )
+                {
+                    double const y = static_cast< double >( j ) * ( i - 1 ) / i;
+                    int const lo = static_cast< int >( y );
+                    horizon = mix( previous[ lo ], previous[ lo + 1 ], y - lo );
+                }
+                double const d = distance( o, i, j );
+                if( !inside( d ) )
+                {
+                    current[ j ] = none;
+                    continue;
+                }
+                double const ground = slope( o, i, j, d, 0.0 );
+                if( ground != ground )
+                {
+                    current[ j ] = horizon;
+                    continue;
+                }
+                if( owns( o, i, j ) )
+                {
+                    double const target = slope( o, i, j, d, m_options.target_height );
+                    visible[ index( row_of( o, i, j ), col_of( o, i, j ) ) ] =
+                        ( target >= horizon ) ? 1 : 0;
+                }
+                current[ j ] = std::max( horizon, ground );
+            }
+            std::swap( previous, current );
+        }
+    }
+
+    ///Walks the ray to cell ( length, side ) of octant o, calling
+    ///fn( i, j, visible, offset ) for the cell ( i, j ) closest to the ray at
+    ///each step, offset from its center by offset cells
+    template< typename F >
+    void trace(
+        Octant const& o,
+        int length,
+        int side,
+        F&& fn ) const
+    {
+        double constexpr none = -std::numeric_limits< double >::infinity();
+        double horizon = none;
+        for( int i = 1; i <= length; ++i )
+        {
+            double const y = static_cast< double >( side ) * i / length;
+            int const lo = static_cast< int >( y );
+            double const f = y - lo;
+            int const j = ( f < 0.5 ) ? lo : lo + 1;
+            double const d = distance( o, i, j );
+            if( !inside( d ) ) break;
+            double const target = slope( o, i, j, d, m_options.target_height );
+            if( target == target ) fn( i, j, target >= horizon, std::abs( y - j ) );
+
+            //Ground under the ray, between the cells either side of it
+            double const a = slope( o, i, lo, distance( o, i, lo ), 0.0 );
+            double const b = ( f > 0.0 ) ?
+                slope( o, i, lo + 1, distance( o, i, lo + 1 ), 0.0 ) : a;
+            double const ground = mix( a == a ? a : none, b == b ? b : none, f );
+            horizon = std::max( horizon, ground );
+        }
+    }
+
+    ///R2: rays to the cells on the outer edge of the octant
+    void rays(
+        Octant const& o,
+        std::uint8_t* visible,
+        float* best ) const
+    {
+        auto ray = [ & ]( int length, int side )
+        {
+            trace( o, length, side, [ & ]( int i, int j, bool seen, double offset )
+                {
+                    if( !owns( o, i, j ) ) return;
+                    std::size_t const at = index( row_of( o, i, j ), col_of( o, i, j ) );
+                    if( static_cast< float >( offset ) < best[ at ] )
+                    {
+                        best[ at ] = static_cast< float >( offset );
+                        visible[ at ] = seen ? 1 : 0;
+                    }
+                } );
+        };
+        //Cells of the octant satisfy j <= i, j <= side and i <= length
+        for( int j = 0; j <= std::min( o.length, o.side ); ++j ) ray( o.length, j );
+        if( o.side < o.length )
+        {
+            for( int i = o.side; i < o.length; ++i ) ray( i, o.side );
+        }
+    }
+
+    ///
+    Band< T > const& m_dem;
+
+    ///
+    ViewshedOptions m_options;
+
+    ///
+    int m_row;
+
+    ///
+    int m_col;
+
+    ///Cell size
+    double m_dx;
+
+    ///
+    double m_dy;
+
+    ///Ground lowered by m_drop * distance^2 for curvature and refraction
+    double m_drop;
+
+    ///Eye elevation
+    double m_eye;
+
+    ///
+    int m_r0;
+
+    ///
+    int m_c0;
+
+    ///
+    int m_r1;
+
+    ///
+    int m_c1;
+};
+
+} //end detail
+
+///Cells of dem visible from observer: 1 visible, 0 hidden or beyond the
+///radius, 255 nodata. The eight octants around the observer run in
+///parallel.
+template< typename T >
+Band< std::uint8_t > viewshed(
+    Band< T > const& dem,
+    Observer const& observer,
+    ViewshedOptions const& options = ViewshedOptions() )
+{
+    GISRASTER_TRACE_SCOPE( "viewshed", dem.size(), dem.size() );
+    detail::ViewshedFrame< T > const frame( dem, observer, options );
+    Band< std::uint8_t > result;
+    result.copy_props( dem, 255, 0 );
+    std::uint8_t* visible = result.data();
+    std::vector< float > best;
+    if( options.method == ViewshedMethod::R2 )
+    {
+        best.assign( dem.size(), std::numeric_limits< float >::max() );
+    }
+    parallel_for( 0, 8, [ & ]( int begin, int end )
+        {
+            for( int k = begin; k < end; ++k ) frame.octant( k, visible, best.data() );
+        } );
+    T const* z = dem.data();
+    T const nodata = dem.nodatavalue();
+    for( std::size_t i = 0; i < dem.size(); ++i )
+    {
+        if( z[ i ] == nodata ) visible[ i ] = 255;
+    }
+    return result;
+}
+
+///Whether the cell at row, col of dem is visible from observer, following
+///the ray between the two cells
+template< typename T >
+bool line_of_sight(
+    Band< T > const& dem,
+    Observer const& observer,
+    int row,
+    int col,
+    ViewshedOptions const& options = ViewshedOptions() )
+{
+    if( row < 0 || row >= dem.height() || col < 0 || col >= dem.width() )
+    {
+        throw std::out_of_range( "line_of_sight: target outside the band" );
+    }
+    return detail::ViewshedFrame< T >( dem, observer, options ).sees( row, col );
+}
+
+///Number of observers each cell of dem is visible from, -1 on nodata.
+///Observers run in parallel, each computing its octants in turn.
+template< typename T >
+Band< std::int32_t > cumulative_viewshed(
+    Band< T > const& dem,
+    std::vector< Observer > const& observers,
+    ViewshedOptions const& options = ViewshedOptions() )
+{
+    GISRASTER_TRACE_SCOPE( "cumulative_viewshed", dem.size() * observers.size(),
+        dem.size() * sizeof( std::int32_t ) );
+    Band< std::int32_t > result;
+    result.copy_props( dem, -1, 0 );
+    std::int32_t* counts = result.data();
+    int const w = dem.width();
+    std::mutex lock;
+    parallel_for( 0, static_cast< int >( observers.size() ), [ & ]( int begin, int end )
+        {
+            std::vector< std::uint8_t > visible( dem.size(), 0 );
+            std::vector< std::int32_t > local( dem.size(), 0 );
+            std::vector< float > best;
+            if( options.method == ViewshedMethod::R2 ) best.resize( dem.size() );
+            for( int n = begin; n < end; ++n )
+            {
+                detail::ViewshedFrame< T > const frame( dem, observers[ n ], options );
+                if( !best.empty() )
+                {
+                    for( int r = frame.r0(); r < frame.r1(); ++r )
+                    {
+                        std::fill( best.begin() + frame.index( r, frame.c0() ),
+                            best.begin() + frame.index( r, frame.c1() ),
+                            std::numeric_limits< float >::max() );
+                    }
+                }
+                for( int k = 0; k < 8; ++k ) frame.octant( k, visible.data(), best.data() );
+                for( int r = frame.r0(); r < frame.r1(); ++r )
+                {
+                    std::size_t const row = static_cast< std::size_t >( r ) * w;
+                    for( int c = frame.c0(); c < frame.c1(); ++c )
+                    {
+                        local[ row + c ] += visible[ row + c ];
+                        visible[ row + c ] = 0;
+                    }
+                }
+            }
+            std::lock_guard< std::mutex > guard( lock );
+            for( std::size_t i = 0; i < dem.size(); ++i ) counts[ i ] += local[ i ];
+        } );
+    T const* z = dem.data();
+    T const nodata = dem.nodatavalue();
+    for( std::size_t i = 0; i < dem.size(); ++i )
+    {
+        if( z[ i ] == nodata ) counts[ i ] = -1;
+    }
+    return result;
+}
+
+} //end gis
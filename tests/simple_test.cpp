@@ -1,9 +1,32 @@
 
 // --- App Includes --- //
+#include <gis/AnyRaster.h>
+#include <gis/Contour.h>
+#include <gis/Distance.h>
+#include <gis/Format.h>
+#include <gis/Half.h>
+#include <gis/Hydrology.h>
+#include <gis/Labeling.h>
+#include <gis/Mask.h>
+#include <gis/MortonBand.h>
+#include <gis/PackedBand.h>
+#include <gis/Rank.h>
+#include <gis/Pipeline.h>
 #include <gis/Raster.h>
+#include <gis/Rasterize.h>
+#include <gis/Reclassify.h>
+#include <gis/Sampling.h>
+#include <gis/SharedBand.h>
+#include <gis/SummedArea.h>
+#include <gis/Terrain.h>
+#include <gis/TimeStack.h>
+#include <gis/Viewshed.h>
 
 // --- Standard Includes --- //
+#include <cmath>
 #include <iostream>
+#include <limits>
+#include <stdexcept>
 #include <string>
 
 ////////////////////////////////////////////////////////////////////////////////
@@ -75,7 +98,271 @@ int main(
         std::cout << "avg: " << rast5.band< 0 >().avg() << std::endl;
         std::cout << "avg: " << rast5.band< 1 >().avg() << std::endl;
 
-        //auto abc = rast5.append( gis::Band< int >( 20, 20, 3.0, 6.765 ) );
+        auto rast6 = std::move( rast5 ).append(
+            gis::Band< float >( 20, 20, 3.0, 6.765 ) );
+        std::cout << std::endl << "rast6:" << std::endl;
+        std::cout << rast6.size() << std::endl;
+        std::cout << rast6.band< 2 >()( 0, 10 ) << std::endl;
+        auto rast7 = std::move( rast6 ).reorder< 2, 0, 1 >();
+        std::cout << rast7.band< 0 >()( 0, 10 ) << std::endl;
+        auto rast8 = std::move( rast7 ).select< 2 >();
+        std::cout << rast8.size() << std::endl;
+        std::cout << std::get< 0 >( rast4.view< 2, 0 >() ).nodatavalue()
+            << std::endl;
+
+        gis::Band< int > mask( 10, 10, -1, 0 );
+        mask.scale( 1.0 );
+        mask.upperlefty( 10.0 );
+        gis::rasterize( mask, gis::Polygon{
+            { { 1.0, 1.0 }, { 8.0, 1.0 }, { 8.0, 8.0 }, { 1.0, 8.0 } },
+            { { 3.0, 3.0 }, { 5.0, 3.0 }, { 5.0, 5.0 }, { 3.0, 5.0 } } }, 1 );
+        gis::rasterize( mask, gis::LineString{ { 0.5, 9.5 }, { 9.5, 0.5 } },
+            2, gis::BurnMode::AllTouched );
+        std::cout << std::endl << "rasterize:" << std::endl;
+        std::cout << "count: " << mask.count() << std::endl;
+        std::cout << "sum: " << mask.sum() << std::endl;
+        gis::Band< int > notch( 10, 10, -1, 0 );
+        notch.scale( 1.0 );
+        notch.upperlefty( 10.0 );
+        gis::rasterize( notch, gis::Ring{
+            { 1.0, 1.0 }, { 5.0, 5.0 }, { 9.0, 1.0 }, { 9.0, 9.0 }, { 1.0, 9.0 } }, 1 );
+        std::cout << "concave: " << notch.sum() << " " << notch( 1, 1 ) << std::endl;
+
+        gis::Band< float > dem( 6, 5, -9999.0, 15.0 );
+        dem.scale( 30.0 );
+        for( int r = 1; r < 4; ++r )
+            for( int c = 1; c < 5; ++c ) dem( r, c ) = 10.0f;
+        dem( 2, 2 ) = 3.0f;
+        dem( 0, 0 ) = 1.0f;
+        gis::fill_depressions( dem, true );
+        auto flowdir = gis::flow_direction( dem );
+        auto flowacc = gis::flow_accumulation( flowdir );
+        std::cout << std::endl << "hydrology:" << std::endl;
+        std::cout << "filled pit: " << dem( 2, 2 ) << std::endl;
+        std::cout << "outlet accumulation: " << flowacc( 0, 0 ) << std::endl;
+
+        gis::Band< std::int32_t > labels;
+        std::vector< gis::Component > components;
+        std::int32_t const regions = gis::label_components(
+            mask, labels, gis::Connectivity::Four, &components );
+        std::cout << std::endl << "labeling:" << std::endl;
+        std::cout << "regions: " << regions << std::endl;
+        std::cout << "largest: " << std::max_element(
+            components.begin(), components.end(),
+            []( gis::Component const& a, gis::Component const& b )
+            {
+                return ( a.area < b.area );
+            } )->area << std::endl;
+
+        gis::Band< std::int64_t > nearest;
+        auto dist = gis::proximity( mask, { 2 }, &nearest );
+        std::cout << std::endl << "proximity:" << std::endl;
+        std::cout << "distance: " << dist( 0, 9 ) << std::endl;
+        std::cout << "nearest: " << nearest( 0, 9 ) << std::endl;
+
+        gis::AnyBand any1( gis::PixelType::UInt8, 4, 4, 0, 200 );
+        gis::AnyBand any2( gis::Band< float >( 4, 4, -1.0, 2.5 ) );
+        gis::AnyBand any3 = any1 + any2;
+        gis::AnyRaster anyrast( std::move( rast8 ) );
+        anyrast.push_back( gis::AnyBand( gis::PixelType::Int16, 20, 20, 0, 5 ) );
+        std::cout << std::endl << "anyband:" << std::endl;
+        std::cout << gis::pixel_type_name( any3.type() ) << std::endl;
+        std::cout << any3.max() << std::endl;
+        std::cout << anyrast.size() << std::endl;
+        std::cout << anyrast.band( 1 ).sum() << std::endl;
+
+        gis::Band< gis::half > halfband( rast2.band< 0 >() );
+        gis::PackedBand< 2 > packed( mask, 3, true );
+        try
+        {
+            gis::PackedBand< 2 > collides( mask );
+            throw std::runtime_error( "packed: nodata -1 was not rejected" );
+        }
+        catch( std::invalid_argument const& )
+        {
+            ;
+        }
+        std::cout << std::endl << "packed:" << std::endl;
+        std::cout << halfband( 0, 10 ) << std::endl;
+        std::cout << gis::Band< float >( halfband ).max() << std::endl;
+        std::cout << packed.bytes() << std::endl;
+        std::cout << packed.sum() << std::endl;
+        std::cout << gis::Band< int >( packed )( 9, 9 ) << std::endl;
+
+        gis::MemoryAccountant budget( 50000 );
+        {
+            gis::MemoryContext context( budget );
+            gis::Band< double > inbudget( 64, 64, 0.0 );
+            std::cout << std::endl << "memory:" << std::endl;
+            std::cout << budget.used() << std::endl;
+            try
+            {
+                gis::Band< double > overbudget( 64, 64, 0.0 );
+            }
+            catch( gis::memory_budget_exceeded const& e )
+            {
+                std::cout << e.requested() << std::endl;
+            }
+        }
+        std::cout << budget.peak() << std::endl;
+        std::cout << budget.blocks() << std::endl;
+        gis::huge_pages( true );
+        gis::Band< float > untouched( 1024, 1024, -1.0f, gis::no_init );
+        untouched.init( 2.0f );
+        std::cout << untouched.sum() << std::endl;
+        gis::huge_pages( false );
+        std::cout << ( gis::MemoryAccountant::process().used() > 0 ) << std::endl;
+
+        gis::Band< int > tiled( 600, 600, -1, 1 );
+        std::cout << std::endl << "stats:" << std::endl;
+        std::cout << tiled.sum() << std::endl;
+        tiled.set( 599, 599, 100 );
+        tiled[ 0 ][ 0 ] = -1;
+        tiled.touch( 0, 0, 1, 1 );
+        std::cout << tiled.stale_tiles() << std::endl;
+        std::cout << tiled.max() << " " << tiled.count() << std::endl;
+        std::cout << tiled.stale_tiles() << std::endl;
+
+        gis::ValueMap< int > codes( { { 1, 10 }, { 2, 20 } }, 0 );
+        gis::Breaks< int, std::uint8_t > slices( { 0, 50 }, { 1, 2, 3 } );
+        std::cout << std::endl << "reclassify:" << std::endl;
+        std::cout << mask.reclassify( codes ).sum() << std::endl;
+        std::cout << tiled.reclassify( slices ).avg() << std::endl;
+
+        gis::format::WriteOptions options;
+        options.overviews = 2;
+        gis::format::write( "simple_test_band.gr", tiled, options );
+        gis::format::Mapped< gis::Band< int > > const mapped =
+            gis::format::load< int >( "simple_test_band.gr" );
+        gis::Band< int > const coarse =
+            gis::format::load_writable< int >( "simple_test_band.gr", 0, 2 );
+        std::cout << std::endl << "format:" << std::endl;
+        std::cout << mapped->max() << " " << ( *mapped )( 599, 599 ) << std::endl;
+        std::cout << coarse.width() << " " << coarse.scalex() << std::endl;
+
+        gis::MortonBand< int > zorder( tiled );
+        std::cout << std::endl << "morton:" << std::endl;
+        std::cout << zorder.block_size() << " " << zorder( 599, 599 ) << std::endl;
+        std::cout << gis::Band< int >( zorder ).max() << std::endl;
+
+        gis::Band< float > slopes, aspects;
+        gis::TerrainBands< float > terrain;
+        terrain.slope = &slopes;
+        terrain.aspect = &aspects;
+        gis::terrain( dem, terrain );
+        std::cout << std::endl << "terrain:" << std::endl;
+        std::cout << slopes( 2, 1 ) << " " << aspects( 2, 1 ) << std::endl;
+        std::cout << gis::hillshade( dem )( 2, 2 ) << std::endl;
+
+        std::vector< gis::Point > points{ { 45.0, -105.0 }, { 75.0, -75.0 },
+            { -10.0, 0.0 } };
+        std::vector< double > const picked = gis::sample( dem, points );
+        std::vector< double > const smooth =
+            gis::sample( dem, points, gis::Interpolation::Bilinear );
+        std::cout << std::endl << "sample:" << std::endl;
+        std::cout << picked[ 0 ] << " " << picked[ 1 ] << " " << picked[ 2 ] << std::endl;
+        std::cout << smooth[ 0 ] << " " << smooth[ 1 ] << std::endl;
+
+        gis::SummedAreaTable< int > integral( tiled );
+        tiled( 10, 10 ) = 5;
+        integral.update( tiled, 10, 10, 11, 11 );
+        std::cout << std::endl << "summed area:" << std::endl;
+        std::cout << integral.sum( 0, 0, 20, 20 ) << " " << integral.count( 0, 0, 20, 20 )
+            << " " << integral.variance( 0, 0, 20, 20 ) << std::endl;
+
+        gis::PipelineOptions streaming;
+        streaming.block_rows = 16;
+        gis::Band< float > smoothed = gis::stream( tiled, streaming )
+            .convert< double >().focal_mean( 1 ).to_band();
+        std::cout << std::endl << "pipeline:" << std::endl;
+        std::cout << smoothed( 10, 10 ) << " " << smoothed( 300, 300 ) << std::endl;
+
+        gis::SharedBand< int > original( tiled );
+        gis::SharedBand< int > snapshot = original;
+        snapshot.fill( 0, 0, 10, 10, 9 );
+        std::cout << std::endl << "shared band:" << std::endl;
+        std::cout << original( 0, 0 ) << " " << snapshot( 0, 0 ) << " "
+            << snapshot.shared_tiles( original ) << "/" << snapshot.tile_count() << std::endl;
+
+        gis::DenseBand< float > dense( 300, 300, -1, 2 );
+        dense *= 1.5;
+        gis::NanBand< float > nans( tiled );
+        gis::MaskedBand< int > masked( tiled );
+        masked.valid( 0, 0, false );
+        std::cout << std::endl << "nodata policies:" << std::endl;
+        std::cout << dense.sum() << " " << nans.count() << " " << masked.count() << std::endl;
+        gis::NanBand< float > holes( 3, 2, 0, 1 );
+        holes( 1, 2 ) = std::numeric_limits< float >::quiet_NaN();
+        gis::Band< double > const filled( holes );
+        std::cout << filled.count() << " " << filled.sum() << std::endl;
+
+        std::vector< gis::Band< float > > years;
+        for( int y = 0; y < 5; ++y )
+        {
+            years.push_back( gis::Band< float >( 100, 100, -1, static_cast< float >( 2 * y ) ) );
+        }
+        years[ 2 ]( 0, 0 ) = -1;
+        gis::TimeStack< float > stack( years );
+        std::cout << std::endl << "time stack:" << std::endl;
+        std::cout << stack.median()( 0, 0 ) << " " << stack.median()( 1, 1 ) << " "
+            << stack.slope()( 0, 0 ) << " " << stack.count()( 0, 0 ) << std::endl;
+
+        gis::Band< std::uint8_t > speckled( 50, 50, 0, 10 );
+        speckled( 20, 20 ) = 255;
+        speckled( 30, 30 ) = 0;
+        gis::Band< std::uint8_t > despeckled = gis::median_filter( speckled, 2 );
+        gis::Band< int > ranked = gis::rank_filter( tiled, 3, 90.0 );
+        std::cout << std::endl << "rank filter:" << std::endl;
+        std::cout << static_cast< int >( despeckled( 20, 20 ) ) << " "
+            << static_cast< int >( despeckled( 30, 30 ) ) << " " << ranked( 5, 5 ) << std::endl;
+
+        gis::Band< float > cone( 41, 41, -9999, 0 );
+        for( int r = 0; r < 41; ++r )
+        {
+            for( int c = 0; c < 41; ++c )
+            {
+                cone( r, c ) = 20.0f - static_cast< float >( std::hypot( r - 20, c - 20 ) );
+            }
+        }
+        std::vector< gis::Contour > isolines = gis::contours( cone, { 5.0, 10.0, 15.0 } );
+        std::cout << std::endl << "contours:" << std::endl;
+        for( auto const& line : isolines )
+        {
+            std::cout << line.level << " " << line.line.size() << " " << line.closed << std::endl;
+        }
+
+        gis::ViewshedOptions sight;
+        sight.curvature = false;
+        gis::Band< std::uint8_t > seen = gis::viewshed( cone, { 20, 20, 2.0 }, sight );
+        gis::Band< std::int32_t > seen_by = gis::cumulative_viewshed( cone,
+            { { 20, 20, 2.0 }, { 0, 0, 2.0 }, { 40, 40, 2.0 } }, sight );
+        std::cout << std::endl << "viewshed:" << std::endl;
+        std::cout << static_cast< int >( seen( 0, 0 ) ) << " " << seen_by( 20, 20 ) << " "
+            << seen_by( 0, 40 ) << " " << gis::line_of_sight( cone, { 0, 0, 2.0 }, 40, 40, sight )
+            << std::endl;
+        gis::Band< float > flat( 50, 50, -9999, 100 );
+        for( auto method : { gis::ViewshedMethod::XDraw, gis::ViewshedMethod::R2 } )
+        {
+            sight.method = method;
+            if( gis::viewshed( flat, { 3, 20, 2.0 }, sight ).min() != 1 ||
+                gis::cumulative_viewshed( flat, { { 3, 20, 2.0 }, { 40, 5, 2.0 } },
+                    sight ).min() != 2 )
+            {
+                throw std::runtime_error( "viewshed: flat ground is not all visible" );
+            }
+        }
+
+        gis::Band< std::uint8_t > high = gis::compare( cone, gis::Compare::Greater, 10.f );
+        gis::Band< float > peak = gis::apply_mask( cone, high );
+        gis::Band< float > floored = gis::where( high, cone, 10.f );
+        std::cout << std::endl << "masks:" << std::endl;
+        std::cout << peak.summary().count << " " << floored.summary().min << " "
+            << ( gis::tile_states( peak )[ 0 ] == gis::TileState::Mixed ) << std::endl;
+
+#if defined( GISRASTER_TRACE ) && GISRASTER_TRACE
+        gis::trace::write_chrome_trace( "simple_test_trace.json" );
+        gis::trace::write_summary( "simple_test_summary.json" );
+#endif
     }
     catch( std::exception const& e )
     {